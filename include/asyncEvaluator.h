@@ -0,0 +1,55 @@
+// Library to evaluate a function through its asynchronous submit, keeping many batches
+// of points in flight, so that an integrand with high latency per call(i.e. lookups in
+// another process or service) doesn't serialize the integration.
+
+#ifndef _ASYNCEVALUATOR_LIB
+#define _ASYNCEVALUATOR_LIB
+
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+
+#include "../include/math3D.h"
+
+// AsyncEvaluator hands batches of points to the submit function of a Function3D and
+// collects their completions, which may arrive from any thread and in any order. Each
+// batch is known by the number given with it, and its arrays must stay valid until it's
+// waited. The destructor waits the batches still in flight.
+class AsyncEvaluator{
+	public:
+		// constructor
+		AsyncEvaluator(const Function3D&);
+
+		// destructor
+		~AsyncEvaluator();
+
+		// function that submits a batch with its number, it returns 1 if it wasn't accepted
+		int submit(const double*, const double*, const double*, double*, const size_t&, const size_t&);
+		// function that waits a batch given its number, it returns 1 if its values weren't computed
+		int wait(const size_t&);
+		// function that returns the batches submitted and not waited yet
+		size_t getInFlight() const;
+
+	private:
+		AsyncEvaluator(const AsyncEvaluator&) = delete;
+		AsyncEvaluator& operator=(const AsyncEvaluator&) = delete;
+
+		// Ticket is the tag given to the submit function: the evaluator and the number
+		// of the batch
+		struct Ticket{
+			AsyncEvaluator *owner;
+			size_t batch;
+		};
+
+		// function called by the provider of the function when a batch is done
+		static void done(void*, int);
+
+		submitFunction3D submitFunction; // asynchronous function of the Function3D
+		size_t inFlight; // batches submitted and not waited yet
+		std::map<size_t,int> completed; // state of the batches done and not waited yet
+		mutable std::mutex mutex; // guards inFlight and completed
+		std::condition_variable completion; // notified at each batch done
+};
+
+#endif // end of library guardian
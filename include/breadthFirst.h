@@ -0,0 +1,100 @@
+// Library for the breadth-first Romberg's engine: the regions of a recursion depth are
+// integrated together, level by level, and the points of all of them are evaluated in
+// big batches instead of one region at a time.
+
+#ifndef _BREADTHFIRST_LIB
+#define _BREADTHFIRST_LIB
+
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <cmath>
+
+#include "../include/math3D.h"
+#include "../include/asyncEvaluator.h"
+
+// points gathered(over many regions) before evaluating them with one call
+#define BREADTH_FIRST_BATCH_POINTS 262144
+// fewest points of a batch evaluated asynchronously, when a row is cut between the batches in flight
+#define BREADTH_FIRST_MIN_BATCH_POINTS 256
+
+// RegionLevel holds the regions of a recursion depth, as a structure of arrays: all of
+// them have the same sides, so only their vertices are stored. The Romberg's table of
+// each region is kept as its last row, MAXN values per region.
+struct RegionLevel{
+	std::vector<double> x, y, z; // vertex of each region
+	std::vector<double> table; // last row of the Romberg's table of each region
+	std::vector<double> diagonal; // previous value of the diagonal of each region
+	std::vector<char> active; // flag that indicates the region hasn't converged yet
+};
+
+// RowLattice is the part of the trapezoidal lattice of a row of the Romberg's table that
+// wasn't in the previous row: the offsets of its points from the vertex of a region, as
+// fractions of its sides, and their weights. It's shared by every region of every depth.
+struct RowLattice{
+	std::vector<double> x, y, z; // offsets, in [0,1]
+	std::vector<double> weights; // weights of the trapezoidal rule(1/2 on each side of the region)
+};
+
+// LevelBatch holds the points gathered(over many regions) to be evaluated with one call:
+// their coordinates in the space, weight times jacobian, region they belong to and values
+struct LevelBatch{
+	std::vector<double> x, y, z, coefficients, values;
+	std::vector<size_t> regions;
+	size_t number; // number given to the batch when submitted
+	int async; // flag that indicates the values arrive through the AsyncEvaluator
+};
+
+// BreadthFirst integrates a Function3D over a box with Romberg's algorithm and adaptive
+// splitting, as the Romberg's engine does, but breadth first: every row of the tables of
+// the regions of a depth is computed at once, gathering their new points with the shared
+// offsets of the row and evaluating them in batches of BREADTH_FIRST_BATCH_POINTS. The
+// regions not converged after MAXN rows are split, and their children are compacted into
+// the arrays of the next depth. The region tree isn't kept, so every call starts over.
+// If the function has an asynchronous submit, up to inFlight batches are evaluated while
+// the next ones are gathered, and the rows are cut so that they fill them all. The batches
+// are collected in the order they were gathered, so the sums don't change.
+class BreadthFirst{
+	public:
+		// constructor
+		BreadthFirst(const Parallelepiped&, const VariableTransform&, const int&, const int&, const int&,
+						const int& = 1);
+
+		// destructor
+		~BreadthFirst();
+
+		// function that integrates, adding its work to the context
+		double integrate(const Function3D&, const double&, double&, IntegrationContext&);
+
+	private:
+		// function that builds the lattice of a row, if not built yet
+		const RowLattice& lattice(const int&);
+		// function that computes the trapezoidal sums of the new points of a row for the
+		// active regions of a depth
+		void sample(const Function3D&, const RegionLevel&, const int&, const int&, std::vector<double>&,
+					IntegrationContext&);
+		// function that evaluates the points gathered(or submits them), adding them to the sums
+		// of their regions
+		void flush(const Function3D&, const int&, const int&, std::vector<double>&, IntegrationContext&);
+		// function that waits the oldest batch in flight, adding it to the sums of its regions
+		void collect(const Function3D&, const int&, const int&, std::vector<double>&, IntegrationContext&);
+		// function that adds the values of a batch to the sums of their regions
+		void accumulate(const LevelBatch&, const int&, const int&, std::vector<double>&, IntegrationContext&);
+
+		Parallelepiped domain; // box integrated
+		const VariableTransform &transform; // map from the box to the space
+		int MAXN; // rows of the Romberg's tables
+		int MAXR; // maximum recursion depth
+		int precisionMode; // PRECISION_MODE_*
+		int inFlight; // batches evaluated asynchronously at once
+		size_t batchPoints; // points of a batch
+		std::vector<RowLattice> lattices; // lattice of each row(empty if not built)
+		LevelBatch gathered; // points gathered but not evaluated yet
+		std::deque<LevelBatch> pending; // batches submitted, in order
+		std::vector<LevelBatch> spare; // batches collected, kept to reuse their memory
+		size_t submitted; // batches submitted so far
+		std::unique_ptr<AsyncEvaluator> evaluator; // evaluator of the batches(nullptr if synchronous)
+};
+
+#endif // end of library guardian
@@ -25,4 +25,15 @@
 #define WARNING_LOG PROGRAM_OUTPUT_NAME << BRIGHT_PURPLE << " Warning: " << RESET_COLOUR
 #define CONSOLE_LOG PROGRAM_OUTPUT_NAME << " Log: "
 
+/*========== Log stream ==========*/
+#include <iostream>
+// flag of the threads whose logs are discarded(the C interface returns status codes only)
+inline thread_local int silentLogs = 0;
+// stream the library writes its logs to: std::cerr, unless the thread silenced them
+inline std::ostream& logStream(){
+	// a stream without buffer discards what's written to it
+	static thread_local std::ostream silent(nullptr);
+	return silentLogs ? silent : std::cerr;
+}
+
 #endif // end of library guardian
\ No newline at end of file
@@ -0,0 +1,61 @@
+// Library of the Gauss-Legendre rules, whose nodes and weights are computed by
+// the compiler: tables of any order cost nothing at run time.
+
+#ifndef _GAUSSLEGENDRE_LIB
+#define _GAUSSLEGENDRE_LIB
+
+// number of terms of the series of the cosine, and of Newton's iterations
+#define GAUSS_LEGENDRE_COSINE_TERMS 30
+#define GAUSS_LEGENDRE_NEWTON_STEPS 100
+
+// function that computes the cosine of x in [0,pi] at compile time(Taylor's series
+// around pi/2, which converges fast on the whole interval)
+constexpr double constexprCosine(double x){
+	const double pi = 3.14159265358979323846;
+	double t = x-pi/2;
+	double term = -t; // cos(x)=-sin(t)
+	double sum = term;
+	int k = 0;
+	for(k=1;k<GAUSS_LEGENDRE_COSINE_TERMS;++k){
+		term *= -t*t/((2*k)*(2*k+1));
+		sum += term;
+	}
+	return sum;
+}
+
+// GaussLegendreRule is the N points rule on [-1,1]. The nodes are the roots of the
+// Legendre polynomial P_N, found with Newton's method from the asymptotic guess
+// cos(pi(4i+3)/(4N+2)), and the weights are 2/((1-x^2)P_N'(x)^2).
+template<int N>
+class GaussLegendreRule{
+	public:
+		// constructor that computes the rule
+		constexpr GaussLegendreRule() : nodes(), weights(){
+			const double pi = 3.14159265358979323846;
+			int i = 0, j = 0, step = 0;
+			double x = 0, p0 = 0, p1 = 0, p2 = 0, derivative = 1;
+			for(i=0;i<N;++i){
+				x = constexprCosine(pi*(4*i+3)/(4*N+2));
+				derivative = 1;
+				for(step=0;step<GAUSS_LEGENDRE_NEWTON_STEPS;++step){
+					// P_N(x) and P_N'(x) from the recurrence of the polynomials
+					p0 = 1;
+					p1 = x;
+					for(j=2;j<=N;++j){
+						p2 = ((2*j-1)*x*p1-(j-1)*p0)/j;
+						p0 = p1;
+						p1 = p2;
+					}
+					derivative = N*(x*p1-p0)/(x*x-1);
+					x -= p1/derivative;
+				}
+				nodes[i] = x;
+				weights[i] = 2/((1-x*x)*derivative*derivative);
+			}
+		}
+
+		double nodes[N]; // roots of P_N, decreasing
+		double weights[N]; // weights of the rule
+};
+
+#endif // end of library guardian
@@ -0,0 +1,160 @@
+/* C interface of the integral3D library(libintegral3D.a, libintegral3D.so).
+ * It allows to compute triple integrals in-process, without running the
+ * executable. Every function works on its own context, so different contexts
+ * can be used at the same time from different threads. A context must not be
+ * used by more threads at the same time.
+ * Functions returning int return INTEGRAL3D_OK, or one of the error codes, and
+ * nothing is written on stderr. */
+
+#ifndef _INTEGRAL3D_C_LIB
+#define _INTEGRAL3D_C_LIB
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*========== Version ==========*/
+#define INTEGRAL3D_API_VERSION 1
+
+/*========== Return codes ==========*/
+#define INTEGRAL3D_OK 0
+#define INTEGRAL3D_ERROR_ARGUMENT 1 /* invalid argument(i.e. null pointer) */
+#define INTEGRAL3D_ERROR_PLUGIN 2 /* shared library not loaded */
+#define INTEGRAL3D_ERROR_NOT_READY 3 /* no function to integrate */
+#define INTEGRAL3D_ERROR_INTERNAL 4 /* unexpected failure */
+
+/*========== Inequality relations ==========*/
+#define INTEGRAL3D_GREATER 0 /* > */
+#define INTEGRAL3D_GREATER_EQUAL 1 /* >= */
+#define INTEGRAL3D_LESS 2 /* < */
+#define INTEGRAL3D_LESS_EQUAL 3 /* <= */
+
+/*========== Options values ==========*/
+#define INTEGRAL3D_PRECISION_DOUBLE 0
+#define INTEGRAL3D_PRECISION_COMPENSATED 1
+#define INTEGRAL3D_PRECISION_FLOAT 2
+#define INTEGRAL3D_PRECISION_LONG_DOUBLE 3
+#define INTEGRAL3D_UNBOUNDED_TRUNCATE 0
+#define INTEGRAL3D_UNBOUNDED_TRANSFORM 1
+#define INTEGRAL3D_PARITY_NONE 0
+#define INTEGRAL3D_PARITY_EVEN 1
+#define INTEGRAL3D_PARITY_ODD -1
+
+/*========== Result flags ==========*/
+#define INTEGRAL3D_FLAG_DEPTH_LIMIT 1 /* some region reached both MAXN and MAXR */
+#define INTEGRAL3D_FLAG_EVALUATION_FAILED 2 /* some points couldn't be evaluated(the value is NaN) */
+
+/*========== Plugin information ==========*/
+/* A shared library can export, besides f and the inequalities, the object
+ *     struct integral3d_plugin_info integral3d_plugin_info = {...};
+ * declaring what's known about f. Everything is optional: the engine uses it to
+ * pick faster paths, and libraries without it are integrated as usual. "size"
+ * must be sizeof(struct integral3d_plugin_info) and "version" the value of
+ * INTEGRAL3D_PLUGIN_INFO_VERSION the library was compiled with. */
+#define INTEGRAL3D_PLUGIN_INFO_VERSION 2
+#define INTEGRAL3D_PLUGIN_INFO_SYMBOL "integral3d_plugin_info"
+/* flags of the information given */
+#define INTEGRAL3D_HINT_THREAD_SAFE 1 /* f can be called from many threads at once */
+#define INTEGRAL3D_HINT_BOUNDING_BOX 2 /* bounding_box contains the domain */
+#define INTEGRAL3D_HINT_CONSTANT 4 /* f is "constant" over the whole domain */
+/* smoothness classes of f */
+#define INTEGRAL3D_SMOOTHNESS_UNKNOWN 0
+#define INTEGRAL3D_SMOOTHNESS_DISCONTINUOUS 1
+#define INTEGRAL3D_SMOOTHNESS_CONTINUOUS 2
+#define INTEGRAL3D_SMOOTHNESS_SMOOTH 3
+
+/* function evaluating f on n points at once: values[i]=f(x[i],y[i],z[i]) */
+typedef void (*integral3d_batch_function)(const double*, const double*, const double*, double*, size_t);
+/* function called when the values of a batch submitted are written: the tag given with
+ * the batch, and 0 if they were computed(1 otherwise) */
+typedef void (*integral3d_done_function)(void*, int);
+/* function taking n points to evaluate asynchronously: it returns at once(0 if the batch was
+ * accepted), then, from any thread, writes values[i]=f(x[i],y[i],z[i]) and calls done(tag,...).
+ * The arrays stay valid until done is called. Used when the calls of f have a high latency
+ * but little work(i.e. lookups in another process), so that many batches are in flight. */
+typedef int (*integral3d_submit_function)(const double*, const double*, const double*, double*, size_t,
+											integral3d_done_function, void*);
+
+struct integral3d_plugin_info{
+	size_t size; /* sizeof(struct integral3d_plugin_info) */
+	int version; /* INTEGRAL3D_PLUGIN_INFO_VERSION */
+	int flags; /* INTEGRAL3D_HINT_* */
+	integral3d_batch_function batch; /* NULL if not given */
+	double cost; /* estimated seconds per call of f(0 if unknown) */
+	int smoothness; /* INTEGRAL3D_SMOOTHNESS_* */
+	int parity[3]; /* INTEGRAL3D_PARITY_* along x,y,z */
+	double bounding_box[6]; /* xmin,xmax,ymin,ymax,zmin,zmax, with INTEGRAL3D_HINT_BOUNDING_BOX */
+	double constant; /* value of f, with INTEGRAL3D_HINT_CONSTANT */
+	integral3d_submit_function submit; /* NULL if not given(version 2) */
+};
+
+/* opaque context */
+typedef struct integral3d_context integral3d_context;
+
+/* function to integrate */
+typedef double (*integral3d_function)(double, double, double);
+
+/* options of an integration, to be initialised with integral3d_default_options.
+ * "size" is the size of the struct known by the caller, so that fields added
+ * in future versions keep their default value for old callers(the fields below
+ * are the first version, and must all be given). */
+typedef struct{
+	size_t size;
+	double epsilon; /* tolerance of the error */
+	int maxn; /* maximum depth of Romberg's algorithm */
+	int maxr; /* maximum recursion depth of the adaptive integration */
+	int precision; /* INTEGRAL3D_PRECISION_* */
+	int unbounded; /* INTEGRAL3D_UNBOUNDED_* */
+	int tight_bounding; /* 1 to tighten the box with all inequalities together */
+} integral3d_options;
+
+/* result of an integration */
+typedef struct{
+	double value; /* value of the integral */
+	double error; /* estimate of the error */
+	int flags; /* INTEGRAL3D_FLAG_* */
+} integral3d_result;
+
+/* information about an integration */
+typedef struct{
+	double box_volume; /* volume of the box integrated */
+	double fill_ratio; /* estimate of domain volume/box volume */
+	double fill_ratio_min; /* lower bound of the fill ratio */
+	double fill_ratio_max; /* upper bound of the fill ratio */
+} integral3d_stats;
+
+/* version of the interface implemented by the library */
+int integral3d_api_version(void);
+/* description of a return code */
+const char* integral3d_status_string(int);
+
+/* creation and destruction of a context(NULL if out of memory) */
+integral3d_context* integral3d_create(void);
+void integral3d_destroy(integral3d_context*);
+
+/* loads function and inequalities from a shared library, as the executable does */
+int integral3d_load_plugin(integral3d_context*, const char*);
+/* sets the function, and removes the one from the shared library if loaded */
+int integral3d_set_function(integral3d_context*, integral3d_function);
+/* adds an inequality: the coefficients are in the order x^2,x,y^2,y,z^2,z,r,
+ * the relation is INTEGRAL3D_GREATER,... */
+int integral3d_add_inequality(integral3d_context*, const double[7], int);
+/* removes every inequality */
+int integral3d_clear_inequalities(integral3d_context*);
+/* declares the parity of the function along an axis(0,1,2 for x,y,z) */
+int integral3d_set_parity(integral3d_context*, int, int);
+
+/* options with default values */
+void integral3d_default_options(integral3d_options*);
+/* computes the integral(options and stats can be NULL). Integrating again the
+ * same function with a smaller epsilon refines the previous integration. */
+int integral3d_integrate(integral3d_context*, const integral3d_options*, integral3d_result*,
+							integral3d_stats*);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of library guardian */
@@ -0,0 +1,70 @@
+// Library for level-set sweeps: the integrals over a family of domains that differ only
+// in the "r" coefficient of one inequality(i.e. balls of growing radius), computed from
+// one sampling of the biggest domain.
+
+#ifndef _LEVELSET_LIB
+#define _LEVELSET_LIB
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cmath>
+
+#include "../include/math3D.h"
+
+// SweepLevel is the trapezoidal grid of a region at a level: 2^level intervals along
+// each axis, with the points stored x fastest.
+struct SweepLevel{
+	int intervals; // intervals along each axis
+	std::vector<char> inside; // flag that indicates the point is in the biggest domain
+	std::vector<double> key; // value deciding which domains the point is in
+	std::vector<double> values; // value of the function(0 outside the biggest domain)
+};
+
+// LevelSetSweep integrates a Function3D for many values of the "r" coefficient of one of
+// its inequalities. The condition of a point for a value t is turned into key>cut(t), so
+// the points of a region sorted by key give every integral with a binary search on their
+// suffix sums. Values of r for which a whole region is inside the domain take instead its
+// integral, added to all of them at once. The region tree is the one of Romberg's algorithm:
+// a region gets finer grids up to MAXN levels, then it's split, until the difference of the
+// last two grids meets the tolerance for every value of r.
+class LevelSetSweep{
+	public:
+		// constructor
+		LevelSetSweep(const Function3D&, const int&, const std::vector<double>&);
+
+		// destructor
+		~LevelSetSweep();
+
+		// function that returns the Function3D with the biggest domain of the sweep
+		const Function3D& getBiggest() const;
+		// function that integrates over the box, writing the integrals into the result
+		void integrate(const Parallelepiped&, const double&, const int&, const int&, SweepResult&);
+
+	private:
+		// function that integrates a region, adding its contribution
+		void region(const Parallelepiped&, const double&, const int&, const int&, const int&, SweepResult&);
+		// function that computes the grid of a level, reusing the points of the previous one
+		void sample(const Parallelepiped&, const SweepLevel&, SweepLevel&, SweepResult&) const;
+		// function that computes the integral of a grid over the whole region and for the
+		// values of r cutting it(from the first to the last, in the order of the cuts)
+		double sums(const Parallelepiped&, const SweepLevel&, const size_t&, const size_t&,
+					std::vector<double>&) const;
+		// function that computes the key of a point
+		double key(const double&, const double&, const double&) const;
+
+		Function3D function; // function with the inequality swept always true
+		Function3D biggest; // function with the inequality swept giving the biggest domain
+		Inequality swept; // inequality swept
+		int sign; // 1 if the inequality is ">" or ">=", -1 otherwise
+		int strict; // flag that indicates the inequality is ">" or "<"
+		std::vector<double> cuts; // keys from which points are inside, in increasing order
+		std::vector<size_t> order; // position in the thresholds given of each cut
+		std::vector<double> wholeValues; // integrals of regions inside, as differences of consecutive cuts
+		std::vector<double> wholeErrors; // errors of regions inside, as differences of consecutive cuts
+		std::vector<double> values; // integrals of regions cut, for each cut
+		std::vector<double> errors; // errors of regions cut, for each cut
+};
+
+#endif // end of library guardian
@@ -8,20 +8,104 @@
 #include <iostream>
 #include <map>
 #include <string>
+#include <vector>
+#include <utility>
 #include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <cstddef>
 #include <dlfcn.h>
 
 #include "../include/error.h"
 #include "../include/math3D.h"
+#include "../include/integral3D.h"
 
 #define DEFAULT_FUNCTION_NAME "f"
 #define DEFAULT_INEQUALITY1_NAME "first"
 #define DEFAULT_INEQUALITY2_NAME "second"
+#define DEFAULT_INEQUALITIES_NAME "inequalities"
+// optional domains of a multi-domain integral, as a vector of maps with 2 inequalities per domain
+#define DEFAULT_DOMAINS_NAME "domains"
+// optional parity of the function, as a map axis->"even","odd","none"
+#define DEFAULT_PARITY_NAME "parity"
+// optional single precision function is looked for as "f_float"
+#define FLOAT_FUNCTION_SUFFIX "_float"
+// optional control variate: an approximation "f_control" of the function, and its
+// integral over the domain as "double f_control_integral"
+#define CONTROL_FUNCTION_SUFFIX "_control"
+#define CONTROL_INTEGRAL_SUFFIX "_control_integral"
+
+// SharedLibrary is a reference-counted wrapper of a dlopen handle. The handle
+// is closed only when the last owner(DynamicFunction, snapshot, ...) releases it.
+// Symbols are resolved once and cached, so concurrent lookups don't hit dlsym.
+class SharedLibrary{
+	public:
+		// constructor
+		SharedLibrary(const std::string&, void*);
+		// destructor
+		~SharedLibrary();
+
+		// function to resolve a symbol(cached after the first lookup), nullptr if missing
+		void* getSymbol(const std::string&);
+		// function that returns the error of dlsym for a symbol not found
+		std::string getSymbolError(const std::string&);
+		const std::string& getLibraryName() const;
+
+	private:
+		std::string libraryName; // name of the library opened
+		void* handle; // handle of the shared library loaded
+		std::mutex symbolMutex; // guards the symbol cache
+		std::map<std::string,void*> symbols; // cache of resolved symbols
+		std::map<std::string,std::string> symbolErrors; // error of dlsym of each symbol not found
+};
+
+// PluginRegistry is a process-wide, thread-safe registry of the shared libraries
+// opened. Opening the same library twice returns the same SharedLibrary, as long
+// as someone still holds it. It also hands out immutable Function3D snapshots
+// that keep their library alive, and can be evaluated by many threads at once.
+class PluginRegistry{
+	public:
+		// function to access the process-wide registry
+		static PluginRegistry& instance();
+
+		// function to open(or reuse) a shared library, nullptr on error
+		std::shared_ptr<SharedLibrary> open(const std::string&);
+		// function to build an immutable Function3D from a library, nullptr on error
+		std::shared_ptr<const Function3D> snapshot(const std::string&,
+											const std::string& = DEFAULT_FUNCTION_NAME,
+											const std::string& = DEFAULT_INEQUALITY1_NAME,
+											const std::string& = DEFAULT_INEQUALITY2_NAME,
+											const std::string& = DEFAULT_INEQUALITIES_NAME);
+
+	private:
+		PluginRegistry();
+		PluginRegistry(const PluginRegistry&) = delete;
+
+		std::mutex registryMutex; // guards the libraries map
+		std::map<std::string,std::weak_ptr<SharedLibrary>> libraries; // libraries currently open
+};
+
+// function that resolves "f" and the inequalities from a library into a Function3D,
+// which is made owner of the library
+// to be noted that the function returns the state of the operation(0: okay, 1: error)
+int linkFunction3D(const std::shared_ptr<SharedLibrary>&, Function3D&, const std::string&, const std::string&,
+					const std::string&, const std::string&);
+
+// function that declares the parity given as axis->"even","odd","none" on the Function3D
+// to be noted that the function returns the state of the operation(0: okay, 1: error)
+int loadParity(const std::map<std::string,std::string>&, Function3D&);
+
+// function that declares on the Function3D what the library says about it through
+// integral3d_plugin_info(only the fields within the given size are read)
+// to be noted that the function returns the state of the operation(0: okay, 1: error)
+int loadPluginInfo(const integral3d_plugin_info&, Function3D&);
 
 // DynamicFunction is an object that is able to read
 // from a shared library, and is specialised in loading
 // 3 objects: a function "double f(double,double,double)"
-// and 2 maps named first and second.
+// and 2 maps named first and second. Further inequalities
+// can be given with a vector of maps named inequalities,
+// in which case first and second become optional.
 // The class is an extension of a Function3D, this means
 // that it can be also used just as a regular Function3D.
 class DynamicFunction : public Function3D{
@@ -41,6 +125,9 @@ class DynamicFunction : public Function3D{
 
 		// functions to manage loading of Function3D
 		int loadLinkedFunction();
+		// function to load the domains of a multi-domain integral(2 maps of the vector per domain)
+		int loadDomains(std::vector<std::pair<Inequality,Inequality>>&,
+						const std::string& = DEFAULT_DOMAINS_NAME) const;
 		/* inherited functions are left commented */
 		// void loadFunction3D(const Inequality&, const Inequality&, const doubleFunction3D&);
 		// void loadFunction3D(const std::map<std::string,double>&,
@@ -57,6 +144,7 @@ class DynamicFunction : public Function3D{
 		std::string getFunctionName() const;
 		std::string getInequality1Name() const;
 		std::string getInequality2Name() const;
+		std::string getInequalitiesName() const;
 
 		// function to personalize elements name
 		void setFunctionName(char[]);
@@ -65,13 +153,16 @@ class DynamicFunction : public Function3D{
 		void setInequality1Name(const std::string&);
 		void setInequality2Name(char[]);
 		void setInequality2Name(const std::string&);
+		void setInequalitiesName(char[]);
+		void setInequalitiesName(const std::string&);
 
 	private:
 		std::string libraryName; // current linked library name
 		std::string functionName; // name of the function to be loaded
 		std::string inequality1Name; // name of the first inequality to be loaded
 		std::string inequality2Name; // name of the second inequality to be loaded
-		void* handle; // handle of the shared library loaded
+		std::string inequalitiesName; // name of the vector of further inequalities to be loaded
+		std::shared_ptr<SharedLibrary> library; // shared library linked(shared through PluginRegistry)
 };
 
 
@@ -6,10 +6,19 @@
 // https://github.com/Sonodaart/Triple-Integral-Calculator/blob/main/README.md
 
 #include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+#include <memory>
 
 #include "../include/error.h"
 #include "../include/linker.h"
 #include "../include/math3D.h"
+#include "../include/voxelGrid.h"
+#include "../include/workerPool.h"
 
 // function to check if a string is a double or integer
 int isDouble(const char *array);
@@ -17,4 +26,20 @@ int isInteger(const char *array);
 
 // functions to load values into variables
 int loadDouble(const char*, double&, const std::string&);
-int loadInteger(const char*, int&, const std::string&);
\ No newline at end of file
+int loadInteger(const char*, int&, const std::string&);
+
+// functions to separate "--name=value" options from positional arguments
+int isOption(const char *array);
+int loadOptions(int, char*[], std::vector<char*>&, std::map<std::string,std::string>&);
+
+// functions to apply the options to the integration
+int loadPrecisionMode(const std::string&, int&);
+int loadEngine(const std::string&, int&);
+int loadUnboundedMode(const std::string&, int&);
+int loadCoordinates(const std::string&, int&);
+int loadControlOption(const std::string&, Integral3D&, Function3D&);
+int loadParityOption(const std::string&, Function3D&);
+int loadVoxelLayout(const std::string&, VoxelLayout&);
+int loadVoxelOption(const std::string&, std::map<std::string,std::string>&, Function3D&);
+int loadSweepOption(const std::string&, int&, std::vector<double>&);
+int loadIsolateOption(const std::string&, Function3D&, std::shared_ptr<WorkerPool>&);
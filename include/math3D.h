@@ -10,6 +10,13 @@
 #include <limits>
 #include <string>
 #include <cmath>
+#include <memory>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <type_traits>
 
 // values for optional parameters:
 #define DEFAULT_ERROR 0.1
@@ -21,14 +28,157 @@
 // not passed, the state 0 is implied
 #define ZERO_STATE 0
 
+// precision modes of the trapezoidal sums
+#define PRECISION_MODE_DOUBLE 0 // double evaluation, naive double summation
+#define PRECISION_MODE_COMPENSATED 1 // double evaluation, Neumaier-compensated summation
+#define PRECISION_MODE_FLOAT 2 // float evaluation, double summation
+#define PRECISION_MODE_LONG_DOUBLE 3 // double evaluation, long double summation(reference)
+#define DEFAULT_PRECISION_MODE PRECISION_MODE_DOUBLE
+// engines of the integration
+#define ENGINE_ROMBERG 0 // Romberg's algorithm with adaptive quadrature
+#define ENGINE_SPARSE_GRID 1 // dimension-adaptive Clenshaw-Curtis sparse grid(smooth functions)
+#define ENGINE_HYBRID 2 // Gauss-Legendre inside the domain, Romberg's algorithm on its border
+#define ENGINE_BREADTH_FIRST 3 // Romberg's algorithm on all the regions of a depth at once
+#define DEFAULT_ENGINE ENGINE_ROMBERG
+// policies choosing when a region of Romberg's algorithm is split
+#define SPLIT_POLICY_FULL 0 // after computing every row of its table(MAXN)
+#define SPLIT_POLICY_ADAPTIVE 1 // as soon as splitting is expected to sample fewer points than deepening
+#define DEFAULT_SPLIT_POLICY SPLIT_POLICY_FULL
+
 #define DEFAULT_INEQUALITY ">"
-#define COORDINATE_INFINITY std::numeric_limits<double>::max()/2
+#define INEQUALITY_TYPE_GREATER 0
+#define INEQUALITY_TYPE_GREATER_EQUAL 1
+#define INEQUALITY_TYPE_LESS 2
+#define INEQUALITY_TYPE_LESS_EQUAL 3
+#define COORDINATE_INFINITY (std::numeric_limits<double>::max()/2)
 #define MAX_BOUNDED_SIZE 100
+// parity of the function along an axis
+#define PARITY_NONE 0
+#define PARITY_EVEN 1
+#define PARITY_ODD -1
+// smoothness of the function declared by its provider
+#define SMOOTHNESS_UNKNOWN 0
+#define SMOOTHNESS_DISCONTINUOUS 1 // jumps inside the domain
+#define SMOOTHNESS_CONTINUOUS 2 // continuous, with kinks
+#define SMOOTHNESS_SMOOTH 3 // all derivatives continuous
+// relative tolerance when checking if a box is centered in 0
+#define SYMMETRY_TOLERANCE 1e-12
+// handling of the infinite sides of the domain
+#define UNBOUNDED_MODE_TRUNCATE 0 // infinite sides are cut to MAX_BOUNDED_SIZE
+#define UNBOUNDED_MODE_TRANSFORM 1 // infinite sides are mapped to finite intervals
+#define DEFAULT_UNBOUNDED_MODE UNBOUNDED_MODE_TRUNCATE
+// multiplier of the control variate of a function
+#define CONTROL_SCALING_FIXED 0 // the one of the Function3D(1 unless changed)
+#define CONTROL_SCALING_AUTO 1 // the regression of f on g over a lattice of the domain
+#define DEFAULT_CONTROL_SCALING CONTROL_SCALING_FIXED
+// types of the transformations of an axis
+#define TRANSFORM_NONE 0 // x=t
+#define TRANSFORM_UPPER 1 // [o,+inf): x=o+t/(1-t), t in [0,1]
+#define TRANSFORM_LOWER 2 // (-inf,o]: x=o+t/(1+t), t in [-1,0]
+#define TRANSFORM_BOTH 3 // (-inf,+inf): x=t/(1-t^2), t in [-1,1]
+// coordinates in which the box is integrated
+#define COORDINATES_CARTESIAN 0 // the box containing the domain
+#define COORDINATES_ELLIPSOIDAL 1 // spherical coordinates of an ellipsoid of the domain, if any
+#define DEFAULT_COORDINATES COORDINATES_CARTESIAN
+
+// position of a box with respect to a domain
+#define BOX_OUTSIDE 0 // no point of the box is in the domain
+#define BOX_INSIDE 1 // every point of the box is in the domain
+#define BOX_BOUNDARY 2 // the box may cross the border of the domain
+// orders of the Gauss-Legendre rules of the hybrid engine: the difference
+// with the lower order one is the estimate of the error
+#define HYBRID_GAUSS_ORDER 8
+#define HYBRID_GAUSS_CHECK_ORDER 4
+// points gathered before calling the batch function in the trapezoidal sums
+#define TRAPEZOID_BATCH_POINTS 16384
+// number of bisections used to tighten the box containing the domain
+#define TIGHTEN_DEPTH 6
+// points per side of the lattice used to measure the selectivity of inequalities
+#define SELECTIVITY_SAMPLES 9
+// points per side of the lattice used to estimate the multiplier of the control variate
+#define CONTROL_SAMPLES 9
+// status flags of an integration, combined in IntegrationResult::status
+#define INTEGRATION_STATUS_OK 0
+#define INTEGRATION_STATUS_DEPTH_LIMITED 1 // at least one region reached both MAXN and MAXR
+#define INTEGRATION_STATUS_EMPTY_DOMAIN 2 // the box has no volume, the integral is 0
+#define INTEGRATION_STATUS_ZERO_BY_SYMMETRY 4 // odd function on a symmetric domain
+#define INTEGRATION_STATUS_NOT_CALLABLE 8 // the Function3D is not loaded
+#define INTEGRATION_STATUS_EVALUATION_FAILED 16 // some batch couldn't be evaluated(its values are NaN)
+#define INTEGRATION_STATUS_ENGINE_REPLACED 32 // the domain cuts the box, so the sparse grid gave way to the hybrid engine
+// number of threads of the job runner(0 means one per core)
+#define DEFAULT_THREADS 0
+// number of threads integrating the subregions of a single integral
+#define DEFAULT_REGION_THREADS 1
+// batches of points kept in flight by the breadth-first engine, if the function can
+// be evaluated asynchronously
+#define DEFAULT_IN_FLIGHT 8
+// parameters of the autotuner
+#define AUTOTUNE_PROBE_LEVELS 4 // rows of the coarse Romberg's table of the probe
+#define AUTOTUNE_SMOOTH_ORDER 3 // observed order from which the function is smooth
+#define AUTOTUNE_MAX_ORDER 8 // order assumed when the corrections vanish
+#define AUTOTUNE_MAX_MAXN 8 // biggest MAXN chosen
+#define AUTOTUNE_ROUGH_MAXN 4 // MAXN for non smooth functions
+#define AUTOTUNE_MAX_MAXR 5 // biggest MAXR chosen
+#define AUTOTUNE_LOW_FILL 0.25 // fill ratio under which the border dominates
+#define AUTOTUNE_SPARSE_FILL 1 // fill ratio of a domain that is the whole box
+#define AUTOTUNE_TIME_BUDGET 60 // seconds allowed to the worst case of an integration
+#define AUTOTUNE_PARALLEL_TIME 0.01 // seconds from which threads are worth starting
+#define AUTOTUNE_COMPENSATED_TOLERANCE 1e-10 // relative tolerance needing compensated sums
+#define AUTOTUNE_FLOAT_TOLERANCE 1e-4 // relative tolerance allowing float evaluation
 
 #include "../include/error.h"
+#include "../include/gaussLegendre.h"
+#include "../include/trace.h"
 
 // data type of a function that maps R^3 into R
 typedef double (*doubleFunction3D)(double, double, double);
+// data type of the single precision version of the function(optional)
+typedef float (*floatFunction3D)(float, float, float);
+// data type of the version of the function evaluating n points at once(optional):
+// x, y, z are the coordinates, the values are written in the 4th array
+typedef void (*batchFunction3D)(const double*, const double*, const double*, double*, size_t);
+// data type of the function called when the values of a batch submitted are written: the
+// tag given with the batch, and 0 if they were computed(1 otherwise)
+typedef void (*doneFunction3D)(void*, int);
+// data type of the asynchronous version of the batch function(optional): it takes the n
+// points and returns at once(0 if the batch was accepted), then, from any thread, writes
+// the values in the 4th array and calls the done function with the tag
+typedef int (*submitFunction3D)(const double*, const double*, const double*, double*, size_t,
+								doneFunction3D, void*);
+
+// Point3D is an object that describes a point in 3 dimensions.
+class Point3D{
+	public:
+		// constructors
+		Point3D();
+		Point3D(const double&, const double&, const double&);
+
+		// coordinates (public access)
+		double x;
+		double y;
+		double z;
+};
+
+// Parallelepiped is an object that describes parallelepiped objects in 3D.
+// The vertex is the "leftmost" point(aka the point with minimum x,y and z).
+// The xwidth,ywidth and zwidth are the width of each side, in the respective
+// coordinate directions.
+class Parallelepiped{
+	public:
+		// constructors
+		Parallelepiped();
+		Parallelepiped(const Point3D&, const double&, const double&, const double&);
+
+		// coordinates
+		Point3D vertex;
+		double xwidth;
+		double ywidth;
+		double zwidth;
+};
+
+// points and boxes are copied as plain memory in the arrays of the engines
+static_assert(std::is_trivially_copyable<Point3D>::value, "Point3D must be trivially copyable");
+static_assert(std::is_trivially_copyable<Parallelepiped>::value, "Parallelepiped must be trivially copyable");
 
 // Inequality is an object that describes inequalities of the
 // type Ax^2+ax+By^2+by+Cz^2+Cz+r >(=<) 0, where the symbol
@@ -65,6 +215,17 @@ class Inequality{
 		// which returns the state of the inequality(0,1)
 		int isCallable() const;
 		int operator()(const double&, const double&, const double&) const;
+		// function that computes the left side of the Inequality on a given (x,y,z) point
+		double value(const double&, const double&, const double&) const;
+		// functions that bound the values assumed on a box, and tell if the
+		// box is inside, outside or on the border of the Inequality(BOX_*)
+		void valueRange(const Parallelepiped&, double&, double&) const;
+		int classify(const Parallelepiped&) const;
+		// function that checks if the Inequality is the inside of an ellipsoid with axes
+		// along x,y,z, giving its center and semi-axes
+		int isEllipsoid(double[3], double[3]) const;
+		// function to compare two inequalities(same coefficients and disequality)
+		int operator==(const Inequality&) const;
 		
 		// function to get coefficient
 		const std::map<std::string,double>& getCoefficient() const;
@@ -73,14 +234,66 @@ class Inequality{
 		const std::string& getDisequality() const;
 
 	private:
+		// function to copy the map into the arrays used by operator()
+		void updateCache();
+
 		int isLoaded; // flag that indicates if Inequality is properly loaded
 		std::map<std::string,double> coefficient; // map of coefficient as described above
 		std::string disequality; // inequality symbol (">",">=","<","<=")
+		// copies of the above for fast evaluation: coefficients in the order
+		// x^2,x,y^2,y,z^2,z,r and the disequality as one of INEQUALITY_TYPE_*
+		double terms[7];
+		int disequalityType;
+};
+
+class Function3D;
+class IntegrationContext;
+
+// IntegrandSource is an integrand that isn't a plain function, since it needs its own
+// data(i.e. a voxel grid) or runs elsewhere(i.e. in other processes). When it knows a
+// faster way than the engines it can also integrate itself over the domain of a Function3D.
+class IntegrandSource{
+	public:
+		// destructor
+		virtual ~IntegrandSource();
+
+		// function that evaluates the integrand on a given (x,y,z) point
+		virtual double operator()(const double&, const double&, const double&) const = 0;
+		// functions to evaluate many points at once(one by one if not overridden), the first
+		// tells if it's faster than one by one. It returns 1 if some values couldn't be computed
+		virtual int hasBatch() const;
+		virtual int evaluate(const double*, const double*, const double*, double*, const size_t&) const;
+		// function that integrates the integrand over the domain of the Function3D inside the
+		// box, adding the error. It returns 1 if the engines should be used instead
+		virtual int integrate(const Function3D&, const Parallelepiped&, const double&, double&, double&,
+								IntegrationContext&) const;
+};
+
+// FunctionHints collects what the provider of a function declares about it, so that
+// faster paths can be used. The defaults describe a function nothing is known about.
+class FunctionHints{
+	public:
+		// constructor
+		FunctionHints();
+
+		// function to compare two FunctionHints
+		int operator==(const FunctionHints&) const;
+
+		batchFunction3D batch; // function evaluating many points at once(nullptr if not given)
+		submitFunction3D submit; // function evaluating many points asynchronously(nullptr if not given)
+		int threadSafe; // flag that indicates the function can be called from many threads
+		double cost; // estimated seconds per call(0 if unknown)
+		int smoothness; // SMOOTHNESS_*
+		int hasBoundingBox; // flag that indicates boundingBox is given
+		Parallelepiped boundingBox; // box containing the domain, intersected with the one of the inequalities
+		int isConstant; // flag that indicates the function is constant in the domain
+		double constant; // value of the function if constant
 };
 
 // Function3D is an object that describes a 3D function(R^3->R). In
 // particular the function is evaluated only in a domain, given by
-// the intersection of two inequalities. Elsewhere it's defined as 0.
+// the intersection of some inequalities(usually two, but any number is
+// allowed). Elsewhere it's defined as 0.
 // To be noted that with "domain" it will be referred the area over
 // which the function is effectively evaluated, and it can be thought
 // as if the function itself is multiplied by a characteristic function
@@ -95,6 +308,7 @@ class Function3D{
 		Function3D(const Inequality&, const Inequality&, const doubleFunction3D&);
 		Function3D(const std::map<std::string,double>&,
 					const std::map<std::string,double>&, const doubleFunction3D&);	
+		Function3D(const std::vector<Inequality>&, const doubleFunction3D&);
 		// destructor
 		~Function3D();
 		
@@ -102,66 +316,310 @@ class Function3D{
 		void loadFunction3D(const Inequality&, const Inequality&, const doubleFunction3D&);
 		void loadFunction3D(const std::map<std::string,double>&,
 							const std::map<std::string,double>&, const doubleFunction3D&);
+		void loadFunction3D(const std::vector<Inequality>&, const doubleFunction3D&);
+		void addInequality(const Inequality&);
+		void setInequality(const int&, const Inequality&);
 		
 		// functions regarding the execution of the Function3D
 		int isCallable() const;
 		int isInDomain(const double &x, const double &y, const double &z) const;
+		int classify(const Parallelepiped&) const;
 		double operator()(const double&, const double&, const double&) const;
+		// function that evaluates in single precision(the float function if
+		// present, otherwise the double one rounded)
+		float evaluateFloat(const float&, const float&, const float&) const;
+		// functions to evaluate many points at once, without the domain(the batch function
+		// declared or the source, otherwise one by one). It returns 1 if some values couldn't
+		// be computed
+		int hasBatch() const;
+		int evaluateBatch(const double*, const double*, const double*, double*, const size_t&) const;
+		// function to compare two Function3D(same function and inequalities)
+		int operator==(const Function3D&) const;
 
 		// function to set the state of the Function3D
 		void setState(const int&);
-		// function to access the inequalities
+		// function to access the function(R^3->R)
+		doubleFunction3D getFunction() const;
+		// functions to access the inequalities
 		const Inequality& getInequality(const int&) const;
+		int getInequalityCount() const;
+		// functions to choose the order in which inequalities are tested
+		void setEvaluationOrder(const std::vector<unsigned int>&);
+		const std::vector<unsigned int>& getEvaluationOrder() const;
+		// function to attach an object that must outlive "function"(i.e. the
+		// shared library it comes from), copies of the Function3D share it
+		void setOwner(const std::shared_ptr<const void>&);
+		// functions to set the single precision version of the function
+		void setFloatFunction(const floatFunction3D&);
+		int hasFloatFunction() const;
+		// functions to declare the parity of the function along an axis
+		void setParity(const std::string&, const int&);
+		int getParity(const std::string&) const;
+		// functions to declare what's known about the function
+		void setHints(const FunctionHints&);
+		const FunctionHints& getHints() const;
+		// functions to replace the function with an integrand needing its own data,
+		// copies of the Function3D share it
+		void setSource(const std::shared_ptr<const IntegrandSource>&);
+		const IntegrandSource* getSource() const;
+		// functions to give an approximation g of the function with its known integral over
+		// the domain(nullptr removes it): the function is evaluated as f-scale*g, and
+		// Integral3D adds back scale times the known integral
+		void setControlVariate(const doubleFunction3D&, const double&, const double& = 1);
+		int hasControlVariate() const;
+		doubleFunction3D getControl() const;
+		double getControlIntegral() const;
+		void setControlScale(const double&);
+		double getControlScale() const;
 
 	protected:
 		int isLoaded; // flag that indicates if Function3D is properly loaded
-		Inequality first; // first inequality
-		Inequality second; // second inequality
+		std::vector<Inequality> inequalities; // inequalities defining the domain
+		std::vector<unsigned int> order; // order in which inequalities are tested
 		doubleFunction3D function; // function(R^3->R)
+		floatFunction3D floatFunction; // single precision function(nullptr if not given)
+		int parity[3]; // parity declared along x,y,z(PARITY_*)
+		FunctionHints hints; // what's declared about the function
+		std::shared_ptr<const IntegrandSource> source; // integrand replacing "function"(nullptr if not given)
+		std::shared_ptr<const void> owner; // keeps alive the provider of "function"
+		doubleFunction3D control; // approximation subtracted from the function(nullptr if not given)
+		double controlIntegral; // integral of "control" over the domain
+		double controlScale; // multiplier of "control"
 };
 
-// Point3D is an object that describes a point in 3 dimensions.
-class Point3D{
+// VariableTransform maps the coordinates of the box that is integrated into
+// the coordinates of the space, independently along each axis. It's used to
+// integrate over infinite domains: each infinite side is mapped from a finite
+// interval, and the function is multiplied by the jacobian. The points of the
+// interval mapped to infinity have jacobian 0, which assumes that the function
+// decays fast enough(faster than 1/x^2) to have a finite integral.
+class VariableTransform{
 	public:
-		// constructors
-		Point3D();
-		Point3D(const double&, const double&, const double&);
-		Point3D(const Point3D&);
-		
+		// constructor of the identity
+		VariableTransform();
+
 		// destructor
-		~Point3D();
+		~VariableTransform();
 
-		// coordinates (public access)
-		double x;
-		double y;
-		double z;
+		// function to set the transformation of an axis(0,1,2 for x,y,z)
+		void setAxis(const int&, const int&, const double& = 0);
+		int getType(const int&) const;
+		int isIdentity() const;
+		// function to map instead the box [0,1]x[0,pi]x[0,2pi] of the spherical coordinates
+		// (radius,polar angle,azimuth) to the inside of an ellipsoid, given center and semi-axes
+		void setEllipsoid(const double[3], const double[3]);
+		int isEllipsoidal() const;
+
+		// function that maps a point into the space, and returns the jacobian
+		double map(double&, double&, double&) const;
+
+	private:
+		// function that maps a coordinate, and returns the derivative
+		double mapAxis(const int&, double&) const;
+
+		int type[3]; // type of transformation of each axis(TRANSFORM_*)
+		double origin[3]; // finite end of semi-infinite axes
+		int identity; // flag that indicates all axes have TRANSFORM_NONE
+		int ellipsoidal; // flag that indicates the box is in spherical coordinates of an ellipsoid
+		double center[3]; // center of the ellipsoid
+		double semiaxes[3]; // semi-axes of the ellipsoid along x,y,z
 };
 
-// Parallelepiped is an object that describes parallelepiped objects in 3D.
-// The vertex is the "leftmost" point(aka the point with minimum x,y and z).
-// The xwidth,ywidth and zwidth are the width of each side, in the respective
-// coordinate directions.
-class Parallelepiped{
+// IntegrationStats collects information about the last integration.
+// The fill ratio is the fraction of the integration box occupied by the
+// domain, estimated while tightening the box: fillRatioMin counts only the
+// parts surely inside the domain, fillRatioMax also the ones on the border.
+class IntegrationStats{
+	public:
+		// constructor
+		IntegrationStats();
+
+		double boxVolume; // volume of the box integrated
+		double fillRatio; // estimate of domain volume/box volume
+		double fillRatioMin; // lower bound of the fill ratio
+		double fillRatioMax; // upper bound of the fill ratio
+};
+
+// IntegrationRegion is a node of the adaptive region tree built by Integral3D.
+// Leaves keep the rows of the Romberg's table computed so far, so that a later
+// integration can continue them instead of starting over. Nodes that have been
+// split instead keep only their 8 children.
+class IntegrationRegion{
 	public:
 		// constructors
-		Parallelepiped();
-		Parallelepiped(const Point3D&, const double&, const double&, const double&);
-		Parallelepiped(const Parallelepiped&);
-		
+		IntegrationRegion();
+		IntegrationRegion(const Parallelepiped&, const int&);
+
 		// destructor
-		~Parallelepiped();
+		~IntegrationRegion();
 
-		// coordinates
-		Point3D vertex;
-		double xwidth;
-		double ywidth;
-		double zwidth;
+		Parallelepiped domain; // region of space covered
+		int recursion; // depth of the region in the tree
+		std::vector<std::vector<double>> R; // rows of the Romberg's table computed
+		double value; // current approximation of the integral on the region
+		double error; // current error estimate on the region
+		int converged; // flag that indicates the early stop was met
+		int depthLimited; // flag that indicates both MAXN and MAXR were reached
+		int gaussOrder; // order of the Gauss-Legendre rule giving the value(0 if not used)
+		std::vector<IntegrationRegion> children; // subregions(empty for leaves)
+};
+
+// IntegrationState is the memory of a previous integration: the Function3D it
+// refers to and the region tree with every leaf's Romberg's table. Passing it
+// again with a smaller epsilon(or bigger MAXN, MAXR) refines only the leaves
+// that don't meet the new tolerance, reusing every previous evaluation.
+class IntegrationState{
+	public:
+		// constructor
+		IntegrationState();
+
+		// destructor
+		~IntegrationState();
+
+		// function to discard the stored integration
+		void reset();
+		// function to check wether the state refers to the given Function3D
+		int isCompatible(const Function3D&) const;
+		// function to know if there's something stored
+		int isEmpty() const;
+
+	private:
+		friend class Integral3D;
+
+		int hasRoot; // flag that indicates the region tree is built
+		Function3D function; // Function3D the region tree refers to
+		IntegrationRegion root; // root of the region tree
+		double symmetryFactor; // multiplier of the root integral(0 if odd by symmetry)
+		int reduced[3]; // flags of the axes x,y,z whose positive half only is integrated
+		double controlScale; // multiplier of the control variate integrated
+		int ellipsoid; // inequality mapped by the spherical coordinates(0 if none)
+		VariableTransform transform; // map from the region tree coordinates to the space
+		IntegrationStats stats; // information about the domain
+		// settings of the Integral3D the region tree was built with
+		int engine;
+		int precisionMode;
+		int tightBounding;
+		int unboundedMode;
+		int controlScaling;
+		int coordinates;
+};
+
+// IntegrationResult is what an integration returns: the value, the estimate of
+// the error, the INTEGRATION_STATUS_* flags and how much work was done.
+class IntegrationResult{
+	public:
+		// constructor
+		IntegrationResult();
+
+		double value; // value of the integral
+		double error; // estimate of the error
+		int status; // combination of INTEGRATION_STATUS_*
+		long evaluations; // points sampled by this integration(refinements count only the new ones)
+		long regions; // leaves of the region tree
+		IntegrationStats stats; // information about the domain
+		// derivatives of the value with respect to the coefficients "x^2","x","y^2","y","z^2","z","r"
+		// of each inequality, and their errors(empty if not computed)
+		std::vector<std::vector<double>> gradient;
+		std::vector<std::vector<double>> gradientErrors;
+};
+
+// SweepResult is what a level-set sweep returns: the integral for every value of the
+// "r" coefficient of the inequality swept, in the order given, with its error.
+class SweepResult{
+	public:
+		// constructor
+		SweepResult();
+
+		std::vector<double> thresholds; // values of "r"
+		std::vector<double> values; // integral for each value of "r"
+		std::vector<double> errors; // estimate of the error of each integral
+		int status; // combination of INTEGRATION_STATUS_*
+		long evaluations; // points sampled
+		long regions; // leaves of the region tree
+};
+
+// MultiDomainResult is what an integration over many domains returns: the integral over
+// each domain, in the order given, with its error.
+class MultiDomainResult{
+	public:
+		// constructor
+		MultiDomainResult();
+
+		std::vector<double> values; // integral over each domain
+		std::vector<double> errors; // estimate of the error of each integral
+		int status; // combination of INTEGRATION_STATUS_*
+		long evaluations; // points sampled(shared by all the domains)
+		long regions; // leaves of the region tree
+};
+
+// IntegrationJob is an independent integral given to the job runner of Integral3D.
+class IntegrationJob{
+	public:
+		// constructors
+		IntegrationJob();
+		IntegrationJob(const Function3D&, const double& = DEFAULT_ERROR, const int& = DEFAULT_MAXN,
+						const int& = DEFAULT_MAXR);
+
+		Function3D function; // function to integrate
+		double epsilon; // tolerance of the error
+		int MAXN; // maximum depth of Romberg's algorithm
+		int MAXR; // maximum recursion depth
+};
+
+// TuningReport is the outcome of Integral3D::autotune: what the probe of the
+// function measured, the parameters chosen, and the reasons of every choice.
+class TuningReport{
+	public:
+		// constructor
+		TuningReport();
+
+		// measures of the probe
+		double evaluationTime; // seconds per point sampled
+		double order; // observed order of convergence of the trapezoidal rule
+		double estimate; // value of the integral given by the probe
+		double correction; // last correction of the probe's Romberg's table
+		double fillRatio; // estimate of domain volume/box volume
+		// parameters chosen
+		int engine; // ENGINE_*
+		int precisionMode; // PRECISION_MODE_*
+		int MAXN;
+		int MAXR;
+		int threads;
+		double expectedTime; // seconds of the worst case with the parameters chosen
+		std::vector<std::string> reasons; // explanation of each choice
+};
+
+// IntegrationContext is the working data of a single integration. It's kept out
+// of Integral3D, so that concurrent integrations don't write on shared members.
+class IntegrationContext{
+	public:
+		// constructor
+		IntegrationContext(const VariableTransform&, const int& = DEFAULT_ENGINE,
+							const int& = DEFAULT_REGION_THREADS);
+
+		const VariableTransform &transform; // transformation of the region tree
+		int engine; // engine integrating the regions(ENGINE_*)
+		int splitPolicy; // policy of the splits of Romberg's algorithm(SPLIT_POLICY_*)
+		int threads; // threads integrating the subregions of the root
+		int status; // combination of INTEGRATION_STATUS_*
+		long evaluations; // points sampled
+		long regions; // leaves visited
+		TraceWriter *trace; // writer of the points sampled(nullptr if not traced)
+		TraceChunk traceChunk; // points sampled not handed to the writer yet
+
+		// functions to record a point sampled, and to hand the ones left to the writer
+		void record(const double&, const double&, const double&, const double&, const int&, const int&,
+					const int&);
+		void flushTrace();
 };
 
 // Integral3D is an object that performs integrals. It takes in input a Function3D,
-// which posseses 2 inequalities. The class calculate the smaller rectangular domain that
+// which posseses some inequalities. The class calculate the smaller rectangular domain that
 // contains such domain, and on that it performs the integral.
 // The technique on which it integrate is the Romberg's algorithm, with adaptive integration.
+// The integrate functions are const and write only on the state passed, so one Integral3D
+// can serve many threads as long as each uses its own IntegrationState. operator() instead
+// keeps the last integration in the object, and warns on the log stream.
 class Integral3D{
 	public:
 		// constructor
@@ -170,26 +628,128 @@ class Integral3D{
 		// destructor
 		~Integral3D();
 
-		// evaluate integral of Function3D passed
+		// evaluate integral of Function3D passed, reusing the previous integration
+		// if it was on the same Function3D
 		double operator()(const Function3D&, double&, double = DEFAULT_ERROR, int = DEFAULT_MAXN,
 							int = DEFAULT_MAXR);
+		// evaluate integral of Function3D passed, continuing the given state
+		double operator()(const Function3D&, IntegrationState&, double&, double = DEFAULT_ERROR,
+							int = DEFAULT_MAXN, int = DEFAULT_MAXR);
+		// evaluate integral of Function3D passed from scratch(reentrant)
+		IntegrationResult integrate(const Function3D&, double = DEFAULT_ERROR, int = DEFAULT_MAXN,
+									int = DEFAULT_MAXR) const;
+		// evaluate integral of Function3D passed, continuing the given state(reentrant
+		// for different states)
+		IntegrationResult integrate(const Function3D&, IntegrationState&, double = DEFAULT_ERROR,
+									int = DEFAULT_MAXN, int = DEFAULT_MAXR) const;
+		// evaluate independent integrals on the given number of threads
+		std::vector<IntegrationResult> integrateJobs(const std::vector<IntegrationJob>&,
+													int = DEFAULT_THREADS) const;
+		// evaluate the integrals over the domains given by many values of the "r" coefficient
+		// of an inequality(numbered from 1), sampling once the biggest domain
+		SweepResult sweep(const Function3D&, const int&, const std::vector<double>&, double = DEFAULT_ERROR,
+							int = DEFAULT_MAXN, int = DEFAULT_MAXR) const;
+		// evaluate the integrals of the function over many domains(each given by 2 inequalities,
+		// the ones of the Function3D aren't used), sampling once the union of their boxes
+		MultiDomainResult integrateDomains(const Function3D&, const std::vector<std::pair<Inequality,Inequality>>&,
+											double = DEFAULT_ERROR, int = DEFAULT_MAXN, int = DEFAULT_MAXR) const;
+		// function to forget the previous integration
+		void resetState();
+		// functions to get information about the last integration
+		const IntegrationStats& getStats() const;
+		int getApproximationFlag() const;
+		// functions to choose if the box is tightened using all inequalities together
+		void setTightBounding(const int&);
+		int getTightBounding() const;
+		// functions to choose how the infinite sides of the domain are handled
+		void setUnboundedMode(const int&);
+		int getUnboundedMode() const;
+		// functions to choose the coordinates of the box integrated(COORDINATES_*)
+		void setCoordinates(const int&);
+		int getCoordinates() const;
+		// functions to choose the precision of the trapezoidal sums
+		void setPrecisionMode(const int&);
+		int getPrecisionMode() const;
+		// functions to choose the engine of the integration
+		void setEngine(const int&);
+		int getEngine() const;
+		// functions to choose when the regions of Romberg's algorithm are split(SPLIT_POLICY_*)
+		void setSplitPolicy(const int&);
+		int getSplitPolicy() const;
+		// functions to choose the batches kept in flight by the breadth-first engine, if the
+		// function can be evaluated asynchronously(1 evaluates them one at a time)
+		void setInFlight(const int&);
+		int getInFlight() const;
+		// functions to choose the threads integrating the subregions of an integral
+		void setThreads(const int&);
+		int getThreads() const;
+		// functions to choose if the derivatives with respect to the coefficients of the
+		// inequalities are computed with the value
+		void setSensitivities(const int&);
+		int getSensitivities() const;
+		// functions to choose how the multiplier of the control variate of a function is
+		// chosen(CONTROL_SCALING_*), and to estimate it
+		void setControlScaling(const int&);
+		int getControlScaling() const;
+		double estimateControlScale(const Function3D&) const;
+		// functions to record the points sampled(nullptr stops recording)
+		void setTrace(const std::shared_ptr<TraceWriter>&);
+		const std::shared_ptr<TraceWriter>& getTrace() const;
+		// functions to choose the parameters probing the function, and to use them
+		TuningReport autotune(const Function3D&, double = DEFAULT_ERROR) const;
+		void applyTuning(const TuningReport&);
 
 	private:
 		// private functions to perform math operations:
 
 		// functions related to the evaluation of the integral
-		double rombergIntegral(const Function3D&, const Parallelepiped&, const double&, double&, const int& = DEFAULT_MAXN,
-								const int& = DEFAULT_MAXR, const int& = ZERO_STATE);
-		double directionedTrapezoidIntegral(const Function3D&, const Parallelepiped&, const int&) const;
+		double rombergIntegral(const Function3D&, IntegrationRegion&, const double&, double&, IntegrationContext&,
+								const int& = DEFAULT_MAXN, const int& = DEFAULT_MAXR) const;
+		double regionIntegral(const Function3D&, IntegrationRegion&, const double&, double&, IntegrationContext&,
+								const int&, const int&) const;
+		double hybridIntegral(const Function3D&, IntegrationRegion&, const double&, double&, IntegrationContext&,
+								const int&, const int&) const;
+		double gaussIntegral(const Function3D&, const Parallelepiped&, double&, IntegrationContext&,
+								const int&) const;
+		double constantIntegral(const Function3D&, const Parallelepiped&) const;
+		double integrateChildren(const Function3D&, IntegrationRegion&, const double&, double&,
+									IntegrationContext&, const int&, const int&) const;
+		void rombergStep(const Function3D&, IntegrationRegion&, IntegrationContext&) const;
+		int splitEarly(const IntegrationRegion&, const double&, const int&) const;
+		double directionedTrapezoidIntegral(const Function3D&, const Parallelepiped&, const int&,
+											IntegrationContext&, const int&, const int&) const;
 
 		// functions related to the domain management
-		Parallelepiped rectanglifyDomain(const Function3D&) const;
+		Parallelepiped rectanglifyDomain(const Function3D&, VariableTransform* = nullptr) const;
+		void transformAxis(double&, double&, const int&, VariableTransform&) const;
+		Parallelepiped integrationBox(const Function3D&, VariableTransform&, IntegrationStats&, int&) const;
+		int ellipsoidalDomain(const Function3D&, Parallelepiped&, VariableTransform&) const;
+		Parallelepiped tightenDomain(const Function3D&, const Parallelepiped&, IntegrationStats&) const;
+		void tightenStep(const Function3D&, const Parallelepiped&, const int&, double[6], double&, double&) const;
 		void applyInequality(const Inequality&, double&, double&, double&, double&, double&, double&) const;
 		void makeDomainFinite(double&, double&, double&, double&, double&, double&) const;
 		void getRange(const Inequality&, const std::string&, double&, double&) const;
 		void splitDomain(const Parallelepiped&, std::vector<Parallelepiped>&) const;
+		std::vector<unsigned int> selectivityOrder(const Function3D&, const Parallelepiped&,
+													const VariableTransform&) const;
+		int isSymmetric(const Function3D&, const Parallelepiped&, const std::string&) const;
+		double symmetryReduction(const Function3D&, Parallelepiped&, int* = nullptr) const;
+		double controlScale(const Function3D&, const Parallelepiped&, const VariableTransform&) const;
 
-		int approximationFlag;
+		int approximationFlag; // flag of the last integration done by operator()
+		int engine; // engine of the integration(ENGINE_*)
+		int splitPolicy; // policy of the splits of Romberg's algorithm(SPLIT_POLICY_*)
+		int precisionMode; // precision used by directionedTrapezoidIntegral
+		int tightBounding; // flag that indicates if the box is tightened
+		int unboundedMode; // handling of infinite sides(UNBOUNDED_MODE_*)
+		int coordinates; // coordinates of the box integrated(COORDINATES_*)
+		int threads; // threads integrating the subregions of the root
+		int inFlight; // batches kept in flight by the breadth-first engine
+		int sensitivities; // flag that indicates the derivatives are computed
+		int controlScaling; // choice of the multiplier of the control variate(CONTROL_SCALING_*)
+		std::shared_ptr<TraceWriter> trace; // writer of the points sampled(nullptr if not traced)
+		IntegrationStats stats; // information about the last integration
+		IntegrationState state; // state of the last integration
 };
 
 #endif // end of library guardian
\ No newline at end of file
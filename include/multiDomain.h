@@ -0,0 +1,59 @@
+// Library for the integrals of one function over many domains(i.e. the cells of a partition
+// of the space, or overlapping shells), computed from one sampling of the union of their boxes.
+
+#ifndef _MULTIDOMAIN_LIB
+#define _MULTIDOMAIN_LIB
+
+#include <iostream>
+#include <vector>
+#include <utility>
+#include <cmath>
+
+#include "../include/math3D.h"
+
+// DomainLevel is the trapezoidal grid of a region at a level: 2^level intervals along
+// each axis, with the points stored x fastest.
+struct DomainLevel{
+	int intervals; // intervals along each axis
+	std::vector<char> inside; // flag of each point for each domain reaching the region(domains fastest)
+	std::vector<double> values; // value of the function(0 outside every domain)
+};
+
+// MultiDomain integrates a function over many domains given by 2 inequalities each. The
+// regions are the ones of Romberg's algorithm over the box containing all the domains: each
+// region keeps only the domains that may reach it, and its points are evaluated once if they
+// are in any of them, then added to the trapezoidal sum of each domain they're in. A region
+// gets finer grids up to MAXN levels, then it's split, until the difference of the last two
+// grids meets the tolerance for every domain reaching it.
+class MultiDomain{
+	public:
+		// constructor
+		MultiDomain(const Function3D&, const std::vector<std::pair<Inequality,Inequality>>&);
+
+		// destructor
+		~MultiDomain();
+
+		// function that returns the Function3D of a domain(with the function integrated)
+		const Function3D& getDomain(const size_t&) const;
+		// function that integrates over the box, writing the integrals into the result
+		void integrate(const Parallelepiped&, const double&, const int&, const int&, MultiDomainResult&);
+
+	private:
+		// function that integrates a region, given the domains reaching its parent and which
+		// of them have it all inside, adding its contribution
+		void region(const Parallelepiped&, const std::vector<size_t>&, const std::vector<char>&, const double&,
+					const int&, const int&, const int&, MultiDomainResult&);
+		// function that computes the grid of a level, reusing the points of the previous one
+		void sample(const Parallelepiped&, const std::vector<size_t>&, const std::vector<char>&,
+					const DomainLevel&, DomainLevel&, MultiDomainResult&) const;
+		// function that computes the integral of a grid over the part of the region in some
+		// domain, and over each domain reaching it
+		double sums(const Parallelepiped&, const DomainLevel&, const size_t&, std::vector<double>&) const;
+
+		Function3D function; // function integrated(its inequalities aren't used)
+		std::vector<Function3D> domains; // function restricted to each domain
+		std::vector<double> values; // integral over each domain
+		std::vector<double> errors; // error of each integral
+};
+
+#endif // end of library guardian
@@ -0,0 +1,57 @@
+// Library for the derivatives of an integral with respect to the coefficients of the
+// inequalities of its domain. Moving the border of an inequality changes the integral by
+// an integral over the border, computed with a smoothed delta on the leaves of the region
+// tree near the border.
+
+#ifndef _SENSITIVITY_LIB
+#define _SENSITIVITY_LIB
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+
+#include "../include/math3D.h"
+#include "../include/gaussLegendre.h"
+
+// width of the smoothed delta, over the smallest side of the leaves crossing the border
+#define SENSITIVITY_WIDTH 0.5
+// points per axis of the Gauss-Legendre rule on the cells covering the border
+#define SENSITIVITY_GAUSS_ORDER 4
+// coefficients of an inequality: x^2,x,y^2,y,z^2,z,r
+#define SENSITIVITY_COEFFICIENTS 7
+
+// BoundarySensitivity computes the derivatives of the integral of a Function3D with respect
+// to the coefficients c of each inequality g>0(or g<0). The derivative is the integral of
+// f*dg/dc*delta(g) over the rest of the domain, where delta is smoothed on the inside of the
+// border only, so the function is never evaluated outside the domain. The width of the delta
+// follows the smallest leaves of the region tree on the border, and the difference with a
+// delta twice as wide gives the error.
+class BoundarySensitivity{
+	public:
+		// constructor, given the root of the region tree, the multiplier of its integral and
+		// the axes whose positive half only is integrated(as IntegrationState)
+		BoundarySensitivity(const Function3D&, const IntegrationRegion&, const double&, const int[3]);
+
+		// destructor
+		~BoundarySensitivity();
+
+		// function that computes the derivatives for every inequality, adding the points sampled
+		// to be noted that it returns 1 if some values couldn't be evaluated(0 otherwise)
+		int compute(std::vector<std::vector<double>>&, std::vector<std::vector<double>>&, long&) const;
+
+	private:
+		// function that collects the leaves of the region tree
+		void collect(const IntegrationRegion&);
+		// function that computes the derivatives for the n-th inequality
+		int compute(const int&, std::vector<double>&, std::vector<double>&, long&) const;
+
+		Function3D function; // function integrated(without its control variate)
+		double factor; // multiplier of the integral on the leaves
+		int reduced[3]; // flags of the axes whose positive half only is integrated
+		std::vector<Parallelepiped> leaves; // leaves of the region tree
+};
+
+#endif // end of library guardian
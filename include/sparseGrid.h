@@ -0,0 +1,81 @@
+// Library for the integration of smooth functions on sparse grids(Smolyak's
+// construction), with nested Clenshaw-Curtis rules and dimension-adaptive refinement.
+
+#ifndef _SPARSEGRID_LIB
+#define _SPARSEGRID_LIB
+
+#include <iostream>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
+#include <cmath>
+
+#include "../include/math3D.h"
+
+// biggest level of the 1D rules: 2^(level-1)+1 points, whose index on the finest
+// grid must fit in SPARSE_GRID_INDEX_BITS bits
+#define SPARSE_GRID_MAX_LEVEL 21
+#define SPARSE_GRID_INDEX_BITS 21
+
+// ClenshawCurtisRule is the 1D rule of a level on [-1,1]: level 1 is the midpoint,
+// level l>1 has the 2^(l-1)+1 extrema of the Chebyshev polynomial. The rules are
+// nested, so the difference with the previous level only needs these points.
+class ClenshawCurtisRule{
+	public:
+		// constructors
+		ClenshawCurtisRule();
+		ClenshawCurtisRule(const int&, const int&);
+
+		// destructor
+		~ClenshawCurtisRule();
+
+		std::vector<double> nodes; // points in [-1,1]
+		std::vector<double> weights; // weights of the rule
+		std::vector<double> differences; // weights of the rule minus the ones of the previous level
+		std::vector<uint32_t> indices; // index of the points on the grid of the finest level
+};
+
+// SparseGrid integrates a Function3D over a box with the combination of the tensor
+// products of the differences of ClenshawCurtisRule(Smolyak's formula). Starting from
+// the 27 points of level 2 on every axis, the difference with the biggest contribution
+// is refined along each axis(dimension-adaptive), until the contributions of the ones
+// not refined yet are below the tolerance. Every value is cached by the indices of the
+// point on the finest grid, so points shared by many differences are evaluated once.
+class SparseGrid{
+	public:
+		// constructor
+		SparseGrid(const Parallelepiped&, const VariableTransform&, const int&, const int&);
+
+		// destructor
+		~SparseGrid();
+
+		// function that integrates, adding its work to the context
+		double integrate(const Function3D&, const double&, double&, IntegrationContext&);
+		// function that checks if some node fell outside the domain, where the function
+		// jumps to 0 and the error estimated from the smooth rules can't be trusted
+		int cutsDomain() const;
+
+	private:
+		// function that returns the rule of a level, built when first needed
+		const ClenshawCurtisRule& rule(const int&);
+		// function that computes the contribution of the difference of the given levels
+		double difference(const Function3D&, const int[3], IntegrationContext&);
+		// function that evaluates with one batch the points of a difference not cached yet
+		void prefetch(const Function3D&, const int[3], IntegrationContext&);
+		// function that evaluates the function in a point of the grid
+		double sample(const Function3D&, const int[3], const int[3], IntegrationContext&);
+		// function that checks if the differences before the given one are computed
+		int isAdmissible(const int[3]) const;
+
+		Parallelepiped domain; // box integrated
+		const VariableTransform &transform; // map from the box to the space
+		int maxLevel; // biggest level of the rules
+		int precisionMode; // PRECISION_MODE_FLOAT evaluates in single precision
+		std::vector<ClenshawCurtisRule> rules; // rules of each level(index 0 unused, empty if not built)
+		std::unordered_map<uint64_t,double> values; // values cached by packed indices
+		std::unordered_set<int> computed; // levels of the differences already refined
+		int outside; // 1 if a node with a finite point was outside the domain
+};
+
+#endif // end of library guardian
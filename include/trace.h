@@ -0,0 +1,111 @@
+// Library to record the points sampled by an integration into a binary file,
+// written by a background thread so the integration doesn't wait for the disk.
+
+#ifndef _TRACE_LIB
+#define _TRACE_LIB
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+#include "../include/error.h"
+
+// the file starts with TRACE_MAGIC and the version, then chunks follow: the number
+// of points(uint32), then the columns x, y, z, value(double), inDomain, level(uint8)
+// and depth(uint16), each with that number of entries
+#define TRACE_MAGIC "I3DTRACE"
+#define TRACE_MAGIC_SIZE 8
+#define TRACE_VERSION 1
+// points in a chunk: the buffer filled by the integration is handed to the writer when full
+#define TRACE_CHUNK_SIZE 65536
+// level of the points of the Gauss-Legendre rules, which have no Romberg's level
+#define TRACE_LEVEL_GAUSS 255
+
+// TraceChunk is a block of points sampled, stored by column.
+class TraceChunk{
+	public:
+		// constructor
+		TraceChunk();
+
+		// functions to fill and empty the chunk
+		void add(const double&, const double&, const double&, const double&, const int&, const int&,
+					const int&);
+		void clear();
+		void swap(TraceChunk&);
+		size_t size() const;
+
+		std::vector<double> x; // coordinates of the points
+		std::vector<double> y;
+		std::vector<double> z;
+		std::vector<double> value; // value of the function(0 outside the domain)
+		std::vector<uint8_t> inDomain; // flag that indicates the point is in the domain
+		std::vector<uint8_t> level; // row of the Romberg's table(TRACE_LEVEL_GAUSS for Gauss' rules)
+		std::vector<uint16_t> depth; // recursion depth of the region
+};
+
+// TraceWriter writes chunks to a file on a background thread. Two chunks are kept: one
+// waiting and one being written, so a full chunk is handed over by swapping buffers, and
+// the integration waits only if the disk is slower than the sampling.
+class TraceWriter{
+	public:
+		// constructor
+		TraceWriter();
+		// destructor
+		~TraceWriter();
+
+		// functions to manage the file
+		// to be noted that they return the state of the operation(0: okay, 1: error)
+		int open(const std::string&);
+		int close();
+		int isOpen() const;
+
+		// function that hands a chunk to the writer, and gives back an empty one(the points
+		// are dropped if no file is open)
+		void submit(TraceChunk&);
+		// function that returns the number of points written(or waiting to be)
+		size_t getPoints() const;
+
+	private:
+		TraceWriter(const TraceWriter&) = delete;
+		TraceWriter& operator=(const TraceWriter&) = delete;
+
+		// function run by the background thread
+		void run();
+		// function that writes a chunk to the file
+		void write(const TraceChunk&);
+
+		std::ofstream file; // file written
+		std::thread writer; // background thread
+		mutable std::mutex mutex; // guards the members below
+		std::condition_variable changed; // signals a chunk waiting, or a chunk written
+		TraceChunk waiting; // chunk handed over, not yet taken by the writer
+		TraceChunk writing; // chunk being written
+		int hasWaiting; // flag that indicates "waiting" is full
+		int stop; // flag that asks the writer to end
+		size_t points; // points handed over
+		int failed; // flag that indicates a write failed
+};
+
+// TraceReader reads back the chunks of a file written by TraceWriter.
+class TraceReader{
+	public:
+		// constructor
+		TraceReader();
+		// destructor
+		~TraceReader();
+
+		// function to open a file, returns the state of the operation(0: okay, 1: error)
+		int open(const std::string&);
+		// function that reads the next chunk, returns 1 at the end of the file(or on error)
+		int read(TraceChunk&);
+
+	private:
+		std::ifstream file; // file read
+};
+
+#endif // end of library guardian
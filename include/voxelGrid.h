@@ -0,0 +1,110 @@
+// Library for integrands given as volumetric data: a grid of values read from a
+// file, which is memory mapped and never copied, so files bigger than the memory
+// can be integrated.
+
+#ifndef _VOXELGRID_LIB
+#define _VOXELGRID_LIB
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+#include <cmath>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../include/error.h"
+#include "../include/math3D.h"
+
+// first line of the files with a header, which is made of "name values" lines
+// up to a line "end"(i.e. "dims 64 64 64", "spacing 0.1 0.1 0.1", "origin 0 0 0",
+// "type float32"); the values follow the newline of "end"
+#define VOXEL_HEADER_MAGIC "INTEGRAL3D_VOXELS"
+#define VOXEL_HEADER_END "end"
+#define VOXEL_HEADER_MAX_LINES 64
+// types of the values, stored in the byte order of the machine
+#define VOXEL_TYPE_FLOAT32 0
+#define VOXEL_TYPE_FLOAT64 1
+// times a cell crossing the border of the domain can be split in 8
+#define VOXEL_BOUNDARY_DEPTH 4
+
+// VoxelLayout describes how the values are stored: value (i,j,k) is at
+// origin+(i*spacing[0],j*spacing[1],k*spacing[2]), and is the (i+dims[0]*(j+dims[1]*k))-th
+// after the first "offset" bytes of the file(x varies fastest).
+class VoxelLayout{
+	public:
+		// constructor
+		VoxelLayout();
+
+		size_t dims[3]; // number of values along x,y,z(at least 2)
+		double spacing[3]; // distance between values along x,y,z
+		double origin[3]; // coordinates of the value (0,0,0)
+		int type; // VOXEL_TYPE_*
+		size_t offset; // bytes before the first value
+};
+
+// VoxelGrid is an integrand that interpolates trilinearly the values of a memory mapped
+// file, and is 0 outside of the grid. Its integral over a domain is computed walking the
+// cells in the order they are stored: cells inside the domain are integrated exactly, the
+// ones outside are skipped without reading them, and the ones crossing the border are
+// split in 8 as the regions of the engines. Pages already integrated are released, so
+// the file is read once, in order.
+class VoxelGrid : public IntegrandSource{
+	public:
+		// constructor
+		VoxelGrid();
+		// destructor
+		~VoxelGrid();
+
+		// functions to map a file with a header, or a raw one with the given layout
+		// to be noted that they return the state of the operation(0: okay, 1: error)
+		int open(const std::string&);
+		int open(const std::string&, const VoxelLayout&);
+		int close();
+		int isOpen() const;
+
+		// functions to access the grid
+		const VoxelLayout& getLayout() const;
+		Parallelepiped getBox() const;
+		double value(const size_t&, const size_t&, const size_t&) const;
+
+		// functions of the integrand(from IntegrandSource)
+		double operator()(const double&, const double&, const double&) const;
+		int integrate(const Function3D&, const Parallelepiped&, const double&, double&, double&,
+						IntegrationContext&) const;
+
+	private:
+		VoxelGrid(const VoxelGrid&) = delete;
+		VoxelGrid& operator=(const VoxelGrid&) = delete;
+
+		// function that reads the header at the beginning of the file into the layout
+		int readHeader(const std::string&, VoxelLayout&) const;
+		// function that reads the 8 values at the corners of the cell (i,j,k)
+		void corners(const size_t&, const size_t&, const size_t&, double[8]) const;
+		// function that counts the cells inside the box crossing the border of the domain
+		size_t countBoundary(const Function3D&, const double[3], const double[3], const size_t[3],
+								const size_t[3]) const;
+		// function that integrates a part of a cell crossing the border of the domain
+		double boundaryCell(const Function3D&, const double[8], const double[3], const double[3],
+							const double[3], const double&, const int&, double&, IntegrationContext&) const;
+		// function that gives the pages before the given byte back to the system
+		void release(const size_t&) const;
+
+		VoxelLayout layout; // how the values are stored
+		void *map; // file mapped(nullptr if not open)
+		size_t mapSize; // bytes mapped
+		const unsigned char *data; // first value
+};
+
+// function that replaces the function of the Function3D with the grid, which is then shared
+// by all its copies. The grid bounds the domain, and the hints of the function are dropped
+// to be noted that the function returns the state of the operation(0: okay, 1: error)
+int loadVoxelGrid(const std::shared_ptr<const VoxelGrid>&, Function3D&);
+
+#endif // end of library guardian
@@ -0,0 +1,147 @@
+// Library to evaluate the function of a plugin in other processes, so that a plugin
+// crashing doesn't take the integration down with it. The points are exchanged in
+// batches through memory shared with each worker, with no system call per point.
+
+#ifndef _WORKERPOOL_LIB
+#define _WORKERPOOL_LIB
+
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <limits>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <csignal>
+#include <unistd.h>
+#include <poll.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/signalfd.h>
+
+#include "../include/error.h"
+#include "../include/math3D.h"
+
+// points in a slot of the ring of a worker
+#define WORKER_BATCH_SIZE 4096
+// fewest points given to a worker, smaller batches aren't split between workers
+#define WORKER_MIN_BATCH 256
+// slots of the ring of a worker: batches it can have queued
+#define WORKER_RING_SLOTS 4
+// milliseconds waited for a batch before checking the worker is still running, the
+// wait doubles at each check up to the maximum
+#define WORKER_POLL_MS 1
+#define WORKER_POLL_MAX_MS 100
+// times a batch is given again to a restarted worker before being given up(as NaN)
+#define WORKER_MAX_RESTARTS 3
+
+// WorkerSlot holds a batch of points and, once evaluated, their values.
+struct WorkerSlot{
+	size_t count; // points in the batch
+	double x[WORKER_BATCH_SIZE];
+	double y[WORKER_BATCH_SIZE];
+	double z[WORKER_BATCH_SIZE];
+	double values[WORKER_BATCH_SIZE];
+};
+
+// WorkerRing is the memory shared with a worker. The parent fills the slots in order and
+// posts "requests" once per batch, the worker evaluates them in the same order and posts
+// "results" once per batch.
+struct WorkerRing{
+	sem_t requests; // batches queued
+	sem_t results; // batches evaluated
+	size_t next; // number of batches the worker has evaluated
+	int stop; // flag that asks the worker to end
+	std::atomic<int> running; // flag that the worker is running, cleared by the spawner once it ends
+	WorkerSlot slots[WORKER_RING_SLOTS];
+};
+
+// WorkerSpawn is the answer of the spawner to a request of a worker
+struct WorkerSpawn{
+	pid_t pid; // process of the worker(-1 if it couldn't be forked)
+	int error; // errno of fork
+};
+
+// WorkerPool is an integrand evaluating the function of a Function3D in a pool of worker
+// processes, forked after the plugin is loaded. A batch is split between the workers, and
+// a worker that stops(i.e. on a crash of the plugin) is restarted and given its batches again.
+// Calls of evaluate from many threads each take their share of the workers, and run together.
+// The workers are forked by a spawner process, itself forked by start: the integration may
+// be running on many threads when a worker is restarted, and the program never forks then.
+class WorkerPool : public IntegrandSource{
+	public:
+		// constructor
+		WorkerPool();
+		// destructor
+		~WorkerPool();
+
+		// functions to start the given number of workers(0: one per core) on the
+		// function, and to stop them. Start forks, so it must be called while the
+		// program has one thread
+		// to be noted that they return the state of the operation(0: okay, 1: error)
+		int start(const Function3D&, const int&);
+		int stop();
+		int getWorkers() const;
+		// function that returns the number of workers restarted
+		size_t getRestarts() const;
+
+		// functions of the integrand(from IntegrandSource)
+		double operator()(const double&, const double&, const double&) const;
+		int hasBatch() const;
+		int evaluate(const double*, const double*, const double*, double*, const size_t&) const;
+
+	private:
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool& operator=(const WorkerPool&) = delete;
+
+		// Worker is the parent's view of a worker process
+		struct Worker{
+			pid_t pid; // process(0 if not running), child of the spawner
+			WorkerRing *ring; // shared memory
+			size_t submitted; // batches queued
+			size_t completed; // batches collected
+			int restarts; // restarts while the oldest batch was queued
+			double *targets[WORKER_RING_SLOTS]; // where the values of each slot are copied
+			std::unique_ptr<std::mutex> lock; // held by the call of evaluate using the worker
+		};
+
+		// function that takes the workers used by a call of evaluate, at most its share of
+		// them(the workers over the calls running) and no more than its points need
+		void acquire(std::vector<Worker*>&, const size_t&) const;
+		// function that asks the spawner for the process of a worker
+		int spawn(Worker&) const;
+		// function that waits the oldest batch of a worker and copies its values, restarting
+		// the worker if it stopped. It returns 1 if the batch was given up
+		int collect(Worker&) const;
+		// functions that copy the values of the oldest batch of a worker, or give NaN instead
+		void receive(Worker&) const;
+		void giveUp(Worker&) const;
+		// function that restarts a worker, which evaluates again the batches not collected
+		int restart(Worker&) const;
+
+		Function3D function; // copy keeping the provider of the function alive
+		doubleFunction3D pointFunction; // function evaluated by the workers
+		batchFunction3D batchFunction; // batch function evaluated by the workers(nullptr if not given)
+		mutable std::vector<Worker> workers;
+		mutable std::atomic<size_t> restarts; // workers restarted
+		mutable std::atomic<int> givenUp; // flag that indicates some batch was given up
+		mutable std::atomic<int> single; // flag that indicates some point was evaluated alone
+		mutable std::atomic<int> callers; // calls of evaluate running
+		mutable std::atomic<size_t> turn; // first worker tried by the next call of evaluate
+		pid_t spawner; // process forking the workers(0 if not running)
+		int channel; // socket of the requests to the spawner(-1 if closed)
+		mutable std::mutex channelMutex; // one request at a time goes through the channel
+};
+
+// function that makes the Function3D evaluate its function through the pool, which is then
+// shared by all its copies. The pool must have been started on the same function
+// to be noted that the function returns the state of the operation(0: okay, 1: error)
+int loadWorkerPool(const std::shared_ptr<const WorkerPool>&, Function3D&);
+
+#endif // end of library guardian
@@ -0,0 +1,63 @@
+#include "../include/asyncEvaluator.h"
+
+//===================== AsyncEvaluator Class =====================//
+// constructor on the submit function of the Function3D(which must have one)
+AsyncEvaluator::AsyncEvaluator(const Function3D &function) : submitFunction(function.getHints().submit),
+																inFlight(0){
+}
+
+// destructor that waits the batches in flight, since their arrays belong to the caller
+AsyncEvaluator::~AsyncEvaluator(){
+	std::unique_lock<std::mutex> lock(mutex);
+	completion.wait(lock,[this](){
+		return completed.size()==inFlight;
+	});
+}
+
+// function that submits a batch with its number. The ticket is freed by done
+int AsyncEvaluator::submit(const double *x, const double *y, const double *z, double *values,
+							const size_t &n, const size_t &batch){
+	Ticket *ticket = new Ticket{this,batch};
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		++inFlight;
+	}
+	if(submitFunction(x,y,z,values,n,done,ticket)!=0){
+		delete ticket;
+		std::lock_guard<std::mutex> lock(mutex);
+		--inFlight;
+		return 1;
+	}
+	return 0;
+}
+
+// function that waits a batch given its number, and forgets it
+int AsyncEvaluator::wait(const size_t &batch){
+	std::unique_lock<std::mutex> lock(mutex);
+	std::map<size_t,int>::iterator it;
+	completion.wait(lock,[&](){
+		return (it = completed.find(batch))!=completed.end();
+	});
+	int state = it->second;
+	completed.erase(it);
+	--inFlight;
+	return state!=0;
+}
+
+// function that returns the batches submitted and not waited yet
+size_t AsyncEvaluator::getInFlight() const{
+	std::lock_guard<std::mutex> lock(mutex);
+	return inFlight;
+}
+
+// function called when a batch is done(from the thread of the provider of the function)
+void AsyncEvaluator::done(void *tag, int state){
+	Ticket *ticket = (Ticket*) tag;
+	AsyncEvaluator *owner = ticket->owner;
+	size_t batch = ticket->batch;
+	delete ticket;
+	// notified with the lock held, so that the evaluator can't be destroyed in between
+	std::lock_guard<std::mutex> lock(owner->mutex);
+	owner->completed[batch] = state;
+	owner->completion.notify_all();
+}
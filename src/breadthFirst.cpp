@@ -0,0 +1,289 @@
+#include "../include/breadthFirst.h"
+
+//===================== BreadthFirst Class =====================//
+// constructor of the engine on the box, in the coordinates of the transformation, with the
+// batches kept in flight if the function can be evaluated asynchronously
+BreadthFirst::BreadthFirst(const Parallelepiped &_domain, const VariableTransform &_transform,
+							const int &_MAXN, const int &_MAXR, const int &_precisionMode, const int &_inFlight)
+							: domain(_domain), transform(_transform), MAXN(_MAXN), MAXR(_MAXR),
+							precisionMode(_precisionMode), inFlight(_inFlight),
+							batchPoints(BREADTH_FIRST_BATCH_POINTS), submitted(0){
+}
+
+// empty destructor
+BreadthFirst::~BreadthFirst(){
+}
+
+// function that integrates the box depth after depth. At each depth the rows of the
+// tables of the active regions are added together, and the regions meeting their share
+// of the tolerance(epsilon/8^depth, as in Romberg's engine) stop. The others are split
+// into the next depth, or give their last value if MAXR is reached.
+double BreadthFirst::integrate(const Function3D &function, const double &epsilon, double &finalError,
+								IntegrationContext &context){
+	RegionLevel current, next;
+	std::vector<double> sums;
+	double value = 0, tolerance = epsilon, volume, scale, old, last, temp, difference, best;
+	double halfx, halfy, halfz;
+	size_t r, count, active;
+	int depth, row, j, c;
+	if(domain.xwidth==0 or domain.ywidth==0 or domain.zwidth==0 or MAXN==0){
+		return 0;
+	}
+	// the single precision function has no asynchronous version, and a source replaces the function
+	if(function.getHints().submit!=nullptr and function.getSource()==nullptr and inFlight>1
+		and precisionMode!=PRECISION_MODE_FLOAT){
+		evaluator.reset(new AsyncEvaluator(function));
+	}
+	current.x.push_back(domain.vertex.x);
+	current.y.push_back(domain.vertex.y);
+	current.z.push_back(domain.vertex.z);
+	for(depth=0;!current.x.empty();++depth){
+		count = current.x.size();
+		current.table.assign(count*MAXN,0);
+		current.diagonal.assign(count,0);
+		current.active.assign(count,1);
+		active = count;
+		scale = std::ldexp(1.0,-depth);
+		for(row=0;row<MAXN and active>0;++row){
+			sample(function,current,row,depth,sums,context);
+			// volume of a cell of the lattice of the row
+			temp = scale*std::ldexp(1.0,-row);
+			volume = domain.xwidth*domain.ywidth*domain.zwidth*temp*temp*temp;
+			for(r=0;r<count;++r){
+				if(!current.active[r]){
+					continue;
+				}
+				double *table = &current.table[r*MAXN];
+				if(row==0){
+					table[0] = volume*sums[r];
+					continue;
+				}
+				// the row replaces the previous one, which is needed only by Richardson's extrapolation
+				current.diagonal[r] = table[row-1];
+				old = table[0];
+				table[0] = old/8+volume*sums[r];
+				for(j=1;j<=row;++j){
+					temp = pow(4,j);
+					last = table[j];
+					table[j] = (temp*table[j-1]-old)/(temp-1);
+					old = last;
+				}
+				// 0s are excluded cause it may be not enough refined to find points inside the domain
+				difference = std::fabs(current.diagonal[r]-table[row]);
+				if(difference<tolerance and table[row]!=0 and table[row-1]!=0){
+					current.active[r] = 0;
+					--active;
+					++context.regions;
+					value += table[row];
+					finalError += difference;
+				}
+			}
+		}
+		// the regions left are split in 8, the children are stored in the order of their parents
+		next.x.clear();
+		next.y.clear();
+		next.z.clear();
+		halfx = domain.xwidth*scale/2;
+		halfy = domain.ywidth*scale/2;
+		halfz = domain.zwidth*scale/2;
+		for(r=0;r<count;++r){
+			if(!current.active[r]){
+				continue;
+			}
+			if(depth<MAXR){
+				for(c=0;c<8;++c){
+					next.x.push_back(current.x[r]+(c&1)*halfx);
+					next.y.push_back(current.y[r]+((c>>1)&1)*halfy);
+					next.z.push_back(current.z[r]+((c>>2)&1)*halfz);
+				}
+				continue;
+			}
+			// both MAXN and MAXR are reached, the last value is the "best" one obtained
+			++context.regions;
+			best = current.table[r*MAXN+MAXN-1];
+			if(best!=0){
+				context.status |= INTEGRATION_STATUS_DEPTH_LIMITED;
+			}
+			value += best;
+			finalError += MAXN==1 ? std::fabs(best) : std::fabs(current.diagonal[r]-best);
+		}
+		std::swap(current,next);
+		tolerance /= 8;
+	}
+	return value;
+}
+
+// function that builds the lattice of the new points of a row: the points of the lattice
+// with 2^row intervals per side, without the ones with all even indices(which are on the
+// lattice of the previous row). The first row has all the 8 corners.
+const RowLattice& BreadthFirst::lattice(const int &row){
+	int i, j, k, n = 1<<row;
+	double weight;
+	if((int)lattices.size()<=row){
+		lattices.resize(row+1);
+	}
+	RowLattice &points = lattices[row];
+	if(!points.x.empty()){
+		return points;
+	}
+	for(i=0;i<=n;++i){
+		for(j=0;j<=n;++j){
+			for(k=0;k<=n;++k){
+				if(row>0 and i%2==0 and j%2==0 and k%2==0){
+					continue;
+				}
+				weight = (i==0 or i==n ? 0.5 : 1)*(j==0 or j==n ? 0.5 : 1)*(k==0 or k==n ? 0.5 : 1);
+				points.x.push_back((double)i/n);
+				points.y.push_back((double)j/n);
+				points.z.push_back((double)k/n);
+				points.weights.push_back(weight);
+			}
+		}
+	}
+	return points;
+}
+
+// function that gathers the new points of a row for every active region of a depth, and
+// computes for each region the sum of the weighted values. Points outside the domain or
+// at infinity count 0, and aren't evaluated.
+void BreadthFirst::sample(const Function3D &function, const RegionLevel &level, const int &row,
+							const int &depth, std::vector<double> &sums, IntegrationContext &context){
+	const RowLattice &points = lattice(row);
+	double scale = std::ldexp(1.0,-depth);
+	double xwidth = domain.xwidth*scale, ywidth = domain.ywidth*scale, zwidth = domain.zwidth*scale;
+	double u, v, w, jacobian;
+	int identity = transform.isIdentity();
+	size_t r, p, active = 0;
+	sums.assign(level.x.size(),0);
+	// the batches in flight share the points of the row
+	if(evaluator){
+		for(r=0;r<level.x.size();++r){
+			active += level.active[r];
+		}
+		batchPoints = (active*points.x.size()+inFlight-1)/inFlight;
+		batchPoints = std::max<size_t>(BREADTH_FIRST_MIN_BATCH_POINTS,std::min<size_t>(BREADTH_FIRST_BATCH_POINTS,batchPoints));
+	}
+	for(r=0;r<level.x.size();++r){
+		if(!level.active[r]){
+			continue;
+		}
+		context.evaluations += points.x.size();
+		for(p=0;p<points.x.size();++p){
+			u = level.x[r]+points.x[p]*xwidth;
+			v = level.y[r]+points.y[p]*ywidth;
+			w = level.z[r]+points.z[p]*zwidth;
+			jacobian = identity ? 1 : transform.map(u,v,w);
+			// points at infinity have jacobian 0
+			if(jacobian==0){
+				continue;
+			}
+			if(!function.isInDomain(u,v,w)){
+				if(context.trace!=nullptr){
+					context.record(u,v,w,0,0,row,depth);
+				}
+				continue;
+			}
+			gathered.x.push_back(u);
+			gathered.y.push_back(v);
+			gathered.z.push_back(w);
+			gathered.coefficients.push_back(points.weights[p]*jacobian);
+			gathered.regions.push_back(r);
+			if(gathered.x.size()>=batchPoints){
+				flush(function,row,depth,sums,context);
+			}
+		}
+	}
+	flush(function,row,depth,sums,context);
+	while(!pending.empty()){
+		collect(function,row,depth,sums,context);
+	}
+}
+
+// function that evaluates the points gathered with one call(one by one in single precision),
+// and adds them to the sums of their regions. With the evaluator the batch is submitted instead,
+// after collecting the oldest one if inFlight batches are already in flight.
+void BreadthFirst::flush(const Function3D &function, const int &row, const int &depth,
+							std::vector<double> &sums, IntegrationContext &context){
+	size_t i, n = gathered.x.size();
+	if(n==0){
+		return;
+	}
+	gathered.values.resize(n);
+	gathered.async = 0;
+	if(evaluator){
+		if((int)pending.size()>=inFlight){
+			collect(function,row,depth,sums,context);
+		}
+		gathered.number = submitted++;
+		gathered.async = !evaluator->submit(gathered.x.data(),gathered.y.data(),gathered.z.data(),
+											gathered.values.data(),n,gathered.number);
+	}
+	// evaluated here if synchronous, or if the batch wasn't accepted(a source has no single
+	// precision version, so it's given the batch in that mode too)
+	if(!gathered.async){
+		if(precisionMode==PRECISION_MODE_FLOAT and function.getSource()==nullptr){
+			for(i=0;i<n;++i){
+				gathered.values[i] = function.evaluateFloat(gathered.x[i],gathered.y[i],gathered.z[i]);
+			}
+		}else if(function.evaluateBatch(gathered.x.data(),gathered.y.data(),gathered.z.data(),
+										gathered.values.data(),n)){
+			context.status |= INTEGRATION_STATUS_EVALUATION_FAILED;
+		}
+	}
+	if(evaluator){
+		pending.push_back(std::move(gathered));
+		gathered = LevelBatch();
+		// the memory of a batch collected is reused
+		if(!spare.empty()){
+			gathered = std::move(spare.back());
+			spare.pop_back();
+		}
+		return;
+	}
+	accumulate(gathered,row,depth,sums,context);
+	gathered.x.clear();
+	gathered.y.clear();
+	gathered.z.clear();
+	gathered.coefficients.clear();
+	gathered.regions.clear();
+}
+
+// function that waits the oldest batch in flight and adds it to the sums. The values of a
+// batch not computed are NaN, and the control variate(which isn't in the submit function)
+// is subtracted here.
+void BreadthFirst::collect(const Function3D &function, const int &row, const int &depth,
+							std::vector<double> &sums, IntegrationContext &context){
+	LevelBatch &batch = pending.front();
+	size_t i;
+	if(batch.async){
+		if(evaluator->wait(batch.number)){
+			std::fill(batch.values.begin(),batch.values.end(),std::numeric_limits<double>::quiet_NaN());
+			context.status |= INTEGRATION_STATUS_EVALUATION_FAILED;
+		}
+		if(function.hasControlVariate()){
+			for(i=0;i<batch.x.size();++i){
+				batch.values[i] -= function.getControlScale()*function.getControl()(batch.x[i],batch.y[i],batch.z[i]);
+			}
+		}
+	}
+	accumulate(batch,row,depth,sums,context);
+	batch.x.clear();
+	batch.y.clear();
+	batch.z.clear();
+	batch.coefficients.clear();
+	batch.regions.clear();
+	spare.push_back(std::move(batch));
+	pending.pop_front();
+}
+
+// function that adds the values of a batch, times their coefficients, to the sums of their regions
+void BreadthFirst::accumulate(const LevelBatch &batch, const int &row, const int &depth,
+								std::vector<double> &sums, IntegrationContext &context){
+	size_t i;
+	for(i=0;i<batch.x.size();++i){
+		if(context.trace!=nullptr){
+			context.record(batch.x[i],batch.y[i],batch.z[i],batch.values[i],1,row,depth);
+		}
+		sums[batch.regions[i]] += batch.coefficients[i]*batch.values[i];
+	}
+}
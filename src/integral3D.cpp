@@ -0,0 +1,250 @@
+#include "../include/integral3D.h"
+#include "../include/linker.h"
+
+#include <cstring>
+#include <algorithm>
+
+// size of the options of the first version of the interface, the least accepted
+#define OPTIONS_V1_SIZE (offsetof(integral3d_options,tight_bounding)+sizeof(int))
+
+// SilentLogs discards the logs of the library on the calling thread while it's alive,
+// since the C interface reports everything through its return codes
+struct SilentLogs{
+	SilentLogs(){
+		++silentLogs;
+	}
+	~SilentLogs(){
+		--silentLogs;
+	}
+};
+
+// context of the C interface: the function being built, the Integral3D and the
+// state of the last integration(so that it can be refined)
+struct integral3d_context{
+	doubleFunction3D function; // function to integrate
+	std::vector<Inequality> inequalities; // inequalities defining the domain
+	int parity[3]; // parity declared along x,y,z
+	Function3D loaded; // Function3D loaded from a shared library(keeps it open)
+	int isPluginLoaded; // flag that indicates the function comes from "loaded"
+	Function3D current; // Function3D integrated
+	int changed; // flag that indicates "current" must be rebuilt
+	Integral3D integral;
+	IntegrationState state; // last integration
+};
+
+// function that builds the Function3D to integrate from the context
+static void buildFunction(integral3d_context *context){
+	if(!context->changed){
+		return;
+	}
+	if(context->isPluginLoaded){
+		context->current = context->loaded;
+	}else{
+		context->current = Function3D(context->inequalities,context->function);
+	}
+	context->current.setParity("x",context->parity[0]);
+	context->current.setParity("y",context->parity[1]);
+	context->current.setParity("z",context->parity[2]);
+	context->changed = 0;
+}
+
+int integral3d_api_version(void){
+	return INTEGRAL3D_API_VERSION;
+}
+
+const char* integral3d_status_string(int status){
+	switch(status){
+		case INTEGRAL3D_OK:
+			return "ok";
+		case INTEGRAL3D_ERROR_ARGUMENT:
+			return "invalid argument";
+		case INTEGRAL3D_ERROR_PLUGIN:
+			return "cannot load shared library";
+		case INTEGRAL3D_ERROR_NOT_READY:
+			return "no function to integrate";
+		case INTEGRAL3D_ERROR_INTERNAL:
+			return "internal error";
+	}
+	return "unknown status";
+}
+
+integral3d_context* integral3d_create(void){
+	try{
+		integral3d_context *context = new integral3d_context();
+		context->function = nullptr;
+		context->parity[0] = context->parity[1] = context->parity[2] = PARITY_NONE;
+		context->isPluginLoaded = 0;
+		context->changed = 1;
+		return context;
+	}catch(...){
+		return NULL;
+	}
+}
+
+void integral3d_destroy(integral3d_context *context){
+	SilentLogs silent;
+	delete context;
+}
+
+int integral3d_load_plugin(integral3d_context *context, const char *fileName){
+	SilentLogs silent;
+	unsigned int i;
+	if(context==NULL or fileName==NULL){
+		return INTEGRAL3D_ERROR_ARGUMENT;
+	}
+	try{
+		std::shared_ptr<const Function3D> snapshot = PluginRegistry::instance().snapshot(fileName);
+		if(!snapshot){
+			return INTEGRAL3D_ERROR_PLUGIN;
+		}
+		context->loaded = *snapshot;
+		context->isPluginLoaded = 1;
+		// the inequalities are kept, so that the function can be replaced later
+		context->inequalities.clear();
+		for(i=1;i<=(unsigned int)snapshot->getInequalityCount();++i){
+			context->inequalities.push_back(snapshot->getInequality(i));
+		}
+		context->parity[0] = snapshot->getParity("x");
+		context->parity[1] = snapshot->getParity("y");
+		context->parity[2] = snapshot->getParity("z");
+		context->changed = 1;
+	}catch(...){
+		return INTEGRAL3D_ERROR_INTERNAL;
+	}
+	return INTEGRAL3D_OK;
+}
+
+int integral3d_set_function(integral3d_context *context, integral3d_function function){
+	if(context==NULL or function==NULL){
+		return INTEGRAL3D_ERROR_ARGUMENT;
+	}
+	context->function = function;
+	context->isPluginLoaded = 0;
+	context->changed = 1;
+	return INTEGRAL3D_OK;
+}
+
+int integral3d_add_inequality(integral3d_context *context, const double coefficients[7], int relation){
+	static const char *names[7] = {"x^2","x","y^2","y","z^2","z","r"};
+	static const char *relations[4] = {">",">=","<","<="};
+	std::map<std::string,double> map;
+	SilentLogs silent;
+	int i;
+	if(context==NULL or coefficients==NULL or relation<INTEGRAL3D_GREATER or relation>INTEGRAL3D_LESS_EQUAL){
+		return INTEGRAL3D_ERROR_ARGUMENT;
+	}
+	try{
+		for(i=0;i<7;++i){
+			map[names[i]] = coefficients[i];
+		}
+		map[relations[relation]] = 1;
+		context->inequalities.push_back(Inequality(map));
+		if(context->isPluginLoaded){
+			// the domain isn't the one of the library anymore
+			context->function = context->loaded.getFunction();
+			context->isPluginLoaded = 0;
+		}
+		context->changed = 1;
+	}catch(...){
+		return INTEGRAL3D_ERROR_INTERNAL;
+	}
+	return INTEGRAL3D_OK;
+}
+
+int integral3d_clear_inequalities(integral3d_context *context){
+	if(context==NULL){
+		return INTEGRAL3D_ERROR_ARGUMENT;
+	}
+	context->inequalities.clear();
+	if(context->isPluginLoaded){
+		context->function = context->loaded.getFunction();
+		context->isPluginLoaded = 0;
+	}
+	context->changed = 1;
+	return INTEGRAL3D_OK;
+}
+
+int integral3d_set_parity(integral3d_context *context, int axis, int parity){
+	if(context==NULL or axis<0 or axis>2 or
+		(parity!=PARITY_NONE and parity!=PARITY_EVEN and parity!=PARITY_ODD)){
+		return INTEGRAL3D_ERROR_ARGUMENT;
+	}
+	context->parity[axis] = parity;
+	context->changed = 1;
+	return INTEGRAL3D_OK;
+}
+
+void integral3d_default_options(integral3d_options *options){
+	if(options==NULL){
+		return;
+	}
+	options->size = sizeof(integral3d_options);
+	options->epsilon = DEFAULT_ERROR;
+	options->maxn = DEFAULT_MAXN;
+	options->maxr = DEFAULT_MAXR;
+	options->precision = DEFAULT_PRECISION_MODE;
+	options->unbounded = DEFAULT_UNBOUNDED_MODE;
+	options->tight_bounding = 1;
+}
+
+int integral3d_integrate(integral3d_context *context, const integral3d_options *_options,
+							integral3d_result *result, integral3d_stats *stats){
+	integral3d_options options;
+	IntegrationResult integration;
+	SilentLogs silent;
+	if(context==NULL or result==NULL){
+		return INTEGRAL3D_ERROR_ARGUMENT;
+	}
+	integral3d_default_options(&options);
+	// the fields the caller knows replace the defaults, the newer ones keep them
+	if(_options!=NULL){
+		if(_options->size<OPTIONS_V1_SIZE){
+			return INTEGRAL3D_ERROR_ARGUMENT;
+		}
+		std::memcpy(&options,_options,std::min(_options->size,sizeof(integral3d_options)));
+		options.size = sizeof(integral3d_options);
+	}
+	// invalid modes would be replaced by the defaults, silently
+	if(options.precision<INTEGRAL3D_PRECISION_DOUBLE or options.precision>INTEGRAL3D_PRECISION_LONG_DOUBLE
+		or (options.unbounded!=INTEGRAL3D_UNBOUNDED_TRUNCATE and options.unbounded!=INTEGRAL3D_UNBOUNDED_TRANSFORM)){
+		return INTEGRAL3D_ERROR_ARGUMENT;
+	}
+	if(!context->isPluginLoaded and context->function==nullptr){
+		return INTEGRAL3D_ERROR_NOT_READY;
+	}
+	try{
+		buildFunction(context);
+		Integral3D &integral = context->integral;
+		// the state is discarded by integrate if the settings change
+		if(integral.getPrecisionMode()!=options.precision){
+			integral.setPrecisionMode(options.precision);
+		}
+		if(integral.getUnboundedMode()!=options.unbounded){
+			integral.setUnboundedMode(options.unbounded);
+		}
+		if(integral.getTightBounding()!=options.tight_bounding){
+			integral.setTightBounding(options.tight_bounding);
+		}
+		integration = integral.integrate(context->current,context->state,options.epsilon,
+											options.maxn,options.maxr);
+		result->value = integration.value;
+		result->error = integration.error;
+		result->flags = 0;
+		if(integration.status & INTEGRATION_STATUS_DEPTH_LIMITED){
+			result->flags |= INTEGRAL3D_FLAG_DEPTH_LIMIT;
+		}
+		if(integration.status & INTEGRATION_STATUS_EVALUATION_FAILED){
+			result->flags |= INTEGRAL3D_FLAG_EVALUATION_FAILED;
+		}
+		if(stats!=NULL){
+			const IntegrationStats &integrationStats = integration.stats;
+			stats->box_volume = integrationStats.boxVolume;
+			stats->fill_ratio = integrationStats.fillRatio;
+			stats->fill_ratio_min = integrationStats.fillRatioMin;
+			stats->fill_ratio_max = integrationStats.fillRatioMax;
+		}
+	}catch(...){
+		return INTEGRAL3D_ERROR_INTERNAL;
+	}
+	return INTEGRAL3D_OK;
+}
@@ -0,0 +1,246 @@
+#include "../include/levelSet.h"
+
+//===================== LevelSetSweep Class =====================//
+// constructor that sorts the thresholds by the key from which points are inside: with
+// inequality q+t>0 a point is inside for the values of t above -q, with q+t<0 for the
+// ones below -q. The first cut gives the biggest domain.
+LevelSetSweep::LevelSetSweep(const Function3D &_function, const int &inequality,
+								const std::vector<double> &thresholds)
+								: function(_function), biggest(_function), swept(_function.getInequality(inequality)){
+	std::map<std::string,double> coefficients = swept.getCoefficient();
+	const std::string &disequality = swept.getDisequality();
+	size_t i;
+	sign = disequality[0]=='<' ? -1 : 1;
+	strict = disequality.size()==1;
+	order.resize(thresholds.size());
+	for(i=0;i<order.size();++i){
+		order[i] = i;
+	}
+	std::sort(order.begin(),order.end(),[&](const size_t &a, const size_t &b){
+		return -sign*thresholds[a] < -sign*thresholds[b];
+	});
+	cuts.resize(order.size());
+	for(i=0;i<order.size();++i){
+		cuts[i] = -sign*thresholds[order[i]];
+	}
+	// the known integral of a control variate is for one domain only
+	function.setControlVariate(nullptr,0);
+	biggest.setControlVariate(nullptr,0);
+	// the domain of the inequality is the whole space(0x^2+...+1>0) for "function"
+	function.setInequality(inequality,Inequality(std::map<std::string,double>{{"r",1},{">",1}}));
+	if(!order.empty()){
+		coefficients["r"] = thresholds[order[0]];
+		coefficients[disequality] = 1;
+		biggest.setInequality(inequality,Inequality(coefficients));
+	}
+	wholeValues.assign(cuts.size()+1,0);
+	wholeErrors.assign(cuts.size()+1,0);
+	values.assign(cuts.size(),0);
+	errors.assign(cuts.size(),0);
+}
+
+// empty destructor
+LevelSetSweep::~LevelSetSweep(){
+}
+
+// function that returns the Function3D with the biggest domain of the sweep
+const Function3D& LevelSetSweep::getBiggest() const{
+	return biggest;
+}
+
+// function that integrates over the box, and puts together the contributions of the regions
+void LevelSetSweep::integrate(const Parallelepiped &box, const double &epsilon, const int &MAXN,
+								const int &MAXR, SweepResult &result){
+	double whole = 0, wholeError = 0;
+	size_t i;
+	region(box,epsilon,ZERO_STATE,MAXN,MAXR,result);
+	for(i=0;i<cuts.size();++i){
+		whole += wholeValues[i];
+		wholeError += wholeErrors[i];
+		result.values[order[i]] = whole+values[i];
+		result.errors[order[i]] = wholeError+errors[i];
+	}
+}
+
+// function that integrates a region. The cuts below the keys of the region have it all
+// inside, the ones above(or equal, if strict) have it all outside, and the others cut it.
+// Finer grids are computed until the difference of the last two meets the tolerance, both
+// on the whole region and for every cut, then the region is split as in Romberg's algorithm.
+void LevelSetSweep::region(const Parallelepiped &domain, const double &epsilon, const int &recursion,
+							const int &MAXN, const int &MAXR, SweepResult &result){
+	double low, high, keyLow, keyHigh, r = swept["r"];
+	double whole = 0, previousWhole = 0, error;
+	size_t firstCut, lastCut, i;
+	int level;
+	std::vector<double> cut, previousCut;
+	if(domain.xwidth==0 or domain.ywidth==0 or domain.zwidth==0 or MAXN==0){
+		return;
+	}
+	++result.regions;
+	if(function.classify(domain)==BOX_OUTSIDE){
+		return;
+	}
+	swept.valueRange(domain,low,high);
+	keyLow = sign>0 ? low-r : r-high;
+	keyHigh = sign>0 ? high-r : r-low;
+	firstCut = std::lower_bound(cuts.begin(),cuts.end(),keyLow)-cuts.begin();
+	if(strict){
+		lastCut = std::lower_bound(cuts.begin(),cuts.end(),keyHigh)-cuts.begin();
+	}else{
+		lastCut = std::upper_bound(cuts.begin(),cuts.end(),keyHigh)-cuts.begin();
+	}
+	// outside of every domain of the sweep
+	if(lastCut==0){
+		return;
+	}
+
+	SweepLevel previous, current;
+	previous.intervals = current.intervals = 0;
+	for(level=0;level<MAXN;++level){
+		current.intervals = 1<<level;
+		sample(domain,previous,current,result);
+		whole = sums(domain,current,firstCut,lastCut,cut);
+		if(level>0){
+			// the whole region counts only if some cut has it all inside
+			error = firstCut>0 ? std::fabs(whole-previousWhole) : 0;
+			for(i=0;i<cut.size();++i){
+				error = std::max(error,std::fabs(cut[i]-previousCut[i]));
+			}
+			// 0s are excluded as in Romberg's algorithm, the grid may miss the domain
+			if(error<epsilon and whole!=0 and previousWhole!=0){
+				break;
+			}
+		}
+		std::swap(previous,current);
+		std::swap(previousWhole,whole);
+		std::swap(previousCut,cut);
+	}
+	if(level==MAXN){
+		if(recursion<MAXR){
+			--result.regions; // it's not a leaf anymore
+			double halfx = domain.xwidth/2, halfy = domain.ywidth/2, halfz = domain.zwidth/2;
+			for(i=0;i<8;++i){
+				Point3D vertex(domain.vertex.x+(i&1)*halfx,domain.vertex.y+((i>>1)&1)*halfy,
+								domain.vertex.z+((i>>2)&1)*halfz);
+				region(Parallelepiped(vertex,halfx,halfy,halfz),epsilon/8,recursion+1,MAXN,MAXR,result);
+			}
+			return;
+		}
+		// both MAXN and MAXR are reached, the last grid is the "best" value obtained
+		std::swap(previous,current);
+		std::swap(previousWhole,whole);
+		std::swap(previousCut,cut);
+		if(whole!=0){
+			result.status |= INTEGRATION_STATUS_DEPTH_LIMITED;
+		}
+	}
+	wholeValues[0] += whole;
+	wholeValues[firstCut] -= whole;
+	error = MAXN>1 ? std::fabs(whole-previousWhole) : 0;
+	wholeErrors[0] += error;
+	wholeErrors[firstCut] -= error;
+	for(i=0;i<cut.size();++i){
+		values[firstCut+i] += cut[i];
+		errors[firstCut+i] += MAXN>1 ? std::fabs(cut[i]-previousCut[i]) : 0;
+	}
+}
+
+// function that computes the grid of a level: the points of the previous level(the ones
+// with even indices) are copied, the others are tested and the function is evaluated, with
+// one batch, on the ones inside the biggest domain
+void LevelSetSweep::sample(const Parallelepiped &domain, const SweepLevel &previous, SweepLevel &current,
+							SweepResult &result) const{
+	int n = current.intervals+1, m = previous.intervals+1;
+	int i, j, k, index;
+	double x, y, z;
+	std::vector<double> xs, ys, zs, batch;
+	std::vector<int> indices;
+	current.inside.assign(n*n*n,0);
+	current.key.assign(n*n*n,0);
+	current.values.assign(n*n*n,0);
+	for(k=0;k<n;++k){
+		z = domain.vertex.z+domain.zwidth*k/current.intervals;
+		for(j=0;j<n;++j){
+			y = domain.vertex.y+domain.ywidth*j/current.intervals;
+			for(i=0;i<n;++i){
+				index = i+n*(j+n*k);
+				if(current.intervals>1 and i%2==0 and j%2==0 and k%2==0){
+					int old = i/2+m*(j/2+m*(k/2));
+					current.inside[index] = previous.inside[old];
+					current.key[index] = previous.key[old];
+					current.values[index] = previous.values[old];
+					continue;
+				}
+				x = domain.vertex.x+domain.xwidth*i/current.intervals;
+				current.key[index] = key(x,y,z);
+				current.inside[index] = (strict ? current.key[index]>cuts[0] : current.key[index]>=cuts[0])
+										and function.isInDomain(x,y,z);
+				if(current.inside[index]){
+					xs.push_back(x);
+					ys.push_back(y);
+					zs.push_back(z);
+					indices.push_back(index);
+				}
+			}
+		}
+	}
+	batch.resize(xs.size());
+	if(function.evaluateBatch(xs.data(),ys.data(),zs.data(),batch.data(),batch.size())){
+		result.status |= INTEGRATION_STATUS_EVALUATION_FAILED;
+	}
+	for(i=0;i<(int)batch.size();++i){
+		current.values[indices[i]] = batch[i];
+	}
+	result.evaluations += batch.size();
+}
+
+// function that computes the trapezoidal rule of a grid over the part of the region in the
+// biggest domain, and for the cuts between first and last: the points sorted by key give
+// the integral for a cut as the sum of the ones above it
+double LevelSetSweep::sums(const Parallelepiped &domain, const SweepLevel &grid, const size_t &first,
+							const size_t &last, std::vector<double> &cut) const{
+	int n = grid.intervals+1;
+	int i, j, k, index;
+	double weight, volume;
+	size_t c, position;
+	std::vector<std::pair<double,double>> points; // key and weighted value
+	std::vector<double> keys; // keys of the points, sorted
+	std::vector<double> above; // sum of the weighted values from each point on
+	volume = domain.xwidth*domain.ywidth*domain.zwidth/((double)grid.intervals*grid.intervals*grid.intervals);
+	for(k=0;k<n;++k){
+		for(j=0;j<n;++j){
+			for(i=0;i<n;++i){
+				index = i+n*(j+n*k);
+				if(!grid.inside[index]){
+					continue;
+				}
+				weight = (i==0 or i==n-1 ? 0.5 : 1)*(j==0 or j==n-1 ? 0.5 : 1)*(k==0 or k==n-1 ? 0.5 : 1);
+				points.emplace_back(grid.key[index],weight*grid.values[index]);
+			}
+		}
+	}
+	std::sort(points.begin(),points.end());
+	keys.resize(points.size());
+	above.assign(points.size()+1,0);
+	for(c=points.size();c>0;--c){
+		keys[c-1] = points[c-1].first;
+		above[c-1] = above[c]+points[c-1].second;
+	}
+	cut.resize(last-first);
+	for(c=first;c<last;++c){
+		// first point with key>cut(or key>=cut if not strict)
+		if(strict){
+			position = std::upper_bound(keys.begin(),keys.end(),cuts[c])-keys.begin();
+		}else{
+			position = std::lower_bound(keys.begin(),keys.end(),cuts[c])-keys.begin();
+		}
+		cut[c-first] = volume*above[position];
+	}
+	return volume*above[0];
+}
+
+// function that computes the key of a point: the inequality without "r", with the sign
+// that makes the points inside the ones above the cut
+double LevelSetSweep::key(const double &x, const double &y, const double &z) const{
+	return sign*(swept.value(x,y,z)-swept["r"]);
+}
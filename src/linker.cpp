@@ -1,18 +1,274 @@
 #include "../include/linker.h"
 
 
+//===================== SharedLibrary Class =====================//
+// constructor that takes ownership of an already opened handle
+SharedLibrary::SharedLibrary(const std::string &_libraryName, void *_handle)
+								: libraryName(_libraryName), handle(_handle){
+}
+
+// destructor that closes the handle, reached only when no one uses the library anymore
+SharedLibrary::~SharedLibrary(){
+	if(handle!=nullptr and dlclose(handle)!=0){
+		logStream() << WARNING_LOG << "failed closing the shared library " << libraryName
+					<< ": " << dlerror() << std::endl;
+	}
+}
+
+// function that resolves a symbol, looking it up with dlsym only the first time
+void* SharedLibrary::getSymbol(const std::string &name){
+	std::lock_guard<std::mutex> lock(symbolMutex);
+	std::map<std::string,void*>::const_iterator it = symbols.find(name);
+	if(it != symbols.end()){
+		return it->second;
+	}
+	// the error of a previous call is cleared, so that the one read is of this lookup
+	dlerror();
+	void *symbol = dlsym(handle, name.c_str());
+	const char *error = dlerror();
+	symbols[name] = symbol;
+	if(error!=nullptr){
+		symbolErrors[name] = error;
+	}
+	return symbol;
+}
+
+// function that returns the error of dlsym for a symbol not found(empty if found or not looked up)
+std::string SharedLibrary::getSymbolError(const std::string &name){
+	std::lock_guard<std::mutex> lock(symbolMutex);
+	std::map<std::string,std::string>::const_iterator it = symbolErrors.find(name);
+	return it!=symbolErrors.end() ? it->second : std::string();
+}
+
+// function that returns the name the library was opened with
+const std::string& SharedLibrary::getLibraryName() const{
+	return libraryName;
+}
+
+
+//===================== PluginRegistry Class =====================//
+// private constructor, the registry is only reachable through instance()
+PluginRegistry::PluginRegistry(){
+}
+
+// function that returns the process-wide registry(initialisation is thread-safe)
+PluginRegistry& PluginRegistry::instance(){
+	static PluginRegistry registry;
+	return registry;
+}
+
+// function that returns the library of the given name, opening it only if
+// no one else is holding it already
+std::shared_ptr<SharedLibrary> PluginRegistry::open(const std::string &fileName){
+	std::lock_guard<std::mutex> lock(registryMutex);
+	std::map<std::string,std::weak_ptr<SharedLibrary>>::iterator it;
+	// the libraries closed since the last call are forgotten
+	for(it=libraries.begin();it!=libraries.end();){
+		if(it->second.expired() and it->first!=fileName){
+			it = libraries.erase(it);
+		}else{
+			++it;
+		}
+	}
+	std::shared_ptr<SharedLibrary> library = libraries[fileName].lock();
+	if(library){
+		return library;
+	}
+	// RTLD_LAZY means that unresolved symbols are not resolved until used
+	void *handle = dlopen(fileName.c_str(), RTLD_LAZY);
+	if(handle==nullptr){
+		logStream() << ERROR_LOG << "cannot open shared library: " << dlerror() << std::endl;
+		libraries.erase(fileName);
+		return nullptr;
+	}
+	library = std::make_shared<SharedLibrary>(fileName, handle);
+	libraries[fileName] = library;
+	return library;
+}
+
+// function that creates a Function3D from the library, which keeps the library
+// open for as long as the snapshot(or any copy of it) is alive
+std::shared_ptr<const Function3D> PluginRegistry::snapshot(const std::string &fileName,
+											const std::string &functionName,
+											const std::string &inequality1Name,
+											const std::string &inequality2Name,
+											const std::string &inequalitiesName){
+	std::shared_ptr<SharedLibrary> library = open(fileName);
+	if(!library){
+		return nullptr;
+	}
+	std::shared_ptr<Function3D> function = std::make_shared<Function3D>();
+	if(linkFunction3D(library, *function, functionName, inequality1Name, inequality2Name, inequalitiesName)){
+		return nullptr;
+	}
+	return function;
+}
+
+
+//===================== Linking functions =====================//
+// function that declares on the Function3D the parity given for each axis
+int loadParity(const std::map<std::string,std::string> &parity, Function3D &function){
+	for(const auto &element : parity){
+		if(element.first!="x" and element.first!="y" and element.first!="z"){
+			logStream() << ERROR_LOG << "parity of non-existent axis " << element.first << std::endl;
+			return 1;
+		}
+		if(element.second=="even"){
+			function.setParity(element.first,PARITY_EVEN);
+		}else if(element.second=="odd"){
+			function.setParity(element.first,PARITY_ODD);
+		}else if(element.second=="none"){
+			function.setParity(element.first,PARITY_NONE);
+		}else{
+			logStream() << ERROR_LOG << "parity should be one of: even, odd, none." << std::endl;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// macro that checks if the field of the plugin information is within its size
+#define HAS_PLUGIN_FIELD(info, field) \
+	((info).size>=offsetof(integral3d_plugin_info,field)+sizeof((info).field))
+
+// function that declares on the Function3D the information of the plugin
+int loadPluginInfo(const integral3d_plugin_info &info, Function3D &function){
+	FunctionHints hints = function.getHints();
+	const char *axes[3] = {"x","y","z"};
+	int i;
+	if(!HAS_PLUGIN_FIELD(info,flags) or info.version<1){
+		logStream() << ERROR_LOG << "malformed " << INTEGRAL3D_PLUGIN_INFO_SYMBOL << "." << std::endl;
+		return 1;
+	}
+	if(info.version>INTEGRAL3D_PLUGIN_INFO_VERSION){
+		logStream() << WARNING_LOG << INTEGRAL3D_PLUGIN_INFO_SYMBOL << " version " << info.version
+					<< " is newer than " << INTEGRAL3D_PLUGIN_INFO_VERSION << ", new fields are ignored." << std::endl;
+	}
+	hints.threadSafe = (info.flags & INTEGRAL3D_HINT_THREAD_SAFE)!=0;
+	if(HAS_PLUGIN_FIELD(info,batch)){
+		hints.batch = info.batch;
+	}
+	if(info.version>=2 and HAS_PLUGIN_FIELD(info,submit)){
+		hints.submit = info.submit;
+	}
+	if(HAS_PLUGIN_FIELD(info,cost) and info.cost>0){
+		hints.cost = info.cost;
+	}
+	if(HAS_PLUGIN_FIELD(info,smoothness)){
+		if(info.smoothness<SMOOTHNESS_UNKNOWN or info.smoothness>SMOOTHNESS_SMOOTH){
+			logStream() << ERROR_LOG << "unknown smoothness in " << INTEGRAL3D_PLUGIN_INFO_SYMBOL << "." << std::endl;
+			return 1;
+		}
+		hints.smoothness = info.smoothness;
+	}
+	if(HAS_PLUGIN_FIELD(info,parity)){
+		for(i=0;i<3;++i){
+			if(info.parity[i]!=PARITY_NONE){
+				function.setParity(axes[i],info.parity[i]);
+			}
+		}
+	}
+	if((info.flags & INTEGRAL3D_HINT_BOUNDING_BOX) and HAS_PLUGIN_FIELD(info,bounding_box)){
+		const double *box = info.bounding_box;
+		if(!(box[0]<=box[1] and box[2]<=box[3] and box[4]<=box[5])){
+			logStream() << ERROR_LOG << "empty bounding box in " << INTEGRAL3D_PLUGIN_INFO_SYMBOL << "." << std::endl;
+			return 1;
+		}
+		hints.hasBoundingBox = 1;
+		hints.boundingBox = Parallelepiped(Point3D(box[0],box[2],box[4]),box[1]-box[0],box[3]-box[2],box[5]-box[4]);
+	}
+	if((info.flags & INTEGRAL3D_HINT_CONSTANT) and HAS_PLUGIN_FIELD(info,constant)){
+		hints.isConstant = 1;
+		hints.constant = info.constant;
+	}
+	function.setHints(hints);
+	return 0;
+}
+
+// function that loads the "double f(double,double,double)" and the inequalities(2 maps,
+// and the optional vector of maps) from the library into the Function3D, which is also
+// made owner of the library. The parity, the control variate and integral3d_plugin_info are
+// loaded if present.
+int linkFunction3D(const std::shared_ptr<SharedLibrary> &library, Function3D &function,
+					const std::string &functionName, const std::string &inequality1Name,
+					const std::string &inequality2Name, const std::string &inequalitiesName){
+	// Load the symbol for the function, 2 maps and vector of maps
+	doubleFunction3D f = (doubleFunction3D) library->getSymbol(functionName);
+	std::map<std::string,double> *temp1 = (std::map<std::string,double>*) library->getSymbol(inequality1Name);
+	std::map<std::string,double> *temp2 = (std::map<std::string,double>*) library->getSymbol(inequality2Name);
+	std::vector<std::map<std::string,double>> *temp3 = (std::vector<std::map<std::string,double>>*)
+															library->getSymbol(inequalitiesName);
+	std::vector<Inequality> inequalities;
+	unsigned int i;
+	// check wether symbols have been properly resolved, the 2 maps are
+	// mandatory only if the vector is missing
+	if (!f){
+		logStream() << ERROR_LOG << "cannot load symbol " << functionName << " from "
+					<< library->getLibraryName() << ": " << library->getSymbolError(functionName) << std::endl;
+		return 1;
+	}
+	if(!temp1 and !temp3){
+		logStream() << ERROR_LOG << "cannot load symbol " << inequality1Name << " from "
+					<< library->getLibraryName() << ": " << library->getSymbolError(inequality1Name) << std::endl;
+		return 1;
+	}
+	if(!temp2 and !temp3){
+		logStream() << ERROR_LOG << "cannot load symbol " << inequality2Name << " from "
+					<< library->getLibraryName() << ": " << library->getSymbolError(inequality2Name) << std::endl;
+		return 1;
+	}
+	if(temp1){
+		inequalities.push_back(Inequality(*temp1));
+	}
+	if(temp2){
+		inequalities.push_back(Inequality(*temp2));
+	}
+	if(temp3){
+		for(i=0;i<temp3->size();++i){
+			inequalities.push_back(Inequality((*temp3)[i]));
+		}
+	}
+	function.loadFunction3D(inequalities,f);
+	// the single precision function and the parity are optional
+	function.setFloatFunction((floatFunction3D) library->getSymbol(functionName+FLOAT_FUNCTION_SUFFIX));
+	// the control variate is optional, but useless without its integral
+	doubleFunction3D control = (doubleFunction3D) library->getSymbol(functionName+CONTROL_FUNCTION_SUFFIX);
+	double *controlIntegral = (double*) library->getSymbol(functionName+CONTROL_INTEGRAL_SUFFIX);
+	if(control and !controlIntegral){
+		logStream() << WARNING_LOG << "symbol " << functionName+CONTROL_INTEGRAL_SUFFIX << " missing from "
+					<< library->getLibraryName() << ", the control variate is ignored." << std::endl;
+		control = nullptr;
+	}
+	function.setControlVariate(control,control ? *controlIntegral : 0);
+	std::map<std::string,std::string> *parity = (std::map<std::string,std::string>*)
+													library->getSymbol(DEFAULT_PARITY_NAME);
+	if(parity and loadParity(*parity,function)){
+		return 1;
+	}
+	// what the library declares about the function is optional too
+	function.setHints(FunctionHints());
+	integral3d_plugin_info *info = (integral3d_plugin_info*) library->getSymbol(INTEGRAL3D_PLUGIN_INFO_SYMBOL);
+	if(info and loadPluginInfo(*info,function)){
+		return 1;
+	}
+	function.setOwner(library);
+	return 0;
+}
+
 //===================== DynamicFunction Class =====================//
 // constructor that only initialise names, but doesn't link to a shared library
 DynamicFunction::DynamicFunction() : functionName(DEFAULT_FUNCTION_NAME),
 										inequality1Name(DEFAULT_INEQUALITY1_NAME), 
-										inequality2Name(DEFAULT_INEQUALITY2_NAME), handle(nullptr){
+										inequality2Name(DEFAULT_INEQUALITY2_NAME),
+										inequalitiesName(DEFAULT_INEQUALITIES_NAME), library(nullptr){
 }
 
 // constructor that initialise names and link to a shared library(.so) given,
 // and also(if requested, and by default it is) loads the Function3D from the library
 DynamicFunction::DynamicFunction(char fileName[], const int &loadFunctionFlag) : libraryName(fileName),
 								functionName(DEFAULT_FUNCTION_NAME), inequality1Name(DEFAULT_INEQUALITY1_NAME),
-								inequality2Name(DEFAULT_INEQUALITY2_NAME), handle(nullptr){
+								inequality2Name(DEFAULT_INEQUALITY2_NAME),
+								inequalitiesName(DEFAULT_INEQUALITIES_NAME), library(nullptr){
 	loadLibrary(fileName);
 	if(loadFunctionFlag){
 		loadLinkedFunction();
@@ -24,7 +280,8 @@ DynamicFunction::DynamicFunction(char fileName[], const int &loadFunctionFlag) :
 DynamicFunction::DynamicFunction(const std::string &fileName, const int &loadFunctionFlag)
 								: libraryName(fileName), functionName(DEFAULT_FUNCTION_NAME), 
 									inequality1Name(DEFAULT_INEQUALITY1_NAME),
-									inequality2Name(DEFAULT_INEQUALITY2_NAME), handle(nullptr){
+									inequality2Name(DEFAULT_INEQUALITY2_NAME),
+									inequalitiesName(DEFAULT_INEQUALITIES_NAME), library(nullptr){
 	loadLibrary(fileName);
 	if(loadFunctionFlag){
 		loadLinkedFunction();
@@ -34,11 +291,12 @@ DynamicFunction::DynamicFunction(const std::string &fileName, const int &loadFun
 // destructor that deallocate the loaded library
 DynamicFunction::~DynamicFunction(){
 	if(closeLibrary()){
-		std::cerr << WARNING_LOG << "failed closing the shared library." << std::endl;
+		logStream() << WARNING_LOG << "failed closing the shared library." << std::endl;
 	}
 }
 
-// function to deallocate currently open(if exists) linked shared library
+// function to release currently open(if exists) linked shared library, the
+// library is actually closed only once no other object is using it
 // to be noted that this makes unusable the Function3D previously loaded
 // to be noted that the function returns the state of the operation(0,1)
 int DynamicFunction::closeLibrary(){
@@ -47,73 +305,75 @@ int DynamicFunction::closeLibrary(){
 		return 0;
 	}
 	setState(0);
-	if (dlclose(handle) != 0){
-		std::cerr << ERROR_LOG << "an unexpected error has occurred while closing the handle: "
-					<< dlerror() << std::endl;
-		handle = nullptr;
-		return 1;
-	}
-	handle = nullptr;
+	setOwner(nullptr);
+	library.reset();
 	return 0;
 }
 
 // function to load a shared library(.so) given the name of the file
 // to be noted that the function returns the state of the operation(0: okay, 1: error)
 int DynamicFunction::loadLibrary(const char fileName[]){
+	return loadLibrary(std::string(fileName));
+}
+
+// function to load a shared library(.so) given the name of the file, the library
+// is shared with every other user of the same file through the PluginRegistry
+// to be noted that the function returns the state of the operation(0,1)
+int DynamicFunction::loadLibrary(const std::string &fileName){
 	if(isLibraryLoaded()){
 		if(closeLibrary()){
-			std::cerr << WARNING_LOG << "failed closing the last library while opening new library."
+			logStream() << WARNING_LOG << "failed closing the last library while opening new library."
 						<< std::endl;
 		}
 	}
 	libraryName = fileName;
-	// RTLD_LAZY means that unresolved symbols are not resolved until used
-	handle = dlopen(libraryName.c_str(), RTLD_LAZY);
+	library = PluginRegistry::instance().open(libraryName);
 	if (!isLibraryLoaded()){
-		std::cerr << ERROR_LOG << "cannot open shared library: " << dlerror() << std::endl;
-		handle = nullptr;
 		return 1;
 	}
 	return 0;
 }
 
-// function to load a shared library(.so) given the name of the file
-// to be noted that the function returns the state of the operation(0,1)
-int DynamicFunction::loadLibrary(const std::string &fileName){
-	return loadLibrary(libraryName.c_str());
-}
-
 // function to check wether DynamicFunction is currently linked to
 // a shared library
 int DynamicFunction::isLibraryLoaded(){
-	return handle!=nullptr;
+	return library!=nullptr;
 }
 
 // function to load the "double f(double,double,double)" and 2 maps, in
 // order to create the Function3D object
 int DynamicFunction::loadLinkedFunction(){
 	if (!isLibraryLoaded()){
-		std::cerr << ERROR_LOG <<  "shared library is missing, or not properly initialised." << std::endl;
+		logStream() << ERROR_LOG <<  "shared library is missing, or not properly initialised." << std::endl;
 		return 1;
 	}
-	// Load the symbol for the function and 2 maps
-	doubleFunction3D f = (doubleFunction3D) dlsym(handle, functionName.c_str());
-	std::map<std::string,double> *temp1 = (std::map<std::string,double>*) dlsym(handle, inequality1Name.c_str());
-	std::map<std::string,double> *temp2 = (std::map<std::string,double>*) dlsym(handle, inequality2Name.c_str());
-	// check wether symbols have been properly resolved
-	if (!f){
-		std::cerr << ERROR_LOG << "cannot load symbol " << functionName << ": " << dlerror() << std::endl;
+	return linkFunction3D(library, *this, functionName, inequality1Name, inequality2Name, inequalitiesName);
+}
+
+// function to load the domains of a multi-domain integral from a vector of maps of the library,
+// the first 2 maps being the inequalities of the first domain and so on
+int DynamicFunction::loadDomains(std::vector<std::pair<Inequality,Inequality>> &domains,
+									const std::string &domainsName) const{
+	unsigned int i;
+	if (!library){
+		logStream() << ERROR_LOG <<  "shared library is missing, or not properly initialised." << std::endl;
 		return 1;
 	}
-	if(!temp1){
-		std::cerr << ERROR_LOG << "cannot load symbol " << inequality1Name << ": " << dlerror() << std::endl;
+	std::vector<std::map<std::string,double>> *temp = (std::vector<std::map<std::string,double>>*)
+														library->getSymbol(domainsName);
+	if(!temp){
+		logStream() << ERROR_LOG << "cannot load symbol " << domainsName << " from "
+					<< library->getLibraryName() << ": " << library->getSymbolError(domainsName) << std::endl;
 		return 1;
 	}
-	if(!temp2){
-		std::cerr << ERROR_LOG << "cannot load symbol " << inequality2Name << ": " << dlerror() << std::endl;
+	if(temp->size()%2!=0){
+		logStream() << ERROR_LOG << domainsName << " should have 2 inequalities per domain." << std::endl;
 		return 1;
 	}
-	loadFunction3D(*temp1,*temp2,f);
+	domains.clear();
+	for(i=0;i<temp->size();i+=2){
+		domains.push_back(std::make_pair(Inequality((*temp)[i]),Inequality((*temp)[i+1])));
+	}
 	return 0;
 }
 
@@ -160,4 +420,19 @@ void DynamicFunction::setInequality2Name(char name[]){
 // function to change the name of the second inequality being looked for in the shared library
 void DynamicFunction::setInequality2Name(const std::string &name){
 	inequality2Name = name;
+}
+
+// function to get the name of the vector of inequalities being looked for in the shared library
+std::string DynamicFunction::getInequalitiesName() const{
+	return inequalitiesName;
+}
+
+// function to change the name of the vector of inequalities being looked for in the shared library
+void DynamicFunction::setInequalitiesName(char name[]){
+	inequalitiesName = name;
+}
+
+// function to change the name of the vector of inequalities being looked for in the shared library
+void DynamicFunction::setInequalitiesName(const std::string &name){
+	inequalitiesName = name;
 }
\ No newline at end of file
@@ -56,13 +56,271 @@ int loadInteger(const char *array, int &value, const std::string &variableName){
 	return 0;
 }
 
-int main(int argc, char *argv[]) {
+// function that check if the given input is an option("--name" or "--name=value")
+int isOption(const char *array){
+	return array[0]=='-' and array[1]=='-' and array[2]!='\0';
+}
+
+// function that splits the command line into positional arguments and options,
+// options are stored as name->value(value is empty if not given). Options not in
+// the usage line are rejected, so a misspelled one doesn't fall back to the defaults.
+int loadOptions(int argc, char *argv[], std::vector<char*> &arguments,
+				std::map<std::string,std::string> &options){
+	static const std::set<std::string> known = {
+		"precision","engine","threads","autotune","parity","unbounded","voxel","voxel-layout","trace","isolate",
+		"sweep","sensitivities","control","coordinates","split","in-flight","domains"
+	};
+	int i;
+	std::string option;
+	size_t equal;
+	for(i=0;i<argc;++i){
+		if(i==0 or !isOption(argv[i])){
+			arguments.push_back(argv[i]);
+			continue;
+		}
+		option = argv[i]+2;
+		equal = option.find('=');
+		if(!known.count(option.substr(0,equal))){
+			std::cerr << USAGE_LOG << "unknown option --" << option.substr(0,equal) << "." << std::endl;
+			std::cerr << FATAL_ERROR_LOG << "exiting program." << std::endl;
+			return 1;
+		}
+		if(equal==std::string::npos){
+			options[option] = "";
+		}else{
+			options[option.substr(0,equal)] = option.substr(equal+1);
+		}
+	}
+	return 0;
+}
+
+// function to load the precision mode of the trapezoidal sums
+int loadPrecisionMode(const std::string &name, int &mode){
+	if(name=="double"){
+		mode = PRECISION_MODE_DOUBLE;
+	}else if(name=="compensated"){
+		mode = PRECISION_MODE_COMPENSATED;
+	}else if(name=="float"){
+		mode = PRECISION_MODE_FLOAT;
+	}else if(name=="long-double"){
+		mode = PRECISION_MODE_LONG_DOUBLE;
+	}else{
+		std::cerr << USAGE_LOG << "precision should be one of: double, compensated, float, long-double."
+					<< std::endl;
+		std::cerr << FATAL_ERROR_LOG << "exiting program." << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+// function to load the engine of the integration
+int loadEngine(const std::string &name, int &engine){
+	if(name=="romberg"){
+		engine = ENGINE_ROMBERG;
+	}else if(name=="sparse-grid"){
+		engine = ENGINE_SPARSE_GRID;
+	}else if(name=="hybrid"){
+		engine = ENGINE_HYBRID;
+	}else if(name=="breadth-first"){
+		engine = ENGINE_BREADTH_FIRST;
+	}else{
+		std::cerr << USAGE_LOG << "engine should be one of: romberg, sparse-grid, hybrid, breadth-first."
+					<< std::endl;
+		std::cerr << FATAL_ERROR_LOG << "exiting program." << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+// function to load how infinite sides of the domain are handled
+int loadUnboundedMode(const std::string &name, int &mode){
+	if(name=="truncate"){
+		mode = UNBOUNDED_MODE_TRUNCATE;
+	}else if(name=="transform"){
+		mode = UNBOUNDED_MODE_TRANSFORM;
+	}else{
+		std::cerr << USAGE_LOG << "unbounded should be one of: truncate, transform." << std::endl;
+		std::cerr << FATAL_ERROR_LOG << "exiting program." << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+// function to load when the regions of Romberg's algorithm are split
+int loadSplitPolicy(const std::string &name, int &policy){
+	if(name=="full"){
+		policy = SPLIT_POLICY_FULL;
+	}else if(name=="adaptive"){
+		policy = SPLIT_POLICY_ADAPTIVE;
+	}else{
+		std::cerr << USAGE_LOG << "split policy should be one of: full, adaptive." << std::endl;
+		std::cerr << FATAL_ERROR_LOG << "exiting program." << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+// function to load the coordinates of the box integrated
+int loadCoordinates(const std::string &name, int &coordinates){
+	if(name=="cartesian"){
+		coordinates = COORDINATES_CARTESIAN;
+	}else if(name=="ellipsoidal"){
+		coordinates = COORDINATES_ELLIPSOIDAL;
+	}else{
+		std::cerr << USAGE_LOG << "coordinates should be one of: cartesian, ellipsoidal." << std::endl;
+		std::cerr << FATAL_ERROR_LOG << "exiting program." << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+// function to load how the control variate of the plugin is used: "off" integrates f,
+// "fixed" the residual f-g, "auto" the residual f-scale*g with the scale estimated
+int loadControlOption(const std::string &name, Integral3D &integral, Function3D &function){
+	if(name=="off"){
+		function.setControlVariate(nullptr,0);
+	}else if(name=="fixed"){
+		integral.setControlScaling(CONTROL_SCALING_FIXED);
+	}else if(name=="auto"){
+		integral.setControlScaling(CONTROL_SCALING_AUTO);
+	}else{
+		std::cerr << USAGE_LOG << "control should be one of: off, fixed, auto." << std::endl;
+		std::cerr << FATAL_ERROR_LOG << "exiting program." << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+// function to load the parity given as "x:even,y:odd,..."
+int loadParityOption(const std::string &value, Function3D &function){
+	std::map<std::string,std::string> parity;
+	size_t start = 0, end, colon;
+	std::string element;
+	while(start<=value.size()){
+		end = value.find(',',start);
+		if(end==std::string::npos){
+			end = value.size();
+		}
+		element = value.substr(start,end-start);
+		colon = element.find(':');
+		if(colon==std::string::npos){
+			std::cerr << USAGE_LOG << "parity should be given as axis:parity, i.e. x:even,y:odd." << std::endl;
+			std::cerr << FATAL_ERROR_LOG << "exiting program." << std::endl;
+			return 1;
+		}
+		parity[element.substr(0,colon)] = element.substr(colon+1);
+		start = end+1;
+	}
+	if(loadParity(parity,function)){
+		std::cerr << FATAL_ERROR_LOG << "exiting program." << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+// function to load the layout of a raw voxel file given as
+// "nx,ny,nz,dx,dy,dz,ox,oy,oz,float32|float64"
+int loadVoxelLayout(const std::string &value, VoxelLayout &layout){
+	std::string fields(value), type;
+	std::replace(fields.begin(),fields.end(),',',' ');
+	std::istringstream stream(fields);
+	stream >> layout.dims[0] >> layout.dims[1] >> layout.dims[2] >> layout.spacing[0] >> layout.spacing[1]
+			>> layout.spacing[2] >> layout.origin[0] >> layout.origin[1] >> layout.origin[2] >> type;
+	if(stream.fail() or (type!="float32" and type!="float64")){
+		std::cerr << USAGE_LOG << "voxel-layout should be given as nx,ny,nz,dx,dy,dz,ox,oy,oz,float32|float64."
+					<< std::endl;
+		std::cerr << FATAL_ERROR_LOG << "exiting program." << std::endl;
+		return 1;
+	}
+	layout.type = type=="float64" ? VOXEL_TYPE_FLOAT64 : VOXEL_TYPE_FLOAT32;
+	return 0;
+}
+
+// function to replace the function of the library with a voxel file, whose
+// layout is read from its header if not given
+int loadVoxelOption(const std::string &fileName, std::map<std::string,std::string> &options,
+					Function3D &function){
+	std::shared_ptr<VoxelGrid> grid = std::make_shared<VoxelGrid>();
+	VoxelLayout layout;
+	if(options.count("voxel-layout")){
+		if(loadVoxelLayout(options["voxel-layout"],layout)){
+			return 1;
+		}
+		if(grid->open(fileName,layout)){
+			std::cerr << FATAL_ERROR_LOG << "exiting program." << std::endl;
+			return 1;
+		}
+	}else if(grid->open(fileName)){
+		std::cerr << FATAL_ERROR_LOG << "exiting program." << std::endl;
+		return 1;
+	}
+	if(loadVoxelGrid(grid,function)){
+		std::cerr << FATAL_ERROR_LOG << "exiting program." << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+// function to load the thresholds of a sweep given as "inequality,first,last,count":
+// count values of "r" evenly spaced from first to last
+int loadSweepOption(const std::string &value, int &inequality, std::vector<double> &thresholds){
+	std::string fields(value);
+	double first, last;
+	int count, i;
+	std::replace(fields.begin(),fields.end(),',',' ');
+	std::istringstream stream(fields);
+	stream >> inequality >> first >> last >> count;
+	if(stream.fail() or inequality<1 or count<1){
+		std::cerr << USAGE_LOG << "sweep should be given as inequality,first,last,count(inequalities are"
+					<< " numbered from 1)." << std::endl;
+		std::cerr << FATAL_ERROR_LOG << "exiting program." << std::endl;
+		return 1;
+	}
+	thresholds.resize(count);
+	for(i=0;i<count;++i){
+		thresholds[i] = count==1 ? first : first+(last-first)*i/(count-1);
+	}
+	return 0;
+}
+
+// function that starts the worker processes evaluating the function("0" or empty: one per core)
+int loadIsolateOption(const std::string &value, Function3D &function, std::shared_ptr<WorkerPool> &pool){
+	int workers = 0;
+	if(!value.empty() and loadInteger(value.c_str(),workers,"isolate")){
+		return 1;
+	}
+	pool = std::make_shared<WorkerPool>();
+	if(pool->start(function,workers) or loadWorkerPool(pool,function)){
+		std::cerr << FATAL_ERROR_LOG << "exiting program." << std::endl;
+		return 1;
+	}
+	std::cerr << CONSOLE_LOG << "function evaluated by " << pool->getWorkers() << " worker processes" << std::endl;
+	return 0;
+}
+
+int main(int _argc, char *_argv[]) {
 	int maxn, maxr;
 	double error;
+	std::vector<char*> arguments;
+	std::map<std::string,std::string> options;
+	// options("--name=value") can be anywhere, the rest are positional arguments
+	if(loadOptions(_argc,_argv,arguments,options)){
+		return 1;
+	}
+	int argc = arguments.size();
+	char **argv = arguments.data();
 	// setting parameters to default value
 	error = maxn = maxr = -1;
 	if(argc < 2){
-		std::cerr << USAGE_LOG << argv[0] << " <shared library name(*.so)>" << std::endl;
+		std::cerr << USAGE_LOG << argv[0] << " <shared library name(*.so)> [error] [MAXN] [MAXR]"
+					<< " [--precision=double|compensated|float|long-double]"
+					<< " [--engine=romberg|sparse-grid|hybrid|breadth-first] [--threads=count] [--autotune]"
+					<< " [--parity=x:even,y:odd,...]"
+					<< " [--unbounded=truncate|transform] [--voxel=file] [--voxel-layout=nx,ny,nz,dx,dy,dz,ox,oy,oz,type]"
+					<< " [--trace=file] [--isolate[=workers]] [--sweep=inequality,first,last,count] [--sensitivities]"
+					<< " [--control=off|fixed|auto] [--coordinates=cartesian|ellipsoidal] [--split=full|adaptive]"
+					<< " [--in-flight=batches] [--domains]"
+					<< std::endl;
 		std::cerr << FATAL_ERROR_LOG << "argument is mandatory, exiting program." << std::endl;
 		return 1;
 	}
@@ -95,10 +353,213 @@ int main(int argc, char *argv[]) {
 	}
 
 	Integral3D integral;
-	double r,integralError;
+	IntegrationResult result;
+	int precisionMode, unboundedMode, coordinates, threads, engine, splitPolicy, inFlight;
+
+	if(options.count("precision")){
+		if(loadPrecisionMode(options["precision"],precisionMode)){
+			return 1;
+		}
+		integral.setPrecisionMode(precisionMode);
+	}
+	if(options.count("engine")){
+		if(loadEngine(options["engine"],engine)){
+			return 1;
+		}
+		integral.setEngine(engine);
+	}
+	if(options.count("split")){
+		if(loadSplitPolicy(options["split"],splitPolicy)){
+			return 1;
+		}
+		integral.setSplitPolicy(splitPolicy);
+	}
+	if(options.count("unbounded")){
+		if(loadUnboundedMode(options["unbounded"],unboundedMode)){
+			return 1;
+		}
+		integral.setUnboundedMode(unboundedMode);
+	}
+	if(options.count("coordinates")){
+		if(loadCoordinates(options["coordinates"],coordinates)){
+			return 1;
+		}
+		integral.setCoordinates(coordinates);
+	}
+	// the library still gives the domain, but the integrand is read from the file
+	if(options.count("voxel") and loadVoxelOption(options["voxel"],options,dfunction)){
+		return 1;
+	}
+	if(options.count("parity") and loadParityOption(options["parity"],dfunction)){
+		return 1;
+	}
+	if(options.count("control") and loadControlOption(options["control"],integral,dfunction)){
+		return 1;
+	}
+	if(dfunction.hasControlVariate()){
+		double scale = dfunction.getControlScale();
+		if(integral.getControlScaling()==CONTROL_SCALING_AUTO){
+			scale = integral.estimateControlScale(dfunction);
+		}
+		std::cerr << CONSOLE_LOG << "control variate with known integral " << dfunction.getControlIntegral()
+					<< ", scale " << scale << std::endl;
+	}
+	// the plugin runs in other processes, which are restarted if it crashes
+	std::shared_ptr<WorkerPool> pool;
+	if(options.count("isolate") and loadIsolateOption(options["isolate"],dfunction,pool)){
+		return 1;
+	}
+	// the autotuner chooses what isn't given explicitly
+	if(options.count("autotune")){
+		TuningReport report = integral.autotune(dfunction,error);
+		for(const std::string &reason : report.reasons){
+			std::cerr << CONSOLE_LOG << "autotune: " << reason << std::endl;
+		}
+		if(!options.count("engine")){
+			integral.setEngine(report.engine);
+		}
+		if(!options.count("precision")){
+			integral.setPrecisionMode(report.precisionMode);
+		}
+		integral.setThreads(report.threads);
+		if(maxn==-1){
+			maxn = report.MAXN;
+		}
+		if(maxr==-1){
+			maxr = report.MAXR;
+		}
+	}
+	if(options.count("threads")){
+		if(loadInteger(options["threads"].c_str(),threads,"threads")){
+			return 1;
+		}
+		integral.setThreads(threads);
+	}
+	if(options.count("in-flight")){
+		if(loadInteger(options["in-flight"].c_str(),inFlight,"in-flight")){
+			return 1;
+		}
+		integral.setInFlight(inFlight);
+	}
+
+	// every point sampled is written to the file by a background thread
+	std::shared_ptr<TraceWriter> trace;
+	if(options.count("trace")){
+		trace = std::make_shared<TraceWriter>();
+		if(trace->open(options["trace"])){
+			std::cerr << FATAL_ERROR_LOG << "exiting program." << std::endl;
+			return 1;
+		}
+		integral.setTrace(trace);
+	}
+
+	if(options.count("sensitivities")){
+		integral.setSensitivities(1);
+	}
+
+	// one integral for every value of "r" of an inequality, from one sampling
+	if(options.count("sweep")){
+		int inequality;
+		std::vector<double> thresholds;
+		if(loadSweepOption(options["sweep"],inequality,thresholds)){
+			return 1;
+		}
+		SweepResult sweep = integral.sweep(dfunction,inequality,thresholds,error,maxn,maxr);
+		if(sweep.status & INTEGRATION_STATUS_NOT_CALLABLE){
+			std::cerr << ERROR_LOG << "function or inequality " << inequality << " not loaded." << std::endl;
+			std::cerr << FATAL_ERROR_LOG << "exiting program." << std::endl;
+			return 1;
+		}
+		if(sweep.status & INTEGRATION_STATUS_DEPTH_LIMITED){
+			std::cerr << WARNING_LOG << "at least one recursion reached maximum depth."
+						<< " Error may be greater than the one required." << std::endl;
+		}
+		if(sweep.status & INTEGRATION_STATUS_EVALUATION_FAILED){
+			std::cerr << WARNING_LOG << "some points couldn't be evaluated, the result is not reliable." << std::endl;
+		}
+		for(size_t i=0;i<thresholds.size();++i){
+			std::cout << "r=" << thresholds[i] << " Result: " << sweep.values[i] << " \u00B1 " << sweep.errors[i]
+						<< std::endl;
+		}
+		std::cerr << CONSOLE_LOG << sweep.evaluations << " points sampled in " << sweep.regions
+					<< " regions" << std::endl;
+		return 0;
+	}
+
+	// one integral for every domain of the library, from one sampling
+	if(options.count("domains")){
+		std::vector<std::pair<Inequality,Inequality>> domains;
+		if(dfunction.loadDomains(domains)){
+			std::cerr << FATAL_ERROR_LOG << "exiting program." << std::endl;
+			return 1;
+		}
+		MultiDomainResult multi = integral.integrateDomains(dfunction,domains,error,maxn,maxr);
+		if(multi.status & INTEGRATION_STATUS_NOT_CALLABLE){
+			std::cerr << ERROR_LOG << "function or domains not loaded." << std::endl;
+			std::cerr << FATAL_ERROR_LOG << "exiting program." << std::endl;
+			return 1;
+		}
+		if(multi.status & INTEGRATION_STATUS_DEPTH_LIMITED){
+			std::cerr << WARNING_LOG << "at least one recursion reached maximum depth."
+						<< " Error may be greater than the one required." << std::endl;
+		}
+		if(multi.status & INTEGRATION_STATUS_EVALUATION_FAILED){
+			std::cerr << WARNING_LOG << "some points couldn't be evaluated, the result is not reliable." << std::endl;
+		}
+		for(size_t i=0;i<domains.size();++i){
+			std::cout << "domain " << i+1 << " Result: " << multi.values[i] << " \u00B1 " << multi.errors[i]
+						<< std::endl;
+		}
+		std::cerr << CONSOLE_LOG << multi.evaluations << " points sampled in " << multi.regions
+					<< " regions" << std::endl;
+		return 0;
+	}
 
 	// calculaing and displaying integral
-	r = integral(dfunction,integralError,error,maxn,maxr);
-	std::cout << "Result: " << r << " \u00B1 " << integralError << std::endl;
+	result = integral.integrate(dfunction,error,maxn,maxr);
+	if(trace){
+		if(trace->close()){
+			std::cerr << ERROR_LOG << "trace " << options["trace"] << " is incomplete." << std::endl;
+		}else{
+			std::cerr << CONSOLE_LOG << trace->getPoints() << " points traced into " << options["trace"]
+						<< std::endl;
+		}
+	}
+	if(pool and pool->getRestarts()>0){
+		std::cerr << WARNING_LOG << "worker processes restarted " << pool->getRestarts() << " times." << std::endl;
+	}
+	if(result.status & INTEGRATION_STATUS_NOT_CALLABLE){
+		std::cerr << ERROR_LOG << "function or inequalities not loaded." << std::endl;
+		std::cerr << FATAL_ERROR_LOG << "exiting program." << std::endl;
+		return 1;
+	}
+	if(result.status & INTEGRATION_STATUS_DEPTH_LIMITED){
+		std::cerr << WARNING_LOG << "at least one recursion reached maximum depth."
+					<< " Error may be greater than the one required." << std::endl;
+	}
+	if(result.status & INTEGRATION_STATUS_EVALUATION_FAILED){
+		std::cerr << WARNING_LOG << "some points couldn't be evaluated, the result is not reliable." << std::endl;
+	}
+	if(result.status & INTEGRATION_STATUS_ENGINE_REPLACED){
+		std::cerr << WARNING_LOG << "the domain cuts the box, integrated with the hybrid engine instead of the sparse grid." << std::endl;
+	}
+	std::cout << "Result: " << result.value << " \u00B1 " << result.error << std::endl;
+	// derivatives with respect to the coefficients of each inequality
+	const std::vector<std::string> coefficients = {"x^2","x","y^2","y","z^2","z","r"};
+	for(size_t i=0;i<result.gradient.size();++i){
+		std::cout << "Inequality " << i+1 << ":";
+		for(size_t j=0;j<coefficients.size();++j){
+			std::cout << " d/d" << coefficients[j] << "=" << result.gradient[i][j] << " \u00B1 "
+						<< result.gradientErrors[i][j];
+		}
+		std::cout << std::endl;
+	}
+	std::cerr << CONSOLE_LOG << result.evaluations << " points sampled in " << result.regions
+				<< " regions" << std::endl;
+	const IntegrationStats &stats = result.stats;
+	if(stats.boxVolume>0){
+		std::cerr << CONSOLE_LOG << "box-fill ratio: " << stats.fillRatio << " (between "
+					<< stats.fillRatioMin << " and " << stats.fillRatioMax << ")" << std::endl;
+	}
 	return 0;
 }
\ No newline at end of file
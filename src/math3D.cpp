@@ -1,8 +1,14 @@
 #include "../include/math3D.h"
+#include "../include/sparseGrid.h"
+#include "../include/breadthFirst.h"
+#include "../include/levelSet.h"
+#include "../include/multiDomain.h"
+#include "../include/sensitivity.h"
 
 //===================== Inequality Class =====================//
 // constructor that only initialise disequality and isLoaded flag to default values
 Inequality::Inequality() : isLoaded(0), disequality(DEFAULT_INEQUALITY){
+	updateCache();
 }
 
 // constructor that loads coefficient given
@@ -45,6 +51,7 @@ void Inequality::loadInequality(const std::map<std::string,double> &_coefficient
 			break;
 		}
 	}
+	updateCache();
 	isLoaded = 1;
 }
 
@@ -53,6 +60,7 @@ void Inequality::loadInequality(const std::map<std::string,double> &_coefficient
 void Inequality::loadInequality(const Inequality &inequality){
 	loadInequality(inequality.getCoefficient());
 	disequality = inequality.disequality;
+	updateCache();
 	isLoaded = 1;
 }
 
@@ -71,6 +79,28 @@ void Inequality::standardize(){
 		for(auto &element : coefficient){
 			element.second = -element.second;
 		}
+		updateCache();
+	}
+}
+
+// function that copies coefficients and disequality in the form used by operator(),
+// which avoids looking up the map at every evaluation
+void Inequality::updateCache(){
+	std::vector<std::string> names = {"x^2","x","y^2","y","z^2","z","r"};
+	std::map<std::string,double>::const_iterator it;
+	unsigned int i;
+	for(i=0;i<names.size();++i){
+		it = coefficient.find(names[i]);
+		terms[i] = it==coefficient.end() ? 0 : it->second;
+	}
+	if(disequality==">="){
+		disequalityType = INEQUALITY_TYPE_GREATER_EQUAL;
+	}else if(disequality=="<"){
+		disequalityType = INEQUALITY_TYPE_LESS;
+	}else if(disequality=="<="){
+		disequalityType = INEQUALITY_TYPE_LESS_EQUAL;
+	}else{
+		disequalityType = INEQUALITY_TYPE_GREATER;
 	}
 }
 
@@ -84,24 +114,115 @@ int Inequality::isCallable() const{
 // it's a true statement(1) or not(0). In case of error -1 is returned.
 int Inequality::operator()(const double &x, const double &y, const double &z) const{
 	if(!isCallable()){
-		std::cerr << WARNING_LOG << "trying to call non initialised inequality." << std::endl;
+		logStream() << WARNING_LOG << "trying to call non initialised inequality." << std::endl;
 		return -1;
 	}
-	double value = coefficient.at("x^2")*x*x+coefficient.at("x")*x+
-					coefficient.at("y^2")*y*y+coefficient.at("y")*y+
-					coefficient.at("z^2")*z*z+coefficient.at("z")*z + coefficient.at("r");
-	if(disequality == ">"){
-		return value>0;
-	}else if(disequality == ">="){
-		return value>=0;
-	}else if(disequality == "<"){
-		return value<0; 
-	}else if(disequality == "<="){
-		return value<=0;
+	double value = this->value(x,y,z);
+	switch(disequalityType){
+		case INEQUALITY_TYPE_GREATER:
+			return value>0;
+		case INEQUALITY_TYPE_GREATER_EQUAL:
+			return value>=0;
+		case INEQUALITY_TYPE_LESS:
+			return value<0;
+		case INEQUALITY_TYPE_LESS_EQUAL:
+			return value<=0;
 	}
 	return -1;
 }
 
+// function that computes the left side of the Inequality, without comparing it with 0
+double Inequality::value(const double &x, const double &y, const double &z) const{
+	return terms[0]*x*x+terms[1]*x+
+			terms[2]*y*y+terms[3]*y+
+			terms[4]*z*z+terms[5]*z + terms[6];
+}
+
+// function that computes the range of a*t^2+b*t for t in [min,min+width]
+static void quadraticRange(const double &a, const double &b, const double &min, const double &width,
+							double &low, double &high){
+	double max = min+width;
+	double t, value;
+	low = high = a*min*min+b*min;
+	value = a*max*max+b*max;
+	low = std::min(low,value);
+	high = std::max(high,value);
+	if(a!=0){
+		// the vertex of the parabola, if inside the interval
+		t = -b/(2*a);
+		if(t>min and t<max){
+			value = a*t*t+b*t;
+			low = std::min(low,value);
+			high = std::max(high,value);
+		}
+	}
+}
+
+// function that computes the minimum and maximum value assumed by the left side of
+// the Inequality on a box. Since each coordinate appears in a separate term, the
+// range is exactly the sum of the ranges of each term.
+void Inequality::valueRange(const Parallelepiped &box, double &min, double &max) const{
+	double low, high;
+	min = max = terms[6];
+	quadraticRange(terms[0],terms[1],box.vertex.x,box.xwidth,low,high);
+	min += low;
+	max += high;
+	quadraticRange(terms[2],terms[3],box.vertex.y,box.ywidth,low,high);
+	min += low;
+	max += high;
+	quadraticRange(terms[4],terms[5],box.vertex.z,box.zwidth,low,high);
+	min += low;
+	max += high;
+}
+
+// function that tells if a box is all inside(BOX_INSIDE) or all outside(BOX_OUTSIDE)
+// the Inequality, or if it crosses its border(BOX_BOUNDARY)
+int Inequality::classify(const Parallelepiped &box) const{
+	double min, max;
+	valueRange(box,min,max);
+	switch(disequalityType){
+		case INEQUALITY_TYPE_GREATER:
+			return min>0 ? BOX_INSIDE : (max<=0 ? BOX_OUTSIDE : BOX_BOUNDARY);
+		case INEQUALITY_TYPE_GREATER_EQUAL:
+			return min>=0 ? BOX_INSIDE : (max<0 ? BOX_OUTSIDE : BOX_BOUNDARY);
+		case INEQUALITY_TYPE_LESS:
+			return max<0 ? BOX_INSIDE : (min>=0 ? BOX_OUTSIDE : BOX_BOUNDARY);
+		case INEQUALITY_TYPE_LESS_EQUAL:
+			return max<=0 ? BOX_INSIDE : (min>0 ? BOX_OUTSIDE : BOX_BOUNDARY);
+	}
+	return BOX_BOUNDARY;
+}
+
+// function that checks if the points satisfying the Inequality are the inside of an
+// ellipsoid. With the inequality as g>0(or g>=0) the squared terms must be negative,
+// and completing the squares g=k-sum(-A(x-cx)^2) the constant k must be positive.
+int Inequality::isEllipsoid(double center[3], double semiaxes[3]) const{
+	int i, sign = disequalityType==INEQUALITY_TYPE_LESS or disequalityType==INEQUALITY_TYPE_LESS_EQUAL ? -1 : 1;
+	double k = sign*terms[6], square, linear;
+	for(i=0;i<3;++i){
+		square = sign*terms[2*i];
+		linear = sign*terms[2*i+1];
+		if(!(square<0)){
+			return 0;
+		}
+		center[i] = -linear/(2*square);
+		k -= linear*linear/(4*square);
+	}
+	if(!(k>0)){
+		return 0;
+	}
+	for(i=0;i<3;++i){
+		semiaxes[i] = std::sqrt(-k/(sign*terms[2*i]));
+	}
+	return 1;
+}
+
+// operator== that checks if two inequalities have same coefficients and disequality
+int Inequality::operator==(const Inequality &inequality) const{
+	return isLoaded==inequality.isLoaded and coefficient==inequality.coefficient
+			and disequality==inequality.disequality;
+}
+
 // function that returns the map of coefficient of the Inequality object
 const std::map<std::string,double>& Inequality::getCoefficient() const{
 	return coefficient;
@@ -111,7 +232,7 @@ const std::map<std::string,double>& Inequality::getCoefficient() const{
 // the coefficient of the x^2 term
 const double& Inequality::getCoefficient(const std::string &name) const{
 	if(coefficient.find(name) == coefficient.end()){
-		std::cerr << WARNING_LOG << "trying to retrieve non-existing coefficient in Inequality." << std::endl;
+		logStream() << WARNING_LOG << "trying to retrieve non-existing coefficient in Inequality." << std::endl;
 	}
 	return coefficient.at(name);
 }
@@ -128,28 +249,99 @@ const std::string& Inequality::getDisequality() const{
 }
 
 
+//===================== FunctionHints Class =====================//
+// constructor of the hints of a function nothing is known about(it's assumed
+// thread-safe, as functions of R^3 usually are)
+FunctionHints::FunctionHints() : batch(nullptr), submit(nullptr), threadSafe(1), cost(0), smoothness(SMOOTHNESS_UNKNOWN),
+									hasBoundingBox(0), isConstant(0), constant(0){
+}
+
+// function that checks if two FunctionHints declare the same
+int FunctionHints::operator==(const FunctionHints &hints) const{
+	return batch==hints.batch and submit==hints.submit and threadSafe==hints.threadSafe and cost==hints.cost
+			and smoothness==hints.smoothness and hasBoundingBox==hints.hasBoundingBox
+			and boundingBox.vertex.x==hints.boundingBox.vertex.x
+			and boundingBox.vertex.y==hints.boundingBox.vertex.y
+			and boundingBox.vertex.z==hints.boundingBox.vertex.z
+			and boundingBox.xwidth==hints.boundingBox.xwidth and boundingBox.ywidth==hints.boundingBox.ywidth
+			and boundingBox.zwidth==hints.boundingBox.zwidth
+			and isConstant==hints.isConstant and constant==hints.constant;
+}
+
+
+//===================== IntegrandSource Class =====================//
+// empty destructor
+IntegrandSource::~IntegrandSource(){
+}
+
+// function that tells if evaluate is faster than one point at a time(not by default)
+int IntegrandSource::hasBatch() const{
+	return 0;
+}
+
+// function that by default evaluates the points one by one
+int IntegrandSource::evaluate(const double *x, const double *y, const double *z, double *values,
+								const size_t &n) const{
+	size_t i;
+	for(i=0;i<n;++i){
+		values[i] = (*this)(x[i],y[i],z[i]);
+	}
+	return 0;
+}
+
+// function that by default leaves the integration to the engines
+int IntegrandSource::integrate(const Function3D&, const Parallelepiped&, const double&, double&, double&,
+								IntegrationContext&) const{
+	return 1;
+}
+
+
 //===================== Function3D Class =====================//
 // constructor that only initialise the state flag to 0
-Function3D::Function3D() : isLoaded(0){
+Function3D::Function3D() : isLoaded(0), function(nullptr), floatFunction(nullptr), control(nullptr),
+							controlIntegral(0), controlScale(1){
+	parity[0] = parity[1] = parity[2] = PARITY_NONE;
 }
 
 // constructor that create a deep copy of a given function
-Function3D::Function3D(const Function3D &function) : isLoaded(1), first(function.first), second(function.second),
-														function(function.function){
+Function3D::Function3D(const Function3D &function) : isLoaded(1), inequalities(function.inequalities),
+														order(function.order), function(function.function),
+														floatFunction(function.floatFunction),
+														hints(function.hints), source(function.source),
+														owner(function.owner), control(function.control),
+														controlIntegral(function.controlIntegral),
+														controlScale(function.controlScale){
+	parity[0] = function.parity[0];
+	parity[1] = function.parity[1];
+	parity[2] = function.parity[2];
 }
 
 
 // constructor that loads a Function3D from 2 Inequalities and a function
 Function3D::Function3D(const Inequality &_first, const Inequality &_second, 
 						const doubleFunction3D &_function)
-						: isLoaded(1), first(_first), second(_second), function(_function){
+						: isLoaded(1), function(_function), floatFunction(nullptr), control(nullptr),
+						controlIntegral(0), controlScale(1){
+	parity[0] = parity[1] = parity[2] = PARITY_NONE;
+	loadFunction3D(_first,_second,_function);
 }
 
 // constructor that loads a Function3D from 2 maps and a function
 Function3D::Function3D(const std::map<std::string,double> &_first,
 						const std::map<std::string,double> &_second,
 						const doubleFunction3D &_function)
-						: isLoaded(1), first(_first), second(_second), function(_function){
+						: isLoaded(1), function(_function), floatFunction(nullptr), control(nullptr),
+						controlIntegral(0), controlScale(1){
+	parity[0] = parity[1] = parity[2] = PARITY_NONE;
+	loadFunction3D(_first,_second,_function);
+}
+
+// constructor that loads a Function3D from any number of Inequalities and a function
+Function3D::Function3D(const std::vector<Inequality> &_inequalities, const doubleFunction3D &_function)
+						: isLoaded(1), function(_function), floatFunction(nullptr), control(nullptr),
+						controlIntegral(0), controlScale(1){
+	parity[0] = parity[1] = parity[2] = PARITY_NONE;
+	loadFunction3D(_inequalities,_function);
 }
 
 // destructor
@@ -159,43 +351,91 @@ Function3D::~Function3D(){
 // function that takes 2 Inequalities and a function to create the Function3D
 void Function3D::loadFunction3D(const Inequality &_first, const Inequality &_second, 
 								const doubleFunction3D &_function){
-	first.loadInequality(_first);
-	second.loadInequality(_second);
-	function = _function;
-	isLoaded = 1;
+	loadFunction3D(std::vector<Inequality>{_first,_second},_function);
 }
 
 // function that takes 2 maps and a function to create the Function3D
 void Function3D::loadFunction3D(const std::map<std::string,double> &_first,
 								const std::map<std::string,double> &_second, 
 								const doubleFunction3D &_function){
-	first.loadInequality(_first);
-	second.loadInequality(_second);
+	loadFunction3D(std::vector<Inequality>{Inequality(_first),Inequality(_second)},_function);
+}
+
+// function that takes any number of Inequalities and a function to create the Function3D,
+// the domain is the intersection of all of them
+void Function3D::loadFunction3D(const std::vector<Inequality> &_inequalities,
+								const doubleFunction3D &_function){
+	unsigned int i;
+	inequalities = _inequalities;
+	order.resize(inequalities.size());
+	for(i=0;i<order.size();++i){
+		order[i] = i;
+	}
 	function = _function;
 	isLoaded = 1;
 }
 
+// function that adds an Inequality to the ones defining the domain
+void Function3D::addInequality(const Inequality &inequality){
+	inequalities.push_back(inequality);
+	order.push_back(inequalities.size()-1);
+}
+
+// function that replaces the n-th inequality(numbered from 1, as getInequality)
+void Function3D::setInequality(const int &n, const Inequality &inequality){
+	if(n>=1 and n<=(int)inequalities.size()){
+		inequalities[n-1] = inequality;
+	}else{
+		logStream() << WARNING_LOG << "trying to replace non-existent inequality." << std::endl;
+	}
+}
+
 // function that looks if Function3D is callable
 int Function3D::isCallable() const{
-	if(!first.isCallable() || !second.isCallable()){
-		return 0;
+	unsigned int i;
+	for(i=0;i<inequalities.size();++i){
+		if(!inequalities[i].isCallable()){
+			return 0;
+		}
 	}
 	return isLoaded==1;
 }
 
-// function that checks if a (x,y,z) point satisfy both inequalities, thus falling in the domain
+// function that checks if a (x,y,z) point satisfy all inequalities, thus falling in the domain.
+// Inequalities are tested following "order", so that the one that rejects the most points
+// is tested first and the others are skipped.
 int Function3D::isInDomain(const double &x, const double &y, const double &z) const{
-	if(!first.isCallable() || !second.isCallable()){
-		std::cerr << WARNING_LOG << "trying to call function non initialised domain." << std::endl;
-		return 0;
+	unsigned int i;
+	for(i=0;i<order.size();++i){
+		// an inequality non initialised returns -1(and warns about it)
+		if(inequalities[order[i]](x,y,z)!=1){
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// function that tells if a box is all inside(BOX_INSIDE) or all outside(BOX_OUTSIDE)
+// the domain, or if it may cross its border(BOX_BOUNDARY)
+int Function3D::classify(const Parallelepiped &box) const{
+	unsigned int i;
+	int position = BOX_INSIDE;
+	for(i=0;i<order.size();++i){
+		switch(inequalities[order[i]].classify(box)){
+			case BOX_OUTSIDE:
+				return BOX_OUTSIDE;
+			case BOX_BOUNDARY:
+				position = BOX_BOUNDARY;
+				break;
+		}
 	}
-	return first(x,y,z) && second(x,y,z);
+	return position;
 }
 
 // operator() that evaluates the Function3D on a given (x,y,z) point
 double Function3D::operator()(const double &x, const double &y, const double &z) const{
-	if(!isCallable()){
-		std::cerr << WARNING_LOG << "trying to call non initialised function." << std::endl;
+	if(isLoaded!=1){
+		logStream() << WARNING_LOG << "trying to call non initialised function." << std::endl;
 		return std::numeric_limits<double>::quiet_NaN();
 	}
 	if(!isInDomain(x,y,z)){
@@ -203,23 +443,226 @@ double Function3D::operator()(const double &x, const double &y, const double &z)
 		// in all non-domain points
 		return 0;
 	}
+	if(control!=nullptr){
+		return (source ? (*source)(x,y,z) : function(x,y,z))-controlScale*control(x,y,z);
+	}
+	if(source){
+		return (*source)(x,y,z);
+	}
 	return function(x,y,z);
 }
 
+// function that evaluates the Function3D in single precision on a given (x,y,z)
+// point. If no float function is given the double one is used and rounded.
+float Function3D::evaluateFloat(const float &x, const float &y, const float &z) const{
+	if(floatFunction==nullptr or source){
+		return (*this)(x,y,z);
+	}
+	if(isLoaded!=1){
+		logStream() << WARNING_LOG << "trying to call non initialised function." << std::endl;
+		return std::numeric_limits<float>::quiet_NaN();
+	}
+	if(!isInDomain(x,y,z)){
+		return 0;
+	}
+	if(control!=nullptr){
+		return floatFunction(x,y,z)-(float)(controlScale*control(x,y,z));
+	}
+	return floatFunction(x,y,z);
+}
+
+// function that checks if many points can be evaluated faster than one by one
+int Function3D::hasBatch() const{
+	if(source){
+		return source->hasBatch();
+	}
+	return hints.batch!=nullptr;
+}
+
+// function that evaluates the function(without the domain, so the points should be in it)
+// on n points, with the source or the batch function if present
+int Function3D::evaluateBatch(const double *x, const double *y, const double *z, double *values,
+								const size_t &n) const{
+	size_t i;
+	int failed = 0;
+	if(source){
+		failed = source->evaluate(x,y,z,values,n);
+	}else if(hints.batch!=nullptr){
+		hints.batch(x,y,z,values,n);
+	}else{
+		for(i=0;i<n;++i){
+			values[i] = function(x[i],y[i],z[i]);
+		}
+	}
+	if(control!=nullptr){
+		for(i=0;i<n;++i){
+			values[i] -= controlScale*control(x[i],y[i],z[i]);
+		}
+	}
+	return failed;
+}
+
+// operator== that checks if two Function3D have same function and inequalities
+int Function3D::operator==(const Function3D &_function) const{
+	return isLoaded==_function.isLoaded and function==_function.function and floatFunction==_function.floatFunction
+			and inequalities==_function.inequalities and parity[0]==_function.parity[0]
+			and parity[1]==_function.parity[1] and parity[2]==_function.parity[2]
+			and hints==_function.hints and source==_function.source and control==_function.control
+			and controlIntegral==_function.controlIntegral and controlScale==_function.controlScale;
+}
+
 // function that set the state flag(if it's properly loaded) of Function3D
 void Function3D::setState(const int &state){
 	isLoaded = state;
 }
 
+// function that declares the parity of the function along an axis("x","y","z"):
+// PARITY_EVEN if f(-x,y,z)=f(x,y,z), PARITY_ODD if f(-x,y,z)=-f(x,y,z), PARITY_NONE
+// if unknown. On symmetric domains it's used to integrate only a part of the domain.
+void Function3D::setParity(const std::string &axis, const int &_parity){
+	if(_parity!=PARITY_NONE and _parity!=PARITY_EVEN and _parity!=PARITY_ODD){
+		logStream() << WARNING_LOG << "unknown parity, ignored." << std::endl;
+		return;
+	}
+	if(axis=="x"){
+		parity[0] = _parity;
+	}else if(axis=="y"){
+		parity[1] = _parity;
+	}else if(axis=="z"){
+		parity[2] = _parity;
+	}else{
+		logStream() << WARNING_LOG << "parity of non-existent axis " << axis << ", ignored." << std::endl;
+	}
+}
+
+// function that returns the parity declared along an axis("x","y","z")
+int Function3D::getParity(const std::string &axis) const{
+	if(axis=="x"){
+		return parity[0];
+	}else if(axis=="y"){
+		return parity[1];
+	}else if(axis=="z"){
+		return parity[2];
+	}
+	return PARITY_NONE;
+}
+
+// function that set the single precision version of the function
+void Function3D::setFloatFunction(const floatFunction3D &_floatFunction){
+	floatFunction = _floatFunction;
+}
+
+// function that declares what's known about the function
+void Function3D::setHints(const FunctionHints &_hints){
+	hints = _hints;
+}
+
+// function that returns what's declared about the function
+const FunctionHints& Function3D::getHints() const{
+	return hints;
+}
+
+// function that replaces the function with an integrand needing its own data(nullptr
+// goes back to the function)
+void Function3D::setSource(const std::shared_ptr<const IntegrandSource> &_source){
+	source = _source;
+}
+
+// function that returns the integrand replacing the function, nullptr if not given
+const IntegrandSource* Function3D::getSource() const{
+	return source.get();
+}
+
+// function that sets the approximation of the function with its known integral over the
+// domain, and its multiplier. With nullptr the function is evaluated as it is.
+void Function3D::setControlVariate(const doubleFunction3D &_control, const double &integral,
+									const double &scale){
+	control = _control;
+	controlIntegral = _control!=nullptr ? integral : 0;
+	controlScale = _control!=nullptr ? scale : 1;
+}
+
+// function that checks if an approximation is subtracted from the function
+int Function3D::hasControlVariate() const{
+	return control!=nullptr;
+}
+
+// function that returns the approximation subtracted, nullptr if not given
+doubleFunction3D Function3D::getControl() const{
+	return control;
+}
+
+// function that returns the known integral of the approximation over the domain
+double Function3D::getControlIntegral() const{
+	return controlIntegral;
+}
+
+// function that sets the multiplier of the approximation
+void Function3D::setControlScale(const double &scale){
+	controlScale = scale;
+}
+
+// function that returns the multiplier of the approximation
+double Function3D::getControlScale() const{
+	return controlScale;
+}
+
+// function that checks if the single precision version of the function is given
+int Function3D::hasFloatFunction() const{
+	return floatFunction!=nullptr;
+}
+
+// function that attach the provider of "function", which is then kept alive
+// by this Function3D and all its copies
+void Function3D::setOwner(const std::shared_ptr<const void> &_owner){
+	owner = _owner;
+}
+
+// function that returns the function(R^3->R), without the domain
+doubleFunction3D Function3D::getFunction() const{
+	return function;
+}
+
+// function that returns the n-th inequality(starting from 1)
 const Inequality& Function3D::getInequality(const int &n) const{
-	if(n==1){
-		return first;
-	}else if(n==2){
-		return second;
+	static const Inequality empty;
+	if(n>=1 and n<=(int)inequalities.size()){
+		return inequalities[n-1];
+	}else if(inequalities.empty()){
+		logStream() << WARNING_LOG << "asking for inequality of a domain without any. Empty is returned." << std::endl;
+		return empty;
 	}else{
-		std::cerr << WARNING_LOG << "asking for non-existent inequality. First is returned." << std::endl;
-		return first;
+		logStream() << WARNING_LOG << "asking for non-existent inequality. First is returned." << std::endl;
+		return inequalities[0];
+	}
+}
+
+// function that returns the number of inequalities defining the domain
+int Function3D::getInequalityCount() const{
+	return inequalities.size();
+}
+
+// function that set the order in which the inequalities are tested by isInDomain,
+// it must be a permutation of 0,...,getInequalityCount()-1
+void Function3D::setEvaluationOrder(const std::vector<unsigned int> &_order){
+	std::vector<unsigned int> sorted(_order);
+	unsigned int i;
+	std::sort(sorted.begin(),sorted.end());
+	for(i=0;i<sorted.size();++i){
+		if(sorted[i]!=i){
+			break;
+		}
 	}
+	if(sorted.size()!=inequalities.size() or i!=sorted.size()){
+		logStream() << WARNING_LOG << "evaluation order is not a permutation of the inequalities, ignored." << std::endl;
+		return;
+	}
+	order = _order;
+}
+
+// function that returns the order in which the inequalities are tested
+const std::vector<unsigned int>& Function3D::getEvaluationOrder() const{
+	return order;
 }
 
 
@@ -233,14 +676,6 @@ Point3D::Point3D() : x(0), y(0), z(0){
 Point3D::Point3D(const double &_x, const double &_y, const double &_z) : x(_x), y(_y), z(_z){
 }
 
-// constructor that creates a deep copy of another point
-Point3D::Point3D(const Point3D &p) : x(p.x), y(p.y), z(p.z){
-}
-
-// empty destructor
-Point3D::~Point3D(){
-}
-
 
 //===================== Parallelepiped Class =====================//
 // empty constructor, default parameters are set
@@ -254,26 +689,291 @@ Parallelepiped::Parallelepiped(const Point3D &_vertex, const double &_xwidth, co
 								ywidth(_ywidth), zwidth(_zwidth){
 }
 
-// constructor that creates a deep copy of another Parallelepiped
-Parallelepiped::Parallelepiped(const Parallelepiped &p) : vertex(p.vertex), xwidth(p.xwidth),
-								ywidth(p.ywidth), zwidth(p.zwidth){
+
+//===================== VariableTransform Class =====================//
+// constructor of the identity transformation
+VariableTransform::VariableTransform() : identity(1), ellipsoidal(0){
+	type[0] = type[1] = type[2] = TRANSFORM_NONE;
+	origin[0] = origin[1] = origin[2] = 0;
+	center[0] = center[1] = center[2] = 0;
+	semiaxes[0] = semiaxes[1] = semiaxes[2] = 1;
 }
 
 // empty destructor
-Parallelepiped::~Parallelepiped(){
+VariableTransform::~VariableTransform(){
+}
+
+// function that set the transformation of an axis(0: x, 1: y, 2: z), the origin
+// is the finite end for TRANSFORM_UPPER and TRANSFORM_LOWER
+void VariableTransform::setAxis(const int &axis, const int &_type, const double &_origin){
+	if(axis<0 or axis>2 or _type<TRANSFORM_NONE or _type>TRANSFORM_BOTH){
+		logStream() << WARNING_LOG << "invalid axis transformation, ignored." << std::endl;
+		return;
+	}
+	type[axis] = _type;
+	origin[axis] = _origin;
+	identity = type[0]==TRANSFORM_NONE and type[1]==TRANSFORM_NONE and type[2]==TRANSFORM_NONE
+				and !ellipsoidal;
 }
 
+// function that returns the type of transformation of an axis
+int VariableTransform::getType(const int &axis) const{
+	return type[axis];
+}
 
-//===================== Parallelepiped Class =====================//
+// function that checks if the transformation does nothing
+int VariableTransform::isIdentity() const{
+	return identity;
+}
+
+// function that sets the ellipsoid whose inside is the image of the box of spherical
+// coordinates, in place of the transformations of the axes
+void VariableTransform::setEllipsoid(const double _center[3], const double _semiaxes[3]){
+	int i;
+	for(i=0;i<3;++i){
+		type[i] = TRANSFORM_NONE;
+		center[i] = _center[i];
+		semiaxes[i] = _semiaxes[i];
+	}
+	ellipsoidal = 1;
+	identity = 0;
+}
+
+// function that checks if the box is in spherical coordinates of an ellipsoid
+int VariableTransform::isEllipsoidal() const{
+	return ellipsoidal;
+}
+
+// function that maps the point(x,y,z) into the space, and returns the jacobian
+// of the transformation. At points mapped to infinity 0 is returned.
+double VariableTransform::map(double &x, double &y, double &z) const{
+	if(ellipsoidal){
+		// (x,y,z) is (radius,polar angle,azimuth) of the unit ball, stretched along
+		// the axes: the jacobian is abc*radius^2*sin(polar angle)
+		double radius = x, polar = y, azimuth = z, sine = std::sin(polar);
+		x = center[0]+semiaxes[0]*radius*sine*std::cos(azimuth);
+		y = center[1]+semiaxes[1]*radius*sine*std::sin(azimuth);
+		z = center[2]+semiaxes[2]*radius*std::cos(polar);
+		return semiaxes[0]*semiaxes[1]*semiaxes[2]*radius*radius*sine;
+	}
+	return mapAxis(0,x)*mapAxis(1,y)*mapAxis(2,z);
+}
+
+// function that maps a coordinate along an axis, and returns the derivative
+double VariableTransform::mapAxis(const int &axis, double &t) const{
+	double d, jacobian;
+	switch(type[axis]){
+		case TRANSFORM_UPPER:
+			// x=o+t/(1-t), dx/dt=1/(1-t)^2
+			if(t>=1){
+				t = origin[axis];
+				return 0;
+			}
+			d = 1/(1-t);
+			t = origin[axis]+t*d;
+			return d*d;
+		case TRANSFORM_LOWER:
+			// x=o+t/(1+t), dx/dt=1/(1+t)^2
+			if(t<=-1){
+				t = origin[axis];
+				return 0;
+			}
+			d = 1/(1+t);
+			t = origin[axis]+t*d;
+			return d*d;
+		case TRANSFORM_BOTH:
+			// x=t/(1-t^2), dx/dt=(1+t^2)/(1-t^2)^2
+			if(t>=1 or t<=-1){
+				t = 0;
+				return 0;
+			}
+			d = 1/(1-t*t);
+			jacobian = (1+t*t)*d*d;
+			t = t*d;
+			return jacobian;
+	}
+	return 1;
+}
+
+
+//===================== IntegrationStats Class =====================//
+// constructor that set default values to variables
+IntegrationStats::IntegrationStats() : boxVolume(0), fillRatio(1), fillRatioMin(0), fillRatioMax(1){
+}
+
+
+//===================== IntegrationRegion Class =====================//
+// empty constructor, default parameters are set
+IntegrationRegion::IntegrationRegion() : recursion(0), value(0), error(0), converged(0), depthLimited(0),
+											gaussOrder(0){
+}
+
+// constructor that creates a leaf covering the given domain, at the given depth
+IntegrationRegion::IntegrationRegion(const Parallelepiped &_domain, const int &_recursion)
+										: domain(_domain), recursion(_recursion), value(0), error(0),
+										converged(0), depthLimited(0), gaussOrder(0){
+}
+
+// empty destructor
+IntegrationRegion::~IntegrationRegion(){
+}
+
+
+//===================== IntegrationState Class =====================//
+// constructor of an empty state
+IntegrationState::IntegrationState() : hasRoot(0), symmetryFactor(1), controlScale(1), ellipsoid(0), engine(DEFAULT_ENGINE),
+										precisionMode(DEFAULT_PRECISION_MODE),
+										tightBounding(1), unboundedMode(DEFAULT_UNBOUNDED_MODE),
+										controlScaling(DEFAULT_CONTROL_SCALING), coordinates(DEFAULT_COORDINATES){
+	reduced[0] = reduced[1] = reduced[2] = 0;
+}
+
+// empty destructor
+IntegrationState::~IntegrationState(){
+}
+
+// function that discard the region tree stored
+void IntegrationState::reset(){
+	hasRoot = 0;
+	symmetryFactor = 1;
+	reduced[0] = reduced[1] = reduced[2] = 0;
+	controlScale = 1;
+	ellipsoid = 0;
+	function = Function3D();
+	root = IntegrationRegion();
+	transform = VariableTransform();
+	stats = IntegrationStats();
+}
+
+// function that checks if the region tree stored was built on the given Function3D
+int IntegrationState::isCompatible(const Function3D &_function) const{
+	return hasRoot and function==_function;
+}
+
+// function that checks if there's no region tree stored
+int IntegrationState::isEmpty() const{
+	return !hasRoot;
+}
+
+
+//===================== IntegrationResult Class =====================//
+// constructor of the result of an empty integration
+IntegrationResult::IntegrationResult() : value(0), error(0), status(INTEGRATION_STATUS_OK),
+											evaluations(0), regions(0){
+}
+
+
+//===================== SweepResult Class =====================//
+// constructor of a sweep without thresholds
+SweepResult::SweepResult() : status(INTEGRATION_STATUS_OK), evaluations(0), regions(0){
+}
+
+//===================== MultiDomainResult Class =====================//
+// constructor of an empty result
+MultiDomainResult::MultiDomainResult() : status(INTEGRATION_STATUS_OK), evaluations(0), regions(0){
+}
+
+
+//===================== IntegrationJob Class =====================//
+// empty constructor, default parameters are set
+IntegrationJob::IntegrationJob() : epsilon(DEFAULT_ERROR), MAXN(DEFAULT_MAXN), MAXR(DEFAULT_MAXR){
+}
+
+// constructor of the integral of the given Function3D
+IntegrationJob::IntegrationJob(const Function3D &_function, const double &_epsilon, const int &_MAXN,
+								const int &_MAXR) : function(_function), epsilon(_epsilon),
+								MAXN(_MAXN), MAXR(_MAXR){
+}
+
+
+//===================== TuningReport Class =====================//
+// constructor of a report with the default parameters
+TuningReport::TuningReport() : evaluationTime(0), order(0), estimate(0), correction(0), fillRatio(1),
+								engine(DEFAULT_ENGINE), precisionMode(DEFAULT_PRECISION_MODE), MAXN(DEFAULT_MAXN),
+								MAXR(DEFAULT_MAXR), threads(DEFAULT_REGION_THREADS), expectedTime(0){
+}
+
+
+//===================== IntegrationContext Class =====================//
+// constructor of the context of an integration in the given coordinates
+IntegrationContext::IntegrationContext(const VariableTransform &_transform, const int &_engine,
+										const int &_threads) : transform(_transform), engine(_engine),
+										splitPolicy(DEFAULT_SPLIT_POLICY), threads(_threads), status(INTEGRATION_STATUS_OK),
+										evaluations(0), regions(0), trace(nullptr){
+}
+
+// function that records a point sampled, handing the points to the writer every
+// TRACE_CHUNK_SIZE of them
+void IntegrationContext::record(const double &x, const double &y, const double &z, const double &value,
+								const int &inDomain, const int &level, const int &depth){
+	traceChunk.add(x,y,z,value,inDomain,level,depth);
+	if(traceChunk.size()>=TRACE_CHUNK_SIZE){
+		trace->submit(traceChunk);
+	}
+}
+
+// function that hands the points recorded to the writer
+void IntegrationContext::flushTrace(){
+	if(trace!=nullptr){
+		trace->submit(traceChunk);
+	}
+}
+
+
+//===================== Integral3D Class =====================//
 // default constructor that set default values to variables
-Integral3D::Integral3D() : approximationFlag(ERROR_INTEGRATION_FLAG_BASE_STATE){}
+Integral3D::Integral3D() : approximationFlag(ERROR_INTEGRATION_FLAG_BASE_STATE), engine(DEFAULT_ENGINE),
+							splitPolicy(DEFAULT_SPLIT_POLICY), precisionMode(DEFAULT_PRECISION_MODE), tightBounding(1),
+							unboundedMode(DEFAULT_UNBOUNDED_MODE), coordinates(DEFAULT_COORDINATES),
+							threads(DEFAULT_REGION_THREADS), inFlight(DEFAULT_IN_FLIGHT), sensitivities(0),
+							controlScaling(DEFAULT_CONTROL_SCALING){}
 
 // empty destructor
 Integral3D::~Integral3D(){}
 
 // this function takes in input a function, a minimum tolerance "epsilon", a variable in which the final error
-// is stored in, and the max number of Romberg's step and recursions(if those are -1 default value is used)
+// is stored in, and the max number of Romberg's step and recursions(if those are -1 default value is used).
+// If the last integration was on the same function, it's refined instead of restarted.
 double Integral3D::operator()(const Function3D &function, double &finalError, double epsilon, int MAXN, int MAXR){
+	return (*this)(function,state,finalError,epsilon,MAXN,MAXR);
+}
+
+// this function is as the one above, but the integration continues the given state. If the
+// state refers to another function it's discarded, and the integration starts over.
+double Integral3D::operator()(const Function3D &function, IntegrationState &_state, double &finalError,
+								double epsilon, int MAXN, int MAXR){
+	IntegrationResult result = integrate(function,_state,epsilon,MAXN,MAXR);
+	finalError = result.error;
+	stats = result.stats;
+	approximationFlag = ERROR_INTEGRATION_FLAG_BASE_STATE;
+	if(result.status & INTEGRATION_STATUS_DEPTH_LIMITED){
+		approximationFlag = ERROR_INTEGRATION_FLAG_TRIGGERED_STATE;
+		logStream() << WARNING_LOG << "at least one recursion reached maximum depth."
+					<< " Error may be greater than the one required." << std::endl;
+	}
+	if(result.status & INTEGRATION_STATUS_EVALUATION_FAILED){
+		logStream() << WARNING_LOG << "some points couldn't be evaluated, the result is not reliable." << std::endl;
+	}
+	if(result.status & INTEGRATION_STATUS_ENGINE_REPLACED){
+		logStream() << WARNING_LOG << "the domain cuts the box, integrated with the hybrid engine instead of the sparse grid." << std::endl;
+	}
+	return result.value;
+}
+
+// this function integrates the function from scratch, and returns the result
+// instead of printing warnings, so it can be called by many threads at once
+IntegrationResult Integral3D::integrate(const Function3D &function, double epsilon, int MAXN, int MAXR) const{
+	IntegrationState _state;
+	return integrate(function,_state,epsilon,MAXN,MAXR);
+}
+
+// this function is as the one above, but the integration continues the given state. If the
+// state refers to another function(or was built with other settings) it's discarded, and the
+// integration starts over. Only the state is written, so threads with different states
+// don't interfere.
+IntegrationResult Integral3D::integrate(const Function3D &function, IntegrationState &_state,
+										double epsilon, int MAXN, int MAXR) const{
+	IntegrationResult result;
 	if(epsilon==-1){
 		epsilon = DEFAULT_ERROR;
 	}
@@ -283,150 +983,1694 @@ double Integral3D::operator()(const Function3D &function, double &finalError, do
 	if(MAXR==-1){
 		MAXR = DEFAULT_MAXR;
 	}
-	Parallelepiped domain = rectanglifyDomain(function);
-	finalError = 0; // reset error
+	if(!function.isCallable()){
+		result.status = INTEGRATION_STATUS_NOT_CALLABLE;
+		return result;
+	}
+	if(!_state.isCompatible(function) or _state.engine!=engine or _state.precisionMode!=precisionMode
+		or _state.tightBounding!=tightBounding or _state.unboundedMode!=unboundedMode
+		or _state.controlScaling!=controlScaling or _state.coordinates!=coordinates){
+		_state.reset();
+		_state.function = function;
+		_state.engine = engine;
+		_state.precisionMode = precisionMode;
+		_state.tightBounding = tightBounding;
+		_state.unboundedMode = unboundedMode;
+		_state.controlScaling = controlScaling;
+		_state.coordinates = coordinates;
+		Parallelepiped box = integrationBox(function,_state.transform,_state.stats,_state.ellipsoid);
+		_state.controlScale = function.getControlScale();
+		if(function.hasControlVariate() and controlScaling==CONTROL_SCALING_AUTO){
+			_state.controlScale = controlScale(function,box,_state.transform);
+		}
+		// only a part of symmetric domains is integrated, if the parity
+		// of the function is declared(the spherical coordinates aren't symmetric)
+		if(!_state.transform.isEllipsoidal()){
+			_state.symmetryFactor = symmetryReduction(function,box,_state.reduced);
+		}
+		_state.root = IntegrationRegion(box,ZERO_STATE);
+		_state.hasRoot = 1;
+	}
+	const Parallelepiped &domain = _state.root.domain;
+	const double &factor = _state.symmetryFactor;
+	result.stats = _state.stats;
 	// if domain has at least one coordinate that doesn't have width, it's
-	// 2 dimensional, and 3D integrals on 2D surfaces are 0
+	// 2 dimensional, and 3D integrals on 2D surfaces are 0. The same if
+	// the function is odd over a symmetric domain
 	if(domain.xwidth==0 or domain.ywidth==0 or domain.zwidth==0){
-		return 0;
+		result.status = INTEGRATION_STATUS_EMPTY_DOMAIN;
+		return result;
 	}
-	approximationFlag = ERROR_INTEGRATION_FLAG_BASE_STATE;
-	double r = rombergIntegral(function,domain,epsilon,finalError,MAXN,MAXR);
-	if(approximationFlag == ERROR_INTEGRATION_FLAG_TRIGGERED_STATE){
-		std::cerr << WARNING_LOG << "at least one recursion reached maximum depth."
-					<< " Error may be greater than the one required." << std::endl;
+	if(factor==0){
+		result.status = INTEGRATION_STATUS_ZERO_BY_SYMMETRY;
+		return result;
 	}
-	return r;
-}
-
-//========= private functions =========//
-
-// functions related to the evaluation of the integral:
-
-// This function is responsable to calculate the integral using Romberg's algorithm, with adaptive
-// quadrature. MAXN is the maximum depth of Romberg's algorithm, whilst MAXR is the maximum recursion depth.
-// "recursion" keeps track of the recursion depth the function is in, by default it's 0.
-double Integral3D::rombergIntegral(const Function3D &function, const Parallelepiped &domain,
-									const double &epsilon, double &finalError, const int &MAXN, const int &MAXR,
-									const int &recursion){
-	// If received domain has depth 0 on any dimension, the integral is 0.
-	if(domain.xwidth==0 or domain.ywidth==0 or domain.zwidth==0){
-		return 0;
+	// the domain test is done with the most selective inequalities first
+	Function3D ordered(function);
+	if(function.getInequalityCount()>1){
+		ordered.setEvaluationOrder(selectivityOrder(function,domain,_state.transform));
 	}
-	if(MAXN==0){
-		return 0;
+	// with a control variate the residual f-scale*g is integrated, and scale times the
+	// known integral of g is added back
+	if(function.hasControlVariate()){
+		ordered.setControlScale(_state.controlScale);
 	}
-	// Romberg's algorithm
-	double R[MAXN][MAXN]; // Romberg's table
-	double temp;
-	int i,j;
-	R[0][0] = directionedTrapezoidIntegral(function, domain, 0); // trapezoidal integral
-	for(i=1;i<MAXN;++i){
-		// trapezoidal integral using successing refinements
-		R[i][0] = R[i-1][0]/8+directionedTrapezoidIntegral(function, domain, pow(2,i)-1);
-		for(j=1;j<=i;++j){
-			temp = pow(4,j);
-			R[i][j] = ( temp*R[i][j-1]-R[i-1][j-1] )/( temp-1 ); // Richardson's extrapolation
+	// the box in spherical coordinates is all inside the ellipsoid, whose border is the
+	// side of radius 1: it isn't tested, so the integrand stays smooth up to it
+	if(_state.ellipsoid>0){
+		ordered.setInequality(_state.ellipsoid,Inequality(std::map<std::string,double>{{"r",1},{">",1}}));
+	}
+	// the integral of a constant function is its value times the volume of the domain,
+	// which the hybrid engine finds evaluating the function only on the border
+	const FunctionHints &hints = function.getHints();
+	int regionEngine = engine;
+	if(hints.isConstant and !function.hasControlVariate() and _state.transform.isIdentity()){
+		if(hints.constant==0){
+			return result;
+		}
+		regionEngine = ENGINE_HYBRID;
+	}
+	// the function jumps to 0 on the border of the domain, which the smooth rules of the
+	// sparse grid can't follow: if the border cuts the box the hybrid engine is used
+	int replaced = regionEngine==ENGINE_SPARSE_GRID and _state.transform.isIdentity()
+					and ordered.classify(domain)!=BOX_INSIDE;
+	if(replaced){
+		regionEngine = ENGINE_HYBRID;
+	}
+	IntegrationContext context(_state.transform,regionEngine,hints.threadSafe ? threads : 1);
+	context.splitPolicy = splitPolicy;
+	context.trace = trace.get();
+	const IntegrandSource *source = function.getSource();
+	if(source!=nullptr and _state.transform.isIdentity() and !function.hasControlVariate()
+		and !source->integrate(ordered,domain,epsilon/factor,result.value,result.error,context)){
+		// the integrand integrated itself, without the region tree
+		result.value *= factor;
+	}else if(regionEngine==ENGINE_SPARSE_GRID){
+		// the levels of the rules take the place of both Romberg's levels and recursions,
+		// and the grid is built again at every call
+		SparseGrid grid(domain,_state.transform,MAXN+MAXR,precisionMode);
+		result.value = factor*grid.integrate(ordered,epsilon/factor,result.error,context);
+		// some node fell outside the domain(only known after the transform), so the
+		// integral is computed again by the region tree, keeping the evaluations done
+		if(grid.cutsDomain()){
+			replaced = 1;
+			result.error = 0;
+			context.regions = 0;
+			context.status &= ~INTEGRATION_STATUS_DEPTH_LIMITED;
+			context.engine = ENGINE_HYBRID;
+			result.value = factor*regionIntegral(ordered,_state.root,epsilon/factor,result.error,context,MAXN,MAXR);
+		}
+	}else if(regionEngine==ENGINE_BREADTH_FIRST){
+		// the regions of a depth are integrated together, without keeping the region tree
+		BreadthFirst breadthFirst(domain,_state.transform,MAXN,MAXR,precisionMode,inFlight);
+		result.value = factor*breadthFirst.integrate(ordered,epsilon/factor,result.error,context);
+	}else{
+		result.value = factor*regionIntegral(ordered,_state.root,epsilon/factor,result.error,context,MAXN,MAXR);
+		// the border is found by the leaves of the region tree, in the space coordinates
+		if(sensitivities and _state.transform.isIdentity()){
+			BoundarySensitivity sensitivity(ordered,_state.root,factor,_state.reduced);
+			if(sensitivity.compute(result.gradient,result.gradientErrors,context.evaluations)){
+				context.status |= INTEGRATION_STATUS_EVALUATION_FAILED;
+			}
+		}
+	}
+	context.flushTrace();
+	result.error *= factor;
+	if(ordered.hasControlVariate()){
+		result.value += ordered.getControlScale()*ordered.getControlIntegral();
+	}
+	result.status = context.status | (replaced ? INTEGRATION_STATUS_ENGINE_REPLACED : 0);
+	result.evaluations = context.evaluations;
+	result.regions = context.regions;
+	return result;
+}
+
+// this function integrates independent jobs on the given number of threads(one per core
+// if 0), each one from scratch. The functions of the jobs must be safe to call from
+// many threads. Results are in the same order of the jobs.
+std::vector<IntegrationResult> Integral3D::integrateJobs(const std::vector<IntegrationJob> &jobs,
+															int threads) const{
+	std::vector<IntegrationResult> results(jobs.size());
+	std::atomic<size_t> next(0);
+	std::vector<std::thread> workers;
+	int i;
+	if(threads<=0){
+		threads = std::thread::hardware_concurrency();
+	}
+	if(threads<=0){
+		threads = 1;
+	}
+	if((size_t)threads>jobs.size()){
+		threads = jobs.size();
+	}
+	for(const IntegrationJob &job : jobs){
+		if(!job.function.getHints().threadSafe){
+			threads = 1;
+		}
+	}
+	// every worker takes the next job not taken yet, so that long jobs
+	// don't keep the others waiting
+	auto worker = [&](){
+		size_t job;
+		while((job = next++)<jobs.size()){
+			const IntegrationJob &current = jobs[job];
+			results[job] = integrate(current.function,current.epsilon,current.MAXN,current.MAXR);
+		}
+	};
+	for(i=1;i<threads;++i){
+		workers.emplace_back(worker);
+	}
+	worker();
+	for(i=0;i<(int)workers.size();++i){
+		workers[i].join();
+	}
+	return results;
+}
+
+// this function integrates over the domains obtained giving each value of "thresholds" to
+// the "r" coefficient of an inequality. Growing r(or decreasing it, for "<") grows the
+// domain, so the box is the one of the biggest domain, and every point is sampled once:
+// the values of the inequality at the points then tell which integrals they belong to.
+// The box isn't transformed, so infinite sides are truncated.
+SweepResult Integral3D::sweep(const Function3D &function, const int &inequality,
+								const std::vector<double> &thresholds, double epsilon, int MAXN, int MAXR) const{
+	SweepResult result;
+	IntegrationStats sweepStats;
+	if(epsilon==-1){
+		epsilon = DEFAULT_ERROR;
+	}
+	if(MAXN==-1){
+		MAXN = DEFAULT_MAXN;
+	}
+	if(MAXR==-1){
+		MAXR = DEFAULT_MAXR;
+	}
+	result.thresholds = thresholds;
+	result.values.assign(thresholds.size(),0);
+	result.errors.assign(thresholds.size(),0);
+	if(!function.isCallable() or inequality<1 or inequality>function.getInequalityCount()){
+		result.status = INTEGRATION_STATUS_NOT_CALLABLE;
+		return result;
+	}
+	if(thresholds.empty()){
+		return result;
+	}
+	LevelSetSweep levelSet(function,inequality,thresholds);
+	const Function3D &biggest = levelSet.getBiggest();
+	Parallelepiped box = rectanglifyDomain(biggest);
+	if(tightBounding){
+		box = tightenDomain(biggest,box,sweepStats);
+	}
+	if(box.xwidth==0 or box.ywidth==0 or box.zwidth==0){
+		result.status = INTEGRATION_STATUS_EMPTY_DOMAIN;
+		return result;
+	}
+	levelSet.integrate(box,epsilon,MAXN,MAXR,result);
+	return result;
+}
+
+// function that integrates the function over many domains at once. The box is the smallest
+// one containing the boxes of all the domains, and each point sampled in it is evaluated
+// once and counted by every domain it's in.
+MultiDomainResult Integral3D::integrateDomains(const Function3D &function,
+												const std::vector<std::pair<Inequality,Inequality>> &domains,
+												double epsilon, int MAXN, int MAXR) const{
+	MultiDomainResult result;
+	IntegrationStats domainStats;
+	Parallelepiped box, united;
+	double xmin = INFINITY, xmax = -INFINITY, ymin = INFINITY, ymax = -INFINITY, zmin = INFINITY, zmax = -INFINITY;
+	size_t i;
+	if(epsilon==-1){
+		epsilon = DEFAULT_ERROR;
+	}
+	if(MAXN==-1){
+		MAXN = DEFAULT_MAXN;
+	}
+	if(MAXR==-1){
+		MAXR = DEFAULT_MAXR;
+	}
+	result.values.assign(domains.size(),0);
+	result.errors.assign(domains.size(),0);
+	if(!function.isCallable()){
+		result.status = INTEGRATION_STATUS_NOT_CALLABLE;
+		return result;
+	}
+	MultiDomain multiDomain(function,domains);
+	for(i=0;i<domains.size();++i){
+		const Function3D &domain = multiDomain.getDomain(i);
+		if(!domain.isCallable()){
+			result.status = INTEGRATION_STATUS_NOT_CALLABLE;
+			return result;
+		}
+		box = rectanglifyDomain(domain);
+		if(tightBounding){
+			box = tightenDomain(domain,box,domainStats);
 		}
+		// empty domains don't widen the box
+		if(box.xwidth==0 or box.ywidth==0 or box.zwidth==0){
+			continue;
+		}
+		xmin = std::min(xmin,box.vertex.x);
+		xmax = std::max(xmax,box.vertex.x+box.xwidth);
+		ymin = std::min(ymin,box.vertex.y);
+		ymax = std::max(ymax,box.vertex.y+box.ywidth);
+		zmin = std::min(zmin,box.vertex.z);
+		zmax = std::max(zmax,box.vertex.z+box.zwidth);
+	}
+	if(xmin>=xmax){
+		result.status = INTEGRATION_STATUS_EMPTY_DOMAIN;
+		return result;
+	}
+	united = Parallelepiped(Point3D(xmin,ymin,zmin),xmax-xmin,ymax-ymin,zmax-zmin);
+	multiDomain.integrate(united,epsilon,MAXN,MAXR,result);
+	return result;
+}
+
+// function that forget the last integration, so that the next one starts over
+void Integral3D::resetState(){
+	state.reset();
+}
+
+// function that returns information about the last integration
+const IntegrationStats& Integral3D::getStats() const{
+	return stats;
+}
+
+// function that returns ERROR_INTEGRATION_FLAG_TRIGGERED_STATE if in the last
+// integration at least one region reached both MAXN and MAXR
+int Integral3D::getApproximationFlag() const{
+	return approximationFlag;
+}
+
+// function that choose if the box given by rectanglifyDomain is tightened
+// considering all inequalities together
+void Integral3D::setTightBounding(const int &flag){
+	tightBounding = flag;
+	state.reset();
+}
+
+// function that returns if the box is tightened
+int Integral3D::getTightBounding() const{
+	return tightBounding;
+}
+
+// function that choose how the infinite sides of the domain are handled:
+// UNBOUNDED_MODE_TRUNCATE cuts them to MAX_BOUNDED_SIZE, UNBOUNDED_MODE_TRANSFORM
+// maps them from finite intervals with a change of variables
+void Integral3D::setUnboundedMode(const int &mode){
+	if(mode!=UNBOUNDED_MODE_TRUNCATE and mode!=UNBOUNDED_MODE_TRANSFORM){
+		logStream() << WARNING_LOG << "unknown unbounded mode, default is used." << std::endl;
+		unboundedMode = DEFAULT_UNBOUNDED_MODE;
+	}else{
+		unboundedMode = mode;
+	}
+	state.reset();
+}
+
+// function that returns how the infinite sides of the domain are handled
+int Integral3D::getUnboundedMode() const{
+	return unboundedMode;
+}
+
+// function that choose the coordinates of the box integrated(COORDINATES_*). With
+// COORDINATES_ELLIPSOIDAL a domain inside an ellipsoid(one of its inequalities) is
+// integrated in spherical coordinates of the ellipsoid, so the border of the ellipsoid
+// doesn't cut the box, otherwise the box containing the domain is used
+void Integral3D::setCoordinates(const int &_coordinates){
+	if(_coordinates!=COORDINATES_CARTESIAN and _coordinates!=COORDINATES_ELLIPSOIDAL){
+		logStream() << WARNING_LOG << "unknown coordinates, default is used." << std::endl;
+		coordinates = DEFAULT_COORDINATES;
+	}else{
+		coordinates = _coordinates;
+	}
+	state.reset();
+}
+
+// function that returns the coordinates of the box integrated
+int Integral3D::getCoordinates() const{
+	return coordinates;
+}
+
+// function that choose the precision of the trapezoidal sums(PRECISION_MODE_*),
+// to be noted that the stored integration is discarded since the old tables
+// were computed with another precision
+void Integral3D::setPrecisionMode(const int &mode){
+	if(mode<PRECISION_MODE_DOUBLE or mode>PRECISION_MODE_LONG_DOUBLE){
+		logStream() << WARNING_LOG << "unknown precision mode, default is used." << std::endl;
+		precisionMode = DEFAULT_PRECISION_MODE;
+	}else{
+		precisionMode = mode;
+	}
+	state.reset();
+}
+
+// function that returns the precision mode in use
+int Integral3D::getPrecisionMode() const{
+	return precisionMode;
+}
+
+// function that choose the engine of the integration(ENGINE_*)
+void Integral3D::setEngine(const int &_engine){
+	if(_engine!=ENGINE_ROMBERG and _engine!=ENGINE_SPARSE_GRID and _engine!=ENGINE_HYBRID
+		and _engine!=ENGINE_BREADTH_FIRST){
+		logStream() << WARNING_LOG << "unknown engine, default is used." << std::endl;
+		engine = DEFAULT_ENGINE;
+	}else{
+		engine = _engine;
+	}
+	state.reset();
+}
+
+// function that returns the engine of the integration
+int Integral3D::getEngine() const{
+	return engine;
+}
+
+// function that choose the number of threads integrating the 8 subregions of the
+// root(0 means one per core). The function must be safe to call from many threads.
+void Integral3D::setThreads(const int &_threads){
+	threads = _threads;
+	if(threads<=0){
+		threads = std::thread::hardware_concurrency();
+	}
+	if(threads<=0){
+		threads = 1;
+	}
+}
+
+// function that choose when the regions of Romberg's algorithm are split(SPLIT_POLICY_*).
+// The regions already split are kept, since both policies give trees that can be refined
+void Integral3D::setSplitPolicy(const int &policy){
+	if(policy!=SPLIT_POLICY_FULL and policy!=SPLIT_POLICY_ADAPTIVE){
+		logStream() << WARNING_LOG << "unknown split policy, default is used." << std::endl;
+		splitPolicy = DEFAULT_SPLIT_POLICY;
+	}else{
+		splitPolicy = policy;
+	}
+}
+
+// function that returns the policy of the splits of Romberg's algorithm
+int Integral3D::getSplitPolicy() const{
+	return splitPolicy;
+}
+
+// function that choose the batches kept in flight by the breadth-first engine when the
+// function has an asynchronous submit(at least 1)
+void Integral3D::setInFlight(const int &_inFlight){
+	if(_inFlight<1){
+		logStream() << WARNING_LOG << "batches in flight should be at least 1, default is used." << std::endl;
+		inFlight = DEFAULT_IN_FLIGHT;
+	}else{
+		inFlight = _inFlight;
+	}
+}
+
+// function that returns the batches kept in flight by the breadth-first engine
+int Integral3D::getInFlight() const{
+	return inFlight;
+}
+
+// function that returns the number of threads integrating the subregions of the root
+int Integral3D::getThreads() const{
+	return threads;
+}
+
+// function that choose if the derivatives of the integral with respect to the coefficients
+// of the inequalities are computed by the next integrations
+void Integral3D::setSensitivities(const int &flag){
+	sensitivities = flag;
+}
+
+// function that returns if the derivatives are computed
+int Integral3D::getSensitivities() const{
+	return sensitivities;
+}
+
+// function that choose how the multiplier of the control variate is chosen: the one of
+// the Function3D(CONTROL_SCALING_FIXED) or the one making the residual f-scale*g as flat
+// as possible over the domain(CONTROL_SCALING_AUTO)
+void Integral3D::setControlScaling(const int &scaling){
+	if(scaling!=CONTROL_SCALING_FIXED and scaling!=CONTROL_SCALING_AUTO){
+		logStream() << WARNING_LOG << "unknown control scaling, default is used." << std::endl;
+		controlScaling = DEFAULT_CONTROL_SCALING;
+	}else{
+		controlScaling = scaling;
+	}
+	state.reset();
+}
+
+// function that returns how the multiplier of the control variate is chosen
+int Integral3D::getControlScaling() const{
+	return controlScaling;
+}
+
+// function that estimates the multiplier of the control variate of a function over the
+// box integrate would use(the one of the Function3D if it can't be estimated)
+double Integral3D::estimateControlScale(const Function3D &function) const{
+	VariableTransform transform;
+	IntegrationStats domainStats;
+	int ellipsoid;
+	if(!function.isCallable() or !function.hasControlVariate()){
+		return function.getControlScale();
+	}
+	Parallelepiped box = integrationBox(function,transform,domainStats,ellipsoid);
+	return controlScale(function,box,transform);
+}
+
+// function that sets the writer recording every point sampled by the next integrations
+// (nullptr stops recording). The writer is shared, so it can be closed after them.
+void Integral3D::setTrace(const std::shared_ptr<TraceWriter> &_trace){
+	trace = _trace;
+}
+
+// function that returns the writer recording the points sampled
+const std::shared_ptr<TraceWriter>& Integral3D::getTrace() const{
+	return trace;
+}
+
+// This function probes the function to choose the parameters of the integration:
+// the time per point and the observed order of convergence come from a coarse
+// Romberg's table on the whole box, the fill ratio from the tightening of the box.
+// Smooth functions gain from deeper Romberg's tables, while functions(or domains)
+// with discontinuities converge slowly everywhere, and gain from splitting the border.
+TuningReport Integral3D::autotune(const Function3D &function, double epsilon) const{
+	TuningReport report;
+	std::ostringstream reason;
+	int i, levels, fills;
+	double ratio;
+	if(epsilon==-1){
+		epsilon = DEFAULT_ERROR;
+	}
+	if(!function.isCallable()){
+		report.reasons.push_back("function not loaded, defaults are kept");
+		return report;
+	}
+	// box of the integration, as built by integrate
+	VariableTransform transform;
+	IntegrationStats stats;
+	int ellipsoid;
+	Parallelepiped box = integrationBox(function,transform,stats,ellipsoid);
+	report.fillRatio = stats.fillRatio;
+	if(box.xwidth==0 or box.ywidth==0 or box.zwidth==0){
+		report.reasons.push_back("empty domain, defaults are kept");
+		return report;
+	}
+	// the fill ratio is sampled, so in the space coordinates the box is also classified:
+	// a border cutting it between the samples would still break the sparse grid
+	fills = report.fillRatio>=AUTOTUNE_SPARSE_FILL and (!transform.isIdentity() or function.classify(box)==BOX_INSIDE);
+
+	// coarse Romberg's table, timed
+	IntegrationRegion probe(box,ZERO_STATE);
+	IntegrationContext context(transform);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(i=0;i<AUTOTUNE_PROBE_LEVELS;++i){
+		rombergStep(function,probe,context);
+	}
+	report.evaluationTime = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count()
+							/context.evaluations;
+	// the corrections of the diagonal decrease as h^order
+	i = AUTOTUNE_PROBE_LEVELS-1;
+	report.estimate = probe.R[i][i];
+	report.correction = std::fabs(probe.R[i][i]-probe.R[i-1][i-1]);
+	ratio = std::fabs(probe.R[i-1][i-1]-probe.R[i-2][i-2]);
+	if(report.correction==0 or ratio==0){
+		report.order = AUTOTUNE_MAX_ORDER;
+	}else{
+		report.order = std::min<double>(std::max(std::log2(ratio/report.correction),1.0),AUTOTUNE_MAX_ORDER);
+	}
+	// what the provider declares replaces what the probe measures
+	const FunctionHints &hints = function.getHints();
+	if(hints.cost>0){
+		report.evaluationTime = hints.cost;
+		report.reasons.push_back("cost per call declared by the function");
+	}
+	if(hints.smoothness==SMOOTHNESS_DISCONTINUOUS){
+		report.order = 1;
+		report.reasons.push_back("declared discontinuous: order 1");
+	}else if(hints.smoothness==SMOOTHNESS_SMOOTH and fills){
+		report.order = std::max<double>(report.order,AUTOTUNE_SMOOTH_ORDER);
+		report.reasons.push_back("declared smooth, and the domain fills the box");
+	}
+	// halvings of the step still needed to meet the tolerance
+	levels = 0;
+	if(report.correction>epsilon){
+		levels = std::ceil(std::log2(report.correction/epsilon)/report.order);
+	}
+	reason << "probe: " << context.evaluations << " points, " << report.evaluationTime*1e9
+			<< " ns per point, observed order " << report.order << ", fill ratio " << report.fillRatio
+			<< ", " << levels << " more halvings of the step needed";
+	report.reasons.push_back(reason.str());
+	reason.str("");
+
+	// depth of the Romberg's table against depth of the recursion
+	if(report.order>=AUTOTUNE_SMOOTH_ORDER){
+		report.MAXN = AUTOTUNE_PROBE_LEVELS+levels;
+		report.MAXR = 1;
+		if(report.MAXN>AUTOTUNE_MAX_MAXN){
+			report.MAXR = std::min(report.MAXN-AUTOTUNE_MAX_MAXN,AUTOTUNE_MAX_MAXR);
+			report.MAXN = AUTOTUNE_MAX_MAXN;
+		}
+		reason << "smooth(order>=" << AUTOTUNE_SMOOTH_ORDER << "): extrapolation converges fast, MAXN="
+				<< report.MAXN << " MAXR=" << report.MAXR;
+	}else{
+		report.MAXN = AUTOTUNE_ROUGH_MAXN;
+		report.MAXR = std::min(std::max(levels,1),AUTOTUNE_MAX_MAXR);
+		reason << "not smooth(order<" << AUTOTUNE_SMOOTH_ORDER << "): extrapolation doesn't help, splitting"
+				<< " refines only where needed, MAXN=" << report.MAXN << " MAXR=" << report.MAXR;
+		if(report.fillRatio<AUTOTUNE_LOW_FILL and report.MAXR<AUTOTUNE_MAX_MAXR){
+			++report.MAXR;
+			reason << ", MAXR=" << report.MAXR << " since the border dominates(fill ratio<"
+					<< AUTOTUNE_LOW_FILL << ")";
+		}
+	}
+	report.reasons.push_back(reason.str());
+	reason.str("");
+
+	// worst case: every region reaches both MAXN and MAXR
+	auto worstTime = [&](){
+		double side = std::pow(2,report.MAXN-1)+1;
+		return std::pow(8,report.MAXR)*side*side*side*report.evaluationTime;
+	};
+	report.expectedTime = worstTime();
+	while(report.expectedTime>AUTOTUNE_TIME_BUDGET and (report.MAXN>AUTOTUNE_PROBE_LEVELS or report.MAXR>0)){
+		if(report.MAXN>AUTOTUNE_PROBE_LEVELS and (report.order>=AUTOTUNE_SMOOTH_ORDER or report.MAXR==0)){
+			--report.MAXN;
+		}else{
+			--report.MAXR;
+		}
+		report.expectedTime = worstTime();
+		reason.str("");
+		reason << "worst case over " << AUTOTUNE_TIME_BUDGET << " s, reduced to MAXN=" << report.MAXN
+				<< " MAXR=" << report.MAXR;
+	}
+	if(!reason.str().empty()){
+		report.reasons.push_back(reason.str());
+		reason.str("");
+	}
+
+	// sparse grids need the function to be smooth on the whole box, so the
+	// domain must not cut it
+	if(hints.isConstant and !function.hasControlVariate() and transform.isIdentity()){
+		report.engine = ENGINE_HYBRID;
+		reason << "declared constant: the volume of the domain is computed, evaluating only on its border";
+	}else if(report.order>=AUTOTUNE_SMOOTH_ORDER and fills){
+		report.engine = ENGINE_SPARSE_GRID;
+		reason << "smooth and the domain fills the box: sparse grid engine, levels up to MAXN+MAXR";
+	}else if(!fills and transform.isIdentity()){
+		report.engine = ENGINE_HYBRID;
+		reason << "the domain cuts the box: hybrid engine, Gauss-Legendre inside the domain and"
+				<< " Romberg's algorithm only on its border";
+	}else{
+		report.engine = ENGINE_ROMBERG;
+		reason << "the function isn't smooth, or the domain is transformed: Romberg's engine";
+	}
+	report.reasons.push_back(reason.str());
+	reason.str("");
+
+	// precision of the sums, relative to the size of the integral
+	ratio = epsilon/std::max(std::fabs(report.estimate),std::numeric_limits<double>::min());
+	if(ratio<AUTOTUNE_COMPENSATED_TOLERANCE){
+		report.precisionMode = PRECISION_MODE_COMPENSATED;
+		reason << "relative tolerance " << ratio << "<" << AUTOTUNE_COMPENSATED_TOLERANCE
+				<< ": compensated sums";
+	}else if(ratio>AUTOTUNE_FLOAT_TOLERANCE and function.hasFloatFunction()){
+		report.precisionMode = PRECISION_MODE_FLOAT;
+		reason << "relative tolerance " << ratio << ">" << AUTOTUNE_FLOAT_TOLERANCE
+				<< " and float function given: float evaluation";
+	}else{
+		report.precisionMode = PRECISION_MODE_DOUBLE;
+		reason << "relative tolerance " << ratio << ": double sums";
+	}
+	report.reasons.push_back(reason.str());
+	reason.str("");
+
+	// threads only pay off if the integration is long enough
+	report.threads = 1;
+	if(!hints.threadSafe){
+		reason << "declared not thread-safe: threads=1";
+	}else if(report.expectedTime>AUTOTUNE_PARALLEL_TIME and report.MAXR>0 and report.engine!=ENGINE_SPARSE_GRID){
+		report.threads = std::min<int>(std::max<int>(std::thread::hardware_concurrency(),1),8);
+		reason << "worst case " << report.expectedTime << " s: threads=" << report.threads
+				<< " on the subregions of the root";
+	}else{
+		reason << "worst case " << report.expectedTime << " s: threads=1, starting more costs more";
+	}
+	report.reasons.push_back(reason.str());
+	return report;
+}
+
+// function that sets the engine, the precision mode and the threads chosen by autotune,
+// MAXN and MAXR are instead passed to the integration
+void Integral3D::applyTuning(const TuningReport &report){
+	setEngine(report.engine);
+	setPrecisionMode(report.precisionMode);
+	setThreads(report.threads);
+}
+
+//========= private functions =========//
+
+// functions related to the evaluation of the integral:
+
+// This function is responsable to calculate the integral using Romberg's algorithm, with adaptive
+// quadrature. MAXN is the maximum depth of Romberg's algorithm, whilst MAXR is the maximum recursion depth.
+// The region keeps the work of previous calls: leaves continue their Romberg's table from the last
+// row computed, and regions already split only pass the work to their children.
+double Integral3D::rombergIntegral(const Function3D &function, IntegrationRegion &region, const double &epsilon,
+									double &finalError, IntegrationContext &context, const int &MAXN,
+									const int &MAXR) const{
+	const Parallelepiped &domain = region.domain;
+	int split_number = 8;
+	int i, border;
+	// If received domain has depth 0 on any dimension, the integral is 0.
+	if(domain.xwidth==0 or domain.ywidth==0 or domain.zwidth==0){
+		return 0;
+	}
+	if(MAXN==0){
+		return 0;
+	}
+
+	// region already split, the refinement is only done on the leaves
+	if(!region.children.empty()){
+		return integrateChildren(function,region,epsilon,finalError,context,MAXN,MAXR);
+	}
+
+	// leaf that already meets the tolerance
+	++context.regions;
+	if(region.converged and region.error<epsilon){
+		finalError += region.error;
+		return region.value;
+	}
+
+	// Romberg's algorithm, continuing from the last row computed
+	if(region.R.empty()){
+		rombergStep(function, region, context); // trapezoidal integral
+	}
+	// with the adaptive policy the regions crossing the border of the domain(only known in
+	// the space coordinates) are split after the first row, see splitEarly
+	border = context.splitPolicy==SPLIT_POLICY_ADAPTIVE and region.recursion<MAXR and context.transform.isIdentity()
+				and function.classify(domain)==BOX_BOUNDARY;
+	while((int)region.R.size()<MAXN and !border){
+		rombergStep(function, region, context);
+		i = region.R.size()-1;
+		const std::vector<double> &last = region.R[i-1];
+		const std::vector<double> &current = region.R[i];
 		// checking for early stop if error tolerance is met
 		// 0s are excluded cause it may be not enough refined to find
 		// points inisde the domain
-		if(std::fabs(R[i-1][i-1]-R[i][i])<epsilon and i-1>=0 and R[i][i]!=0 and R[i][i-1]!=0){
-			finalError += std::fabs(R[i-1][i-1]-R[i][i]); 
-			return R[i][i];
+		if(std::fabs(last[i-1]-current[i])<epsilon and current[i]!=0 and current[i-1]!=0){
+			region.converged = 1;
+			region.depthLimited = 0;
+			region.error = std::fabs(last[i-1]-current[i]);
+			region.value = current[i];
+			finalError += region.error;
+			return region.value;
+		}
+		// the rows left are skipped if the children are expected to cost less
+		if(context.splitPolicy==SPLIT_POLICY_ADAPTIVE and region.recursion<MAXR
+			and splitEarly(region,epsilon,MAXN)){
+			break;
 		}
 	}
 
 	// adaptive integration implementation
-	if(recursion<MAXR){
-		int split_number = 8;
-		double sum = 0;
+	if(region.recursion<MAXR){
+		--context.regions; // it's not a leaf anymore
+		region.children.resize(split_number);
 		std::vector<Parallelepiped> newDomains;
 		newDomains.resize(split_number);
 		splitDomain(domain,newDomains);
 		for(i=0;i<split_number;++i){
-			sum += rombergIntegral(function,newDomains[i],epsilon/split_number,
-									finalError,MAXN,MAXR,recursion+1);
+			region.children[i] = IntegrationRegion(newDomains[i],region.recursion+1);
 		}
-		return sum;
+		// the table of a split region is not needed anymore
+		region.R.clear();
+		return integrateChildren(function,region,epsilon,finalError,context,MAXN,MAXR);
 	}
 
 	// if both MAXN and MAXR are reached the "best" value obtained is returned
-	if(R[MAXN-1][MAXN-1]!=0){
-		approximationFlag = ERROR_INTEGRATION_FLAG_TRIGGERED_STATE;
+	i = region.R.size()-1;
+	region.converged = 0;
+	region.value = region.R[i][i];
+	region.depthLimited = region.value!=0;
+	if(region.depthLimited){
+		context.status |= INTEGRATION_STATUS_DEPTH_LIMITED;
 	}
-	if(MAXN==1){
-		finalError += std::fabs(R[0][0]);
+	if(i==0){
+		region.error = std::fabs(region.R[0][0]);
 	}else{
-		finalError += std::fabs(R[MAXN-2][MAXN-2]-R[MAXN-1][MAXN-1]); 
+		region.error = std::fabs(region.R[i-1][i-1]-region.R[i][i]);
+	}
+	finalError += region.error;
+	return region.value;
+}
+
+// This function decides, after a row of the Romberg's table of a region that didn't converge,
+// if splitting it now is expected to sample fewer points than deepening. The last differences of
+// the diagonal give the observed ratio of convergence, taking the bigger of each two consecutive
+// ones since the diagonal often bounces near kinks. If the ratio is 1 or more the rows have
+// stalled. Otherwise the convergence is taken as geometric, and predicts the rows needed to meet
+// the tolerance: if they're more than MAXN, the rows left would be sampled just before splitting
+// anyway. If not, their points are compared with the ones of the 8 children: a child has an
+// eighth of the volume and of the tolerance, so with the spacing of the next row of the parent
+// it should meet it a row earlier.
+// The ratio needs 3 differences, so 4 rows(i>=3). The regions crossing the border of the domain
+// don't get here: the integrand jumps there, so their rows converge at first order at best, and
+// are equal while the lattice misses the border(the region would be taken as converged with no
+// error). They're split after their first row by rombergIntegral, down to MAXR, where the border
+// is left in small regions.
+int Integral3D::splitEarly(const IntegrationRegion &region, const double &epsilon, const int &MAXN) const{
+	int i = region.R.size()-1;
+	int rows, m;
+	double differences[3], ratio, error, deepen = 0, split;
+	if(i<3){
+		return 0;
+	}
+	for(m=0;m<3;++m){
+		const double &older = region.R[i-3+m][i-3+m], &newer = region.R[i-2+m][i-2+m];
+		// 0s are excluded as in the check of the convergence, the lattice may miss the domain
+		if(older==0 or newer==0){
+			return 0;
+		}
+		differences[m] = std::fabs(older-newer);
+	}
+	if(differences[0]==0 and differences[1]==0){
+		return 0;
+	}
+	ratio = std::max(differences[2],differences[1])/std::max(differences[1],differences[0]);
+	if(ratio>=1){
+		return 1;
+	}
+	// the rows after i, counting their points as rombergStep
+	error = differences[2];
+	for(rows=0;error>=epsilon;++rows){
+		if(i+rows>=MAXN){
+			return 1;
+		}
+		error *= ratio;
+		m = i+rows+1;
+		deepen += std::pow(std::pow(2,m)+1,3)-std::pow(std::pow(2,m-1)+1,3);
+	}
+	split = 8*std::pow(std::pow(2,i+rows-1)+1,3);
+	return split<deepen;
+}
+
+// This function integrates a region of the tree with the engine selected
+double Integral3D::regionIntegral(const Function3D &function, IntegrationRegion &region, const double &epsilon,
+									double &finalError, IntegrationContext &context, const int &MAXN,
+									const int &MAXR) const{
+	if(context.engine==ENGINE_HYBRID){
+		return hybridIntegral(function,region,epsilon,finalError,context,MAXN,MAXR);
 	}
-	return R[MAXN-1][MAXN-1];
+	return rombergIntegral(function,region,epsilon,finalError,context,MAXN,MAXR);
 }
 
+// This function integrates a region with the hybrid engine: regions outside the domain
+// are 0, regions inside are integrated with a Gauss-Legendre rule, and split only if the
+// rule doesn't meet the tolerance. Regions on the border are left to Romberg's algorithm,
+// whose children are again classified. The regions can be classified only in the space
+// coordinates, so with a transformation it's Romberg's algorithm.
+double Integral3D::hybridIntegral(const Function3D &function, IntegrationRegion &region, const double &epsilon,
+									double &finalError, IntegrationContext &context, const int &MAXN,
+									const int &MAXR) const{
+	const Parallelepiped &domain = region.domain;
+	int split_number = 8;
+	int i, position;
+	if(domain.xwidth==0 or domain.ywidth==0 or domain.zwidth==0){
+		return 0;
+	}
+	if(!region.children.empty()){
+		return integrateChildren(function,region,epsilon,finalError,context,MAXN,MAXR);
+	}
+	if(!context.transform.isIdentity()){
+		return rombergIntegral(function,region,epsilon,finalError,context,MAXN,MAXR);
+	}
+	position = function.classify(domain);
+	if(position==BOX_OUTSIDE){
+		++context.regions;
+		region.value = 0;
+		region.error = 0;
+		region.converged = 1;
+		return 0;
+	}
+	if(position==BOX_BOUNDARY){
+		return rombergIntegral(function,region,epsilon,finalError,context,MAXN,MAXR);
+	}
+	// inside of the domain
+	if(region.gaussOrder==0 and function.getHints().isConstant and !function.hasControlVariate()){
+		// exact, without evaluating
+		region.value = constantIntegral(function,domain);
+		region.error = 0;
+		region.gaussOrder = 1;
+	}else if(region.gaussOrder==0){
+		region.value = gaussIntegral(function,domain,region.error,context,region.recursion);
+		region.gaussOrder = HYBRID_GAUSS_ORDER;
+	}
+	if(region.error<epsilon or region.recursion>=MAXR){
+		++context.regions;
+		region.converged = region.error<epsilon;
+		region.depthLimited = !region.converged;
+		if(region.depthLimited){
+			context.status |= INTEGRATION_STATUS_DEPTH_LIMITED;
+		}
+		finalError += region.error;
+		return region.value;
+	}
+	// the rule doesn't meet the tolerance
+	region.children.resize(split_number);
+	std::vector<Parallelepiped> newDomains;
+	newDomains.resize(split_number);
+	splitDomain(domain,newDomains);
+	for(i=0;i<split_number;++i){
+		region.children[i] = IntegrationRegion(newDomains[i],region.recursion+1);
+	}
+	return integrateChildren(function,region,epsilon,finalError,context,MAXN,MAXR);
+}
+
+// This function integrates the children of a split region, each with its share of the
+// tolerance. The children of the root are integrated on "threads" threads, each with
+// its own context, and the values are summed in order so the result doesn't depend
+// on the number of threads.
+double Integral3D::integrateChildren(const Function3D &function, IntegrationRegion &region,
+										const double &epsilon, double &finalError, IntegrationContext &context,
+										const int &MAXN, const int &MAXR) const{
+	int split_number = region.children.size();
+	int i;
+	std::vector<double> values(split_number,0);
+	if(region.recursion!=ZERO_STATE or context.threads<=1){
+		for(i=0;i<split_number;++i){
+			values[i] = regionIntegral(function,region.children[i],epsilon/split_number,
+										finalError,context,MAXN,MAXR);
+		}
+	}else{
+		std::vector<IntegrationContext> contexts(split_number,IntegrationContext(context.transform,context.engine));
+		for(i=0;i<split_number;++i){
+			contexts[i].splitPolicy = context.splitPolicy;
+			contexts[i].trace = context.trace;
+		}
+		std::vector<double> errors(split_number,0);
+		std::vector<std::thread> workers;
+		std::atomic<int> next(0);
+		auto worker = [&](){
+			int child;
+			while((child = next++)<split_number){
+				values[child] = regionIntegral(function,region.children[child],epsilon/split_number,
+												errors[child],contexts[child],MAXN,MAXR);
+			}
+		};
+		for(i=1;i<context.threads and i<split_number;++i){
+			workers.emplace_back(worker);
+		}
+		worker();
+		for(i=0;i<(int)workers.size();++i){
+			workers[i].join();
+		}
+		for(i=0;i<split_number;++i){
+			finalError += errors[i];
+			context.status |= contexts[i].status;
+			context.evaluations += contexts[i].evaluations;
+			context.regions += contexts[i].regions;
+			contexts[i].flushTrace();
+		}
+	}
+	region.value = 0;
+	for(i=0;i<split_number;++i){
+		region.value += values[i];
+	}
+	return region.value;
+}
+
+// This function adds the next row to the Romberg's table of the region: the trapezoidal
+// integral using successive refinements, and the Richardson's extrapolations of it.
+void Integral3D::rombergStep(const Function3D &function, IntegrationRegion &region,
+								IntegrationContext &context) const{
+	int i = region.R.size();
+	int j;
+	long n, m;
+	double temp;
+	std::vector<double> row(i+1);
+	if(i==0){
+		row[0] = directionedTrapezoidIntegral(function, region.domain, 0, context, i, region.recursion); // trapezoidal integral
+		context.evaluations += 8;
+	}else{
+		const std::vector<double> &last = region.R[i-1];
+		// trapezoidal integral using successing refinements
+		n = pow(2,i)-1;
+		row[0] = last[0]/8+directionedTrapezoidIntegral(function, region.domain, n, context, i, region.recursion);
+		// only the points not on the lattice of the last row are sampled
+		m = (n+3)/2;
+		context.evaluations += (n+2)*(n+2)*(n+2)-m*m*m;
+		for(j=1;j<=i;++j){
+			temp = pow(4,j);
+			row[j] = ( temp*row[j-1]-last[j-1] )/( temp-1 ); // Richardson's extrapolation
+		}
+	}
+	region.R.push_back(row);
+}
+
+// Accumulators used by the trapezoidal sums: PlainSum is the naive summation
+// in the type T, while NeumaierSum keeps a compensation term of the rounding
+// errors, so that summing many terms doesn't lose precision.
+template<typename T>
+struct PlainSum{
+	T sum;
+	PlainSum() : sum(0){}
+	void add(const T &value){ sum += value; }
+	void scale(const T &factor){ sum *= factor; }
+	T value() const{ return sum; }
+};
+
+struct NeumaierSum{
+	double sum;
+	double compensation;
+	NeumaierSum() : sum(0), compensation(0){}
+	void add(const double &value){
+		double t = sum+value;
+		if(std::fabs(sum)>=std::fabs(value)){
+			compensation += (sum-t)+value;
+		}else{
+			compensation += (value-t)+sum;
+		}
+		sum = t;
+	}
+	void scale(const double &factor){ sum *= factor; compensation *= factor; }
+	double value() const{ return sum+compensation; }
+};
+
+// Samplers used by the trapezoidal sums, evaluating in double or single precision.
+// TransformedSampler evaluates in the point mapped by a VariableTransform, and
+// multiplies by the jacobian of the transformation.
+struct DoubleSampler{
+	const Function3D &function;
+	double operator()(const double &x, const double &y, const double &z) const{
+		return function(x,y,z);
+	}
+};
+
+struct FloatSampler{
+	const Function3D &function;
+	double operator()(const double &x, const double &y, const double &z) const{
+		return function.evaluateFloat(x,y,z);
+	}
+};
+
+// PointBatch gathers the points met by the trapezoidal sums, to evaluate the ones
+// in the domain with one call of the batch function. CollectingSampler fills it,
+// then ReplaySampler gives back the values in the same order.
+struct PointBatch{
+	std::vector<double> x, y, z, values;
+	std::vector<char> inDomain; // flag of each point met, in order
+	size_t next; // next point to replay
+	size_t nextValue; // next value to replay
+	PointBatch() : next(0), nextValue(0){}
+	void clear(){
+		x.clear(); y.clear(); z.clear(); values.clear(); inDomain.clear();
+		next = nextValue = 0;
+	}
+};
+
+struct CollectingSampler{
+	const Function3D &function;
+	PointBatch &batch;
+	double operator()(const double &x, const double &y, const double &z) const{
+		int in = function.isInDomain(x,y,z);
+		batch.inDomain.push_back(in);
+		if(in){
+			batch.x.push_back(x);
+			batch.y.push_back(y);
+			batch.z.push_back(z);
+		}
+		return 0;
+	}
+};
+
+struct ReplaySampler{
+	PointBatch &batch;
+	double operator()(const double&, const double&, const double&) const{
+		if(!batch.inDomain[batch.next++]){
+			return 0;
+		}
+		return batch.values[batch.nextValue++];
+	}
+};
+
+// TracingSampler records every point evaluated by the sampler(in the coordinates of
+// the space) in the trace of the context. It's used only when tracing.
+template<typename Sampler>
+struct TracingSampler{
+	const Sampler &sample;
+	const Function3D &function;
+	IntegrationContext &context;
+	int level;
+	int depth;
+	double operator()(const double &x, const double &y, const double &z) const{
+		double value = sample(x,y,z);
+		context.record(x,y,z,value,function.isInDomain(x,y,z),level,depth);
+		return value;
+	}
+};
+
+template<typename Sampler>
+struct TransformedSampler{
+	const Sampler &sample;
+	const VariableTransform &transform;
+	double operator()(double x, double y, double z) const{
+		double jacobian = transform.map(x,y,z);
+		if(jacobian==0){
+			// points at infinity
+			return 0;
+		}
+		return jacobian*sample(x,y,z);
+	}
+};
+
 // This function compute the trapezoidal rule on the given domain, considering
 // the refinement at n points. Being in 3 dimension an extended 3D form is used.
 // Standard trapezoidal rule is applied on "x" axis, but for every point it's applied the
 // trapezoidal rule over the "y" axis, and for every point of the "y" axis it's applied the
 // trapezoidal rule over the "z" axis, over which a standard trapezoidal rule is used.
-double Integral3D::directionedTrapezoidIntegral(const Function3D &function, const Parallelepiped &domain,
-													const int &n) const{
-	int i,j,k;
-	double hx,hy,hz,sumx,sumy,sumz,temp;
+// Sum selects the precision of the accumulation, and Sampler the evaluation.
+// trapezoidPlane is the sum over the plane of the i-th point of the "x" axis.
+template<typename Sum, typename Sampler>
+static double trapezoidPlane(const Sampler &sample, const Parallelepiped &domain, const int &n, const int &i){
+	int j,k;
+	double hx,hy,hz,temp;
 	hx = domain.xwidth/(n+1);
 	hy = domain.ywidth/(n+1);
 	hz = domain.zwidth/(n+1);
-	sumx = 0;
-	for(i=0;i<=n+1;++i){
-		sumy = 0;
-		for(j=0;j<=n+1;++j){
-			sumz = 0;
-			// if either on x, or y I end up on a new line
-			// every point is a new one
-			if(i%2==1 or j%2==1 or n==0){
-				for(k=0;k<=n+1;++k){
-					temp = function(domain.vertex.x+i*hx,domain.vertex.y+j*hy,domain.vertex.z+k*hz);
-					if(k==0 or k==n+1){
-						temp *= 0.5;
-					}
-					sumz += temp;
+	Sum sumy;
+	for(j=0;j<=n+1;++j){
+		Sum sumz;
+		// if either on x, or y I end up on a new line
+		// every point is a new one
+		if(i%2==1 or j%2==1 or n==0){
+			for(k=0;k<=n+1;++k){
+				temp = sample(domain.vertex.x+i*hx,domain.vertex.y+j*hy,domain.vertex.z+k*hz);
+				if(k==0 or k==n+1){
+					temp *= 0.5;
 				}
+				sumz.add(temp);
+			}
+		}else{
+			// case when some of the values has already been accounted for
+			for(k=1;k<=n;k+=2){
+				sumz.add(sample(domain.vertex.x+i*hx,domain.vertex.y+j*hy,domain.vertex.z+k*hz));
+			}
+		}
+		if(j==0 or j==n+1){
+			sumz.scale(0.5);
+		}
+		sumy.add(sumz.value());
+	}
+	if(i==0 or i==n+1){
+		sumy.scale(0.5);
+	}
+	return sumy.value();
+}
+
+template<typename Sum, typename Sampler>
+static double trapezoidKernel(const Sampler &sample, const Parallelepiped &domain, const int &n){
+	int i;
+	double hx = domain.xwidth/(n+1), hy = domain.ywidth/(n+1), hz = domain.zwidth/(n+1);
+	Sum sumx;
+	for(i=0;i<=n+1;++i){
+		sumx.add(trapezoidPlane<Sum>(sample,domain,n,i));
+	}
+	return hx*hy*hz*sumx.value();
+}
+
+// This function compute the trapezoidal rule with the given sampler, in the
+// coordinates of the transformation if it's not the identity
+template<typename Sum, typename Sampler>
+static double trapezoidTransformed(const Sampler &sample, const VariableTransform &transform,
+									const Parallelepiped &domain, const int &n){
+	if(transform.isIdentity()){
+		return trapezoidKernel<Sum>(sample, domain, n);
+	}
+	return trapezoidKernel<Sum>(TransformedSampler<Sampler>{sample,transform}, domain, n);
+}
+
+// This function compute the sum over a plane of the trapezoidal rule, in the coordinates
+// of the transformation if it's not the identity
+template<typename Sum, typename Sampler>
+static double planeTransformed(const Sampler &sample, const VariableTransform &transform,
+								const Parallelepiped &domain, const int &n, const int &i){
+	if(transform.isIdentity()){
+		return trapezoidPlane<Sum>(sample, domain, n, i);
+	}
+	return trapezoidPlane<Sum>(TransformedSampler<Sampler>{sample,transform}, domain, n, i);
+}
+
+// This function compute the trapezoidal rule as trapezoidTransformed, but the points of
+// consecutive planes are gathered(at least TRAPEZOID_BATCH_POINTS of them) and evaluated
+// with one call of the batch function. The sums are then done on the values in the same
+// order, so the result is the same as evaluating one point at a time(and the points are
+// recorded in the trace of the context, if there's one). A batch that couldn't be
+// evaluated sets INTEGRATION_STATUS_EVALUATION_FAILED.
+template<typename Sum>
+static double trapezoidBatched(const Function3D &function, IntegrationContext &context, const Parallelepiped &domain,
+								const int &n, const int &level, const int &depth){
+	int i, first = 0;
+	double hx = domain.xwidth/(n+1), hy = domain.ywidth/(n+1), hz = domain.zwidth/(n+1);
+	PointBatch batch;
+	Sum sumx;
+	for(i=0;i<=n+1;++i){
+		planeTransformed<Sum>(CollectingSampler{function,batch}, context.transform, domain, n, i);
+		if(batch.inDomain.size()<TRAPEZOID_BATCH_POINTS and i<n+1){
+			continue;
+		}
+		batch.values.resize(batch.x.size());
+		if(function.evaluateBatch(batch.x.data(),batch.y.data(),batch.z.data(),batch.values.data(),batch.x.size())){
+			context.status |= INTEGRATION_STATUS_EVALUATION_FAILED;
+		}
+		for(;first<=i;++first){
+			if(context.trace==nullptr){
+				sumx.add(planeTransformed<Sum>(ReplaySampler{batch}, context.transform, domain, n, first));
 			}else{
-				// case when some of the values has already been accounted for
-				for(k=1;k<=n;k+=2){
-					sumz += function(domain.vertex.x+i*hx,domain.vertex.y+j*hy,domain.vertex.z+k*hz);
-				}
+				sumx.add(planeTransformed<Sum>(TracingSampler<ReplaySampler>{ReplaySampler{batch},function,context,
+																			level,depth},
+												context.transform, domain, n, first));
+			}
+		}
+		batch.clear();
+	}
+	return hx*hy*hz*sumx.value();
+}
+
+// This function compute the trapezoidal rule with the given sampler, recording every
+// point in the trace of the context if there's one. The choice is made once per call,
+// so without trace the kernel is the same as without this function.
+template<typename Sum, typename Sampler>
+static double trapezoidTraced(const Sampler &sample, const Function3D &function, IntegrationContext &context,
+								const Parallelepiped &domain, const int &n, const int &level, const int &depth){
+	if(context.trace==nullptr){
+		return trapezoidTransformed<Sum>(sample, context.transform, domain, n);
+	}
+	return trapezoidTransformed<Sum>(TracingSampler<Sampler>{sample,function,context,level,depth},
+										context.transform, domain, n);
+}
+
+// This function compute the trapezoidal rule on the given domain, considering
+// the refinement at n points, with the precision mode selected. Level and depth
+// are the row of the Romberg's table and the recursion of the region, for the trace.
+// Functions evaluating many points at once(batch function, or a source running in
+// other processes) are given the points in batches. A source has no single precision
+// version, so it's given batches in that mode too.
+double Integral3D::directionedTrapezoidIntegral(const Function3D &function, const Parallelepiped &domain,
+													const int &n, IntegrationContext &context, const int &level,
+													const int &depth) const{
+	if(function.hasBatch() and (precisionMode!=PRECISION_MODE_FLOAT or function.getSource()!=nullptr)){
+		switch(precisionMode){
+			case PRECISION_MODE_COMPENSATED:
+				return trapezoidBatched<NeumaierSum>(function, context, domain, n, level, depth);
+			case PRECISION_MODE_LONG_DOUBLE:
+				return trapezoidBatched<PlainSum<long double>>(function, context, domain, n, level, depth);
+			default:
+				return trapezoidBatched<PlainSum<double>>(function, context, domain, n, level, depth);
+		}
+	}
+	switch(precisionMode){
+		case PRECISION_MODE_COMPENSATED:
+			return trapezoidTraced<NeumaierSum>(DoubleSampler{function}, function, context, domain, n, level, depth);
+		case PRECISION_MODE_FLOAT:
+			return trapezoidTraced<PlainSum<double>>(FloatSampler{function}, function, context, domain, n, level,
+														depth);
+		case PRECISION_MODE_LONG_DOUBLE:
+			return trapezoidTraced<PlainSum<long double>>(DoubleSampler{function}, function, context, domain, n,
+															level, depth);
+		default:
+			return trapezoidTraced<PlainSum<double>>(DoubleSampler{function}, function, context, domain, n, level,
+														depth);
+	}
+}
+
+// Gauss-Legendre rules of the hybrid engine, computed by the compiler
+static constexpr GaussLegendreRule<HYBRID_GAUSS_ORDER> gaussRule;
+static constexpr GaussLegendreRule<HYBRID_GAUSS_CHECK_ORDER> gaussCheckRule;
+
+// This function compute the tensor product of the N points Gauss-Legendre rule
+// on the given domain, with the accumulation and the evaluation given
+template<typename Sum, int N, typename Sampler>
+static double gaussKernel(const Sampler &sample, const GaussLegendreRule<N> &rule, const Parallelepiped &domain){
+	int i,j,k;
+	double x,y;
+	double cx = domain.vertex.x+domain.xwidth/2;
+	double cy = domain.vertex.y+domain.ywidth/2;
+	double cz = domain.vertex.z+domain.zwidth/2;
+	Sum sumx;
+	for(i=0;i<N;++i){
+		x = cx+rule.nodes[i]*domain.xwidth/2;
+		Sum sumy;
+		for(j=0;j<N;++j){
+			y = cy+rule.nodes[j]*domain.ywidth/2;
+			Sum sumz;
+			for(k=0;k<N;++k){
+				sumz.add(rule.weights[k]*sample(x,y,cz+rule.nodes[k]*domain.zwidth/2));
 			}
-			if(j==0 or j==n+1){
-				sumz *= 0.5;
+			sumy.add(rule.weights[j]*sumz.value());
+		}
+		sumx.add(rule.weights[i]*sumy.value());
+	}
+	// the rule is on [-1,1]
+	return sumx.value()*domain.xwidth*domain.ywidth*domain.zwidth/8;
+}
+
+// This function compute the Gauss-Legendre rule of order HYBRID_GAUSS_ORDER, and
+// stores in error the difference with the one of order HYBRID_GAUSS_CHECK_ORDER
+template<typename Sum, typename Sampler>
+static double gaussPair(const Sampler &sample, const Parallelepiped &domain, double &error){
+	double value = gaussKernel<Sum>(sample,gaussRule,domain);
+	error = std::fabs(value-gaussKernel<Sum>(sample,gaussCheckRule,domain));
+	return value;
+}
+
+// This function compute the pair of Gauss-Legendre rules, recording every point in the
+// trace of the context if there's one
+template<typename Sum, typename Sampler>
+static double gaussTraced(const Sampler &sample, const Function3D &function, IntegrationContext &context,
+							const Parallelepiped &domain, double &error, const int &depth){
+	if(context.trace==nullptr){
+		return gaussPair<Sum>(sample, domain, error);
+	}
+	return gaussPair<Sum>(TracingSampler<Sampler>{sample,function,context,TRACE_LEVEL_GAUSS,depth}, domain, error);
+}
+
+// This function compute the tensor product of the N points Gauss-Legendre rule on a
+// domain inside the domain of the function, evaluating all points with one call(and
+// recording them in the trace of the context, if there's one). A batch that couldn't
+// be evaluated sets INTEGRATION_STATUS_EVALUATION_FAILED.
+template<int N>
+static double gaussBatch(const Function3D &function, const GaussLegendreRule<N> &rule,
+							const Parallelepiped &domain, IntegrationContext &context, const int &depth){
+	const int size = N*N*N;
+	double x[size], y[size], z[size], values[size];
+	int i,j,k,point;
+	double sum = 0;
+	for(i=0,point=0;i<N;++i){
+		for(j=0;j<N;++j){
+			for(k=0;k<N;++k,++point){
+				x[point] = domain.vertex.x+(rule.nodes[i]+1)*domain.xwidth/2;
+				y[point] = domain.vertex.y+(rule.nodes[j]+1)*domain.ywidth/2;
+				z[point] = domain.vertex.z+(rule.nodes[k]+1)*domain.zwidth/2;
 			}
-			sumy += sumz;
 		}
-		if(i==0 or i==n+1){
-			sumy *= 0.5;
+	}
+	if(function.evaluateBatch(x,y,z,values,size)){
+		context.status |= INTEGRATION_STATUS_EVALUATION_FAILED;
+	}
+	for(i=0,point=0;i<N;++i){
+		for(j=0;j<N;++j){
+			for(k=0;k<N;++k,++point){
+				sum += rule.weights[i]*rule.weights[j]*rule.weights[k]*values[point];
+				if(context.trace!=nullptr){
+					context.record(x[point],y[point],z[point],values[point],1,TRACE_LEVEL_GAUSS,depth);
+				}
+			}
 		}
-		sumx += sumy;
 	}
-	return hx*hy*hz*sumx;
+	return sum*domain.xwidth*domain.ywidth*domain.zwidth/8;
+}
+
+// This function compute the Gauss-Legendre rule on a domain, with the precision mode
+// selected(or the batch function if given, as in directionedTrapezoidIntegral), and counts
+// the points sampled by both rules. Depth is the recursion of the region, for the trace.
+double Integral3D::gaussIntegral(const Function3D &function, const Parallelepiped &domain, double &error,
+									IntegrationContext &context, const int &depth) const{
+	context.evaluations += HYBRID_GAUSS_ORDER*HYBRID_GAUSS_ORDER*HYBRID_GAUSS_ORDER
+							+HYBRID_GAUSS_CHECK_ORDER*HYBRID_GAUSS_CHECK_ORDER*HYBRID_GAUSS_CHECK_ORDER;
+	if(function.hasBatch() and (precisionMode!=PRECISION_MODE_FLOAT or function.getSource()!=nullptr)){
+		double value = gaussBatch(function,gaussRule,domain,context,depth);
+		error = std::fabs(value-gaussBatch(function,gaussCheckRule,domain,context,depth));
+		return value;
+	}
+	switch(precisionMode){
+		case PRECISION_MODE_COMPENSATED:
+			return gaussTraced<NeumaierSum>(DoubleSampler{function}, function, context, domain, error, depth);
+		case PRECISION_MODE_FLOAT:
+			return gaussTraced<PlainSum<double>>(FloatSampler{function}, function, context, domain, error, depth);
+		case PRECISION_MODE_LONG_DOUBLE:
+			return gaussTraced<PlainSum<long double>>(DoubleSampler{function}, function, context, domain, error,
+														depth);
+		default:
+			return gaussTraced<PlainSum<double>>(DoubleSampler{function}, function, context, domain, error, depth);
+	}
+}
+
+// This function returns the integral of a constant function on a domain inside its domain
+double Integral3D::constantIntegral(const Function3D &function, const Parallelepiped &domain) const{
+	return function.getHints().constant*domain.xwidth*domain.ywidth*domain.zwidth;
 }
 
 // functions related to the domain management:
 
-// function that given a Functinon3D, extrapolates from the two inequalities
+// function that given a Functinon3D, extrapolates from the inequalities
 // the minimum rectangular domain that contains the intersection of the
-// two inequalities
-Parallelepiped Integral3D::rectanglifyDomain(const Function3D &function) const{
+// inequalities
+// If a transformation is given, infinite sides are not cut, but mapped to a finite
+// interval by setting the transformation of that axis.
+Parallelepiped Integral3D::rectanglifyDomain(const Function3D &function, VariableTransform *_transform) const{
 	double xMin,yMin,zMin,xMax,yMax,zMax;
 	xMin = yMin = zMin = -COORDINATE_INFINITY;
 	xMax = yMax = zMax = COORDINATE_INFINITY;
 
-	// analyzing first inequality
-	applyInequality(function.getInequality(1),xMin,xMax,yMin,yMax,zMin,zMax);
-	// analyzing second inequality
-	applyInequality(function.getInequality(2),xMin,xMax,yMin,yMax,zMin,zMax);
+	int i;
+	// analyzing each inequality
+	for(i=1;i<=function.getInequalityCount();++i){
+		applyInequality(function.getInequality(i),xMin,xMax,yMin,yMax,zMin,zMax);
+	}
+	// the box declared by the provider of the function can only shrink the range
+	const FunctionHints &hints = function.getHints();
+	if(hints.hasBoundingBox){
+		const Parallelepiped &box = hints.boundingBox;
+		xMin = std::max(xMin,box.vertex.x);
+		xMax = std::max(xMin,std::min(xMax,box.vertex.x+box.xwidth));
+		yMin = std::max(yMin,box.vertex.y);
+		yMax = std::max(yMin,std::min(yMax,box.vertex.y+box.ywidth));
+		zMin = std::max(zMin,box.vertex.z);
+		zMax = std::max(zMin,std::min(zMax,box.vertex.z+box.zwidth));
+	}
+	if(_transform!=nullptr){
+		*_transform = VariableTransform();
+		transformAxis(xMin,xMax,0,*_transform);
+		transformAxis(yMin,yMax,1,*_transform);
+		transformAxis(zMin,zMax,2,*_transform);
+	}
 	makeDomainFinite(xMin,xMax,yMin,yMax,zMin,zMax);
 	return Parallelepiped(Point3D(xMin,yMin,zMin),xMax-xMin,yMax-yMin,zMax-zMin);
 }
 
+// function that builds the box integrated and its transformation: the spherical coordinates
+// of an ellipsoid of the domain if they're chosen(and the number of its inequality is given,
+// 0 otherwise), or the box given by rectanglifyDomain, tightened when it's in the space
+Parallelepiped Integral3D::integrationBox(const Function3D &function, VariableTransform &transform,
+											IntegrationStats &boxStats, int &ellipsoid) const{
+	Parallelepiped box;
+	transform = VariableTransform();
+	ellipsoid = 0;
+	if(coordinates==COORDINATES_ELLIPSOIDAL){
+		ellipsoid = ellipsoidalDomain(function,box,transform);
+		if(ellipsoid>0){
+			return box;
+		}
+	}
+	if(unboundedMode==UNBOUNDED_MODE_TRANSFORM){
+		box = rectanglifyDomain(function,&transform);
+	}else{
+		box = rectanglifyDomain(function);
+	}
+	// the parts of the box can be classified only in the space coordinates
+	if(tightBounding and transform.isIdentity()){
+		box = tightenDomain(function,box,boxStats);
+	}
+	return box;
+}
+
+// function that looks for the inequalities whose inside is an ellipsoid, and maps the
+// smallest one from the box of spherical coordinates [0,1]x[0,pi]x[0,2pi]. The other
+// inequalities cut the ellipsoid as usual. It returns the number of the inequality
+// mapped, 0 if there's none.
+int Integral3D::ellipsoidalDomain(const Function3D &function, Parallelepiped &box,
+									VariableTransform &transform) const{
+	const double pi = 3.14159265358979323846;
+	double center[3], semiaxes[3], volume, smallest = std::numeric_limits<double>::infinity();
+	int i, ellipsoid = 0;
+	for(i=1;i<=function.getInequalityCount();++i){
+		if(!function.getInequality(i).isEllipsoid(center,semiaxes)){
+			continue;
+		}
+		volume = semiaxes[0]*semiaxes[1]*semiaxes[2];
+		if(volume<smallest){
+			smallest = volume;
+			ellipsoid = i;
+			transform.setEllipsoid(center,semiaxes);
+		}
+	}
+	if(ellipsoid>0){
+		box = Parallelepiped(Point3D(0,0,0),1,pi,2*pi);
+	}
+	return ellipsoid;
+}
+
+// function that, if the range of an axis is infinite, sets the transformation that
+// maps a finite interval onto it, and replaces the range with that interval
+void Integral3D::transformAxis(double &min, double &max, const int &axis, VariableTransform &_transform) const{
+	if(min==-COORDINATE_INFINITY and max==COORDINATE_INFINITY){
+		_transform.setAxis(axis,TRANSFORM_BOTH);
+		min = -1;
+		max = 1;
+	}else if(max==COORDINATE_INFINITY){
+		_transform.setAxis(axis,TRANSFORM_UPPER,min);
+		min = 0;
+		max = 1;
+	}else if(min==-COORDINATE_INFINITY){
+		_transform.setAxis(axis,TRANSFORM_LOWER,max);
+		min = -1;
+		max = 0;
+	}
+}
+
+// function that tightens the box containing the domain, using all inequalities
+// together. rectanglifyDomain looks at each inequality alone, so the intersection
+// of the domains can be much smaller than the box it returns. Here the box is
+// bisected, and the parts proven to be outside of at least one inequality are
+// discarded. The result is the smallest box containing the remaining parts.
+// The volumes of the parts proven inside and on the border also give the fill ratio.
+Parallelepiped Integral3D::tightenDomain(const Function3D &function, const Parallelepiped &domain,
+											IntegrationStats &_stats) const{
+	// hull of the remaining parts: xMin,xMax,yMin,yMax,zMin,zMax
+	double hull[6] = {COORDINATE_INFINITY,-COORDINATE_INFINITY,COORDINATE_INFINITY,
+						-COORDINATE_INFINITY,COORDINATE_INFINITY,-COORDINATE_INFINITY};
+	double inside = 0, boundary = 0;
+	double volume;
+	_stats = IntegrationStats();
+	if(domain.xwidth==0 or domain.ywidth==0 or domain.zwidth==0){
+		return domain;
+	}
+	tightenStep(function,domain,ZERO_STATE,hull,inside,boundary);
+	if(hull[0]>hull[1]){
+		// every part has been discarded, the domain is empty
+		return Parallelepiped(domain.vertex,0,0,0);
+	}
+	Parallelepiped tight(Point3D(hull[0],hull[2],hull[4]),hull[1]-hull[0],hull[3]-hull[2],hull[5]-hull[4]);
+	volume = tight.xwidth*tight.ywidth*tight.zwidth;
+	_stats.boxVolume = volume;
+	_stats.fillRatioMin = inside/volume;
+	_stats.fillRatioMax = (inside+boundary)/volume;
+	// parts on the border are counted as half full
+	_stats.fillRatio = (inside+boundary/2)/volume;
+	return tight;
+}
+
+// function that classifies a part of the box, and if it's on the border of the domain
+// bisects it further(up to TIGHTEN_DEPTH times). Parts not discarded extend the hull,
+// and their volume is added to the one inside or on the border.
+void Integral3D::tightenStep(const Function3D &function, const Parallelepiped &domain, const int &depth,
+								double hull[6], double &inside, double &boundary) const{
+	int position = function.classify(domain);
+	double volume = domain.xwidth*domain.ywidth*domain.zwidth;
+	unsigned int i;
+	if(position==BOX_OUTSIDE){
+		return;
+	}
+	if(position==BOX_BOUNDARY and depth<TIGHTEN_DEPTH){
+		std::vector<Parallelepiped> newDomains(8);
+		splitDomain(domain,newDomains);
+		for(i=0;i<newDomains.size();++i){
+			tightenStep(function,newDomains[i],depth+1,hull,inside,boundary);
+		}
+		return;
+	}
+	if(position==BOX_INSIDE){
+		inside += volume;
+	}else{
+		boundary += volume;
+	}
+	hull[0] = std::min(hull[0],domain.vertex.x);
+	hull[1] = std::max(hull[1],domain.vertex.x+domain.xwidth);
+	hull[2] = std::min(hull[2],domain.vertex.y);
+	hull[3] = std::max(hull[3],domain.vertex.y+domain.ywidth);
+	hull[4] = std::min(hull[4],domain.vertex.z);
+	hull[5] = std::max(hull[5],domain.vertex.z+domain.zwidth);
+}
+
+// function that checks if the domain is symmetric with respect to the plane
+// axis=0, which happens if no inequality has the linear term of that axis
+// and the box is centered in 0
+int Integral3D::isSymmetric(const Function3D &function, const Parallelepiped &domain,
+								const std::string &axis) const{
+	int i;
+	double min, width;
+	for(i=1;i<=function.getInequalityCount();++i){
+		if(function.getInequality(i)[axis]!=0){
+			return 0;
+		}
+	}
+	if(axis=="x"){
+		min = domain.vertex.x;
+		width = domain.xwidth;
+	}else if(axis=="y"){
+		min = domain.vertex.y;
+		width = domain.ywidth;
+	}else{
+		min = domain.vertex.z;
+		width = domain.zwidth;
+	}
+	return std::fabs(2*min+width)<=SYMMETRY_TOLERANCE*width;
+}
+
+// function that reduces the box to the part that must be integrated, using the
+// parity declared for the function on the axes where the domain is symmetric:
+// for even parity only the positive half is kept, for odd parity the integral is 0.
+// The value returned is the factor that multiplies the integral on the reduced box,
+// and the axes halved are flagged in "reduced" if given.
+double Integral3D::symmetryReduction(const Function3D &function, Parallelepiped &domain, int *reduced) const{
+	double factor = 1;
+	int parity;
+	// the parity is declared for f, the control variate may not have it
+	if(function.hasControlVariate()){
+		return factor;
+	}
+	parity = function.getParity("x");
+	if(parity!=PARITY_NONE and isSymmetric(function,domain,"x")){
+		if(parity==PARITY_ODD){
+			return 0;
+		}
+		domain.xwidth /= 2;
+		domain.vertex.x = 0;
+		factor *= 2;
+		if(reduced!=nullptr){
+			reduced[0] = 1;
+		}
+	}
+	parity = function.getParity("y");
+	if(parity!=PARITY_NONE and isSymmetric(function,domain,"y")){
+		if(parity==PARITY_ODD){
+			return 0;
+		}
+		domain.ywidth /= 2;
+		domain.vertex.y = 0;
+		factor *= 2;
+		if(reduced!=nullptr){
+			reduced[1] = 1;
+		}
+	}
+	parity = function.getParity("z");
+	if(parity!=PARITY_NONE and isSymmetric(function,domain,"z")){
+		if(parity==PARITY_ODD){
+			return 0;
+		}
+		domain.zwidth /= 2;
+		domain.vertex.z = 0;
+		factor *= 2;
+		if(reduced!=nullptr){
+			reduced[2] = 1;
+		}
+	}
+	return factor;
+}
+
+// function that computes the multiplier of the control variate g minimizing the variance of
+// f-scale*g over a coarse lattice of the domain, cov(f,g)/var(g), as in Monte Carlo methods.
+// The values are taken with the jacobian, as the engines integrate them in the box. The points
+// in the domain are evaluated with one call of the batch function.
+double Integral3D::controlScale(const Function3D &function, const Parallelepiped &domain,
+								const VariableTransform &_transform) const{
+	int i,j,k;
+	int n = CONTROL_SAMPLES;
+	size_t p;
+	long count = 0;
+	double x,y,z,u,v,w,jacobian,f,g;
+	double sumF = 0, sumG = 0, sumFG = 0, sumGG = 0, covariance, variance;
+	std::vector<double> xs, ys, zs, jacobians, values;
+	Function3D plain(function);
+	doubleFunction3D control = function.getControl();
+	plain.setControlVariate(nullptr,0);
+	for(i=0;i<n;++i){
+		x = domain.vertex.x+(i+0.5)*domain.xwidth/n;
+		for(j=0;j<n;++j){
+			y = domain.vertex.y+(j+0.5)*domain.ywidth/n;
+			for(k=0;k<n;++k){
+				z = domain.vertex.z+(k+0.5)*domain.zwidth/n;
+				u = x;
+				v = y;
+				w = z;
+				jacobian = _transform.map(u,v,w);
+				if(jacobian==0 or !plain.isInDomain(u,v,w)){
+					continue;
+				}
+				xs.push_back(u);
+				ys.push_back(v);
+				zs.push_back(w);
+				jacobians.push_back(jacobian);
+			}
+		}
+	}
+	values.resize(xs.size());
+	// values not computed are NaN, and skipped below
+	plain.evaluateBatch(xs.data(),ys.data(),zs.data(),values.data(),values.size());
+	for(p=0;p<values.size();++p){
+		f = jacobians[p]*values[p];
+		g = jacobians[p]*control(xs[p],ys[p],zs[p]);
+		if(!std::isfinite(f) or !std::isfinite(g)){
+			continue;
+		}
+		sumF += f;
+		sumG += g;
+		sumFG += f*g;
+		sumGG += g*g;
+		++count;
+	}
+	if(count<2){
+		return function.getControlScale();
+	}
+	covariance = sumFG-sumF*sumG/count;
+	variance = sumGG-sumG*sumG/count;
+	// g constant over the domain can't follow f, any multiplier gives the same residual
+	if(!(variance>0)){
+		return function.getControlScale();
+	}
+	return covariance/variance;
+}
+
+// function that measures how many points of a coarse lattice over the domain each
+// inequality rejects, and returns the order of the inequalities from the one
+// rejecting the most to the one rejecting the least
+std::vector<unsigned int> Integral3D::selectivityOrder(const Function3D &function,
+														const Parallelepiped &domain,
+														const VariableTransform &_transform) const{
+	int i,j,k;
+	unsigned int l;
+	int n = SELECTIVITY_SAMPLES;
+	double x,y,z,u,v,w;
+	std::vector<long> rejected(function.getInequalityCount(),0);
+	std::vector<unsigned int> order(rejected.size());
+	for(i=0;i<n;++i){
+		x = domain.vertex.x+(i+0.5)*domain.xwidth/n;
+		for(j=0;j<n;++j){
+			y = domain.vertex.y+(j+0.5)*domain.ywidth/n;
+			for(k=0;k<n;++k){
+				z = domain.vertex.z+(k+0.5)*domain.zwidth/n;
+				// points are sampled in the box, and then mapped in the space
+				u = x;
+				v = y;
+				w = z;
+				_transform.map(u,v,w);
+				for(l=0;l<rejected.size();++l){
+					if(function.getInequality(l+1)(u,v,w)!=1){
+						++rejected[l];
+					}
+				}
+			}
+		}
+	}
+	for(l=0;l<order.size();++l){
+		order[l] = l;
+	}
+	std::stable_sort(order.begin(),order.end(),[&rejected](const unsigned int &a, const unsigned int &b){
+		return rejected[a]>rejected[b];
+	});
+	return order;
+}
+
 // function that extrapolate the ranges of an inequality for each coordinate, and intersects
 // it with the (xMin,xMax),... ranges given
 void Integral3D::applyInequality(const Inequality &inequality, double &xMin, double &xMax,
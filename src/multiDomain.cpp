@@ -0,0 +1,201 @@
+#include "../include/multiDomain.h"
+
+//===================== MultiDomain Class =====================//
+// constructor that builds the Function3D of each domain from its inequalities
+MultiDomain::MultiDomain(const Function3D &_function, const std::vector<std::pair<Inequality,Inequality>> &_domains)
+							: function(_function){
+	size_t i;
+	// the known integral of a control variate is for one domain only
+	function.setControlVariate(nullptr,0);
+	for(i=0;i<_domains.size();++i){
+		domains.push_back(Function3D(_domains[i].first,_domains[i].second,function.getFunction()));
+	}
+	values.assign(domains.size(),0);
+	errors.assign(domains.size(),0);
+}
+
+// empty destructor
+MultiDomain::~MultiDomain(){
+}
+
+// function that returns the Function3D of a domain
+const Function3D& MultiDomain::getDomain(const size_t &domain) const{
+	return domains[domain];
+}
+
+// function that integrates over the box, starting with every domain reaching it
+void MultiDomain::integrate(const Parallelepiped &box, const double &epsilon, const int &MAXN,
+							const int &MAXR, MultiDomainResult &result){
+	std::vector<size_t> reaching(domains.size());
+	std::vector<char> inside(domains.size(),0);
+	size_t i;
+	for(i=0;i<domains.size();++i){
+		reaching[i] = i;
+	}
+	region(box,reaching,inside,epsilon,ZERO_STATE,MAXN,MAXR,result);
+	result.values = values;
+	result.errors = errors;
+}
+
+// function that integrates a region. The domains reaching the parent are classified again,
+// the ones outside the region are dropped and the ones with the region all inside don't test
+// its points. Finer grids are computed until the difference of the last two meets the tolerance
+// for every domain left, then the region is split as in Romberg's algorithm.
+void MultiDomain::region(const Parallelepiped &domain, const std::vector<size_t> &parentReaching,
+							const std::vector<char> &parentInside, const double &epsilon, const int &recursion,
+							const int &MAXN, const int &MAXR, MultiDomainResult &result){
+	double whole = 0, previousWhole = 0, error;
+	size_t i;
+	int level, position;
+	std::vector<size_t> reaching;
+	std::vector<char> inside;
+	std::vector<double> cut, previousCut;
+	if(domain.xwidth==0 or domain.ywidth==0 or domain.zwidth==0 or MAXN==0){
+		return;
+	}
+	++result.regions;
+	for(i=0;i<parentReaching.size();++i){
+		position = parentInside[i] ? BOX_INSIDE : domains[parentReaching[i]].classify(domain);
+		if(position==BOX_OUTSIDE){
+			continue;
+		}
+		reaching.push_back(parentReaching[i]);
+		inside.push_back(position==BOX_INSIDE);
+	}
+	// outside of every domain
+	if(reaching.empty()){
+		return;
+	}
+
+	DomainLevel previous, current;
+	previous.intervals = current.intervals = 0;
+	for(level=0;level<MAXN;++level){
+		current.intervals = 1<<level;
+		sample(domain,reaching,inside,previous,current,result);
+		whole = sums(domain,current,reaching.size(),cut);
+		if(level>0){
+			error = 0;
+			for(i=0;i<cut.size();++i){
+				error = std::max(error,std::fabs(cut[i]-previousCut[i]));
+			}
+			// 0s are excluded as in Romberg's algorithm, the grid may miss the domains
+			if(error<epsilon and whole!=0 and previousWhole!=0){
+				break;
+			}
+		}
+		std::swap(previous,current);
+		std::swap(previousWhole,whole);
+		std::swap(previousCut,cut);
+	}
+	if(level==MAXN){
+		if(recursion<MAXR){
+			--result.regions; // it's not a leaf anymore
+			double halfx = domain.xwidth/2, halfy = domain.ywidth/2, halfz = domain.zwidth/2;
+			for(i=0;i<8;++i){
+				Point3D vertex(domain.vertex.x+(i&1)*halfx,domain.vertex.y+((i>>1)&1)*halfy,
+								domain.vertex.z+((i>>2)&1)*halfz);
+				region(Parallelepiped(vertex,halfx,halfy,halfz),reaching,inside,epsilon/8,recursion+1,MAXN,MAXR,
+						result);
+			}
+			return;
+		}
+		// both MAXN and MAXR are reached, the last grid is the "best" value obtained
+		std::swap(previous,current);
+		std::swap(previousWhole,whole);
+		std::swap(previousCut,cut);
+		if(whole!=0){
+			result.status |= INTEGRATION_STATUS_DEPTH_LIMITED;
+		}
+	}
+	for(i=0;i<cut.size();++i){
+		values[reaching[i]] += cut[i];
+		errors[reaching[i]] += MAXN>1 ? std::fabs(cut[i]-previousCut[i]) : 0;
+	}
+}
+
+// function that computes the grid of a level: the points of the previous level(the ones
+// with even indices) are copied, the others are tested against each domain reaching the
+// region and the function is evaluated, with one batch, on the ones inside some of them
+void MultiDomain::sample(const Parallelepiped &domain, const std::vector<size_t> &reaching,
+							const std::vector<char> &inside, const DomainLevel &previous, DomainLevel &current,
+							MultiDomainResult &result) const{
+	int n = current.intervals+1, m = previous.intervals+1;
+	int i, j, k, index, old, any;
+	size_t d, count = reaching.size();
+	double x, y, z;
+	std::vector<double> xs, ys, zs, batch;
+	std::vector<int> indices;
+	current.inside.assign(n*n*n*count,0);
+	current.values.assign(n*n*n,0);
+	for(k=0;k<n;++k){
+		z = domain.vertex.z+domain.zwidth*k/current.intervals;
+		for(j=0;j<n;++j){
+			y = domain.vertex.y+domain.ywidth*j/current.intervals;
+			for(i=0;i<n;++i){
+				index = i+n*(j+n*k);
+				if(current.intervals>1 and i%2==0 and j%2==0 and k%2==0){
+					old = i/2+m*(j/2+m*(k/2));
+					std::copy(previous.inside.begin()+old*count,previous.inside.begin()+(old+1)*count,
+								current.inside.begin()+index*count);
+					current.values[index] = previous.values[old];
+					continue;
+				}
+				x = domain.vertex.x+domain.xwidth*i/current.intervals;
+				any = 0;
+				for(d=0;d<count;++d){
+					current.inside[index*count+d] = inside[d] or domains[reaching[d]].isInDomain(x,y,z);
+					any |= current.inside[index*count+d];
+				}
+				if(any){
+					xs.push_back(x);
+					ys.push_back(y);
+					zs.push_back(z);
+					indices.push_back(index);
+				}
+			}
+		}
+	}
+	batch.resize(xs.size());
+	if(function.evaluateBatch(xs.data(),ys.data(),zs.data(),batch.data(),batch.size())){
+		result.status |= INTEGRATION_STATUS_EVALUATION_FAILED;
+	}
+	for(i=0;i<(int)batch.size();++i){
+		current.values[indices[i]] = batch[i];
+	}
+	result.evaluations += batch.size();
+}
+
+// function that computes the trapezoidal rule of a grid over the part of the region in
+// some domain, and over each domain reaching the region
+double MultiDomain::sums(const Parallelepiped &domain, const DomainLevel &grid, const size_t &count,
+							std::vector<double> &cut) const{
+	int n = grid.intervals+1;
+	int i, j, k, index;
+	double weight, volume, whole = 0;
+	size_t d;
+	volume = domain.xwidth*domain.ywidth*domain.zwidth/((double)grid.intervals*grid.intervals*grid.intervals);
+	cut.assign(count,0);
+	for(k=0;k<n;++k){
+		for(j=0;j<n;++j){
+			for(i=0;i<n;++i){
+				index = i+n*(j+n*k);
+				// 0 outside every domain
+				if(grid.values[index]==0){
+					continue;
+				}
+				weight = (i==0 or i==n-1 ? 0.5 : 1)*(j==0 or j==n-1 ? 0.5 : 1)*(k==0 or k==n-1 ? 0.5 : 1);
+				weight *= grid.values[index];
+				whole += weight;
+				for(d=0;d<count;++d){
+					if(grid.inside[index*count+d]){
+						cut[d] += weight;
+					}
+				}
+			}
+		}
+	}
+	for(d=0;d<count;++d){
+		cut[d] *= volume;
+	}
+	return volume*whole;
+}
@@ -0,0 +1,181 @@
+#include "../include/sensitivity.h"
+
+//===================== BoundarySensitivity Class =====================//
+static constexpr GaussLegendreRule<SENSITIVITY_GAUSS_ORDER> sensitivityRule;
+
+// function that computes the smoothed delta on [0,1]: its integral is 1 and its first
+// moment 0, so the error is of the second order in the width, and it's 0 at both ends,
+// so the integrand stays continuous on the border
+static double kernel(const double &t){
+	const double pi = 3.14159265358979323846;
+	if(t<=0 or t>=1){
+		return 0;
+	}
+	return pi/2*std::sin(pi*t)+pi*std::sin(2*pi*t);
+}
+
+// function that checks if the range of the left side of an inequality(given its sign)
+// meets the values covered by the smoothed delta, (0,band)
+static int meetsBand(const double &low, const double &high, const int &sign, const double &band){
+	double min = sign>0 ? low : -high;
+	double max = sign>0 ? high : -low;
+	return max>0 and min<band;
+}
+
+// constructor that collects the leaves of the region tree
+BoundarySensitivity::BoundarySensitivity(const Function3D &_function, const IntegrationRegion &root,
+											const double &_factor, const int _reduced[3])
+											: function(_function), factor(_factor){
+	reduced[0] = _reduced[0];
+	reduced[1] = _reduced[1];
+	reduced[2] = _reduced[2];
+	// the known integral of a control variate is for the domain given, so the border
+	// moves with f itself
+	function.setControlVariate(nullptr,0);
+	collect(root);
+}
+
+// empty destructor
+BoundarySensitivity::~BoundarySensitivity(){
+}
+
+// function that collects the leaves of the region tree
+void BoundarySensitivity::collect(const IntegrationRegion &region){
+	if(region.children.empty()){
+		leaves.push_back(region.domain);
+		return;
+	}
+	for(const IntegrationRegion &child : region.children){
+		collect(child);
+	}
+}
+
+// function that computes the derivatives for every inequality
+int BoundarySensitivity::compute(std::vector<std::vector<double>> &gradient,
+									std::vector<std::vector<double>> &errors, long &evaluations) const{
+	int i, failed = 0;
+	gradient.resize(function.getInequalityCount());
+	errors.resize(function.getInequalityCount());
+	for(i=0;i<function.getInequalityCount();++i){
+		failed |= compute(i+1,gradient[i],errors[i],evaluations);
+	}
+	return failed;
+}
+
+// function that computes the derivatives for the n-th inequality. The leaves crossing its
+// border give the width of the delta, h times the mean gradient of the left side g(so that
+// sign*g/norm is about the distance from the border). The leaves meeting the band covered by
+// the delta are split in cells of side h, integrated with the Gauss-Legendre rule.
+int BoundarySensitivity::compute(const int &n, std::vector<double> &gradient, std::vector<double> &errors,
+									long &evaluations) const{
+	const Inequality &inequality = function.getInequality(n);
+	int sign = inequality.getDisequality()[0]=='<' ? -1 : 1;
+	double A = inequality["x^2"], a = inequality["x"];
+	double B = inequality["y^2"], b = inequality["y"];
+	double C = inequality["z^2"], c = inequality["z"];
+	double side = std::numeric_limits<double>::infinity(), norm = 0, h, band;
+	double x, y, z, low, high, gx, gy, gz;
+	long crossing = 0;
+	int cells[3], i, j, k, p, q, r, m, failed = 0;
+	size_t point;
+	std::vector<double> fine(SENSITIVITY_COEFFICIENTS,0), coarse(SENSITIVITY_COEFFICIENTS,0);
+	std::vector<double> xs, ys, zs, weights, ts, values;
+	gradient.assign(SENSITIVITY_COEFFICIENTS,0);
+	errors.assign(SENSITIVITY_COEFFICIENTS,0);
+	for(const Parallelepiped &leaf : leaves){
+		if(inequality.classify(leaf)!=BOX_BOUNDARY or function.classify(leaf)==BOX_OUTSIDE){
+			continue;
+		}
+		side = std::min(side,std::min(leaf.xwidth,std::min(leaf.ywidth,leaf.zwidth)));
+		gx = 2*A*(leaf.vertex.x+leaf.xwidth/2)+a;
+		gy = 2*B*(leaf.vertex.y+leaf.ywidth/2)+b;
+		gz = 2*C*(leaf.vertex.z+leaf.zwidth/2)+c;
+		norm += std::sqrt(gx*gx+gy*gy+gz*gz);
+		++crossing;
+	}
+	if(crossing==0 or norm==0){
+		return 0;
+	}
+	norm /= crossing;
+	h = SENSITIVITY_WIDTH*side;
+	// the wider delta, of width 2h, covers sign*g in (0,2h*norm)
+	band = 2*h*norm;
+	for(const Parallelepiped &leaf : leaves){
+		if(function.classify(leaf)==BOX_OUTSIDE){
+			continue;
+		}
+		inequality.valueRange(leaf,low,high);
+		if(!meetsBand(low,high,sign,band)){
+			continue;
+		}
+		cells[0] = std::max(1,(int)std::ceil(leaf.xwidth/h));
+		cells[1] = std::max(1,(int)std::ceil(leaf.ywidth/h));
+		cells[2] = std::max(1,(int)std::ceil(leaf.zwidth/h));
+		Parallelepiped cell(leaf.vertex,leaf.xwidth/cells[0],leaf.ywidth/cells[1],leaf.zwidth/cells[2]);
+		xs.clear();
+		ys.clear();
+		zs.clear();
+		weights.clear();
+		ts.clear();
+		for(k=0;k<cells[2];++k){
+			cell.vertex.z = leaf.vertex.z+k*cell.zwidth;
+			for(j=0;j<cells[1];++j){
+				cell.vertex.y = leaf.vertex.y+j*cell.ywidth;
+				for(i=0;i<cells[0];++i){
+					cell.vertex.x = leaf.vertex.x+i*cell.xwidth;
+					inequality.valueRange(cell,low,high);
+					if(!meetsBand(low,high,sign,band) or function.classify(cell)==BOX_OUTSIDE){
+						continue;
+					}
+					for(r=0;r<SENSITIVITY_GAUSS_ORDER;++r){
+						z = cell.vertex.z+cell.zwidth*(1+sensitivityRule.nodes[r])/2;
+						for(q=0;q<SENSITIVITY_GAUSS_ORDER;++q){
+							y = cell.vertex.y+cell.ywidth*(1+sensitivityRule.nodes[q])/2;
+							for(p=0;p<SENSITIVITY_GAUSS_ORDER;++p){
+								x = cell.vertex.x+cell.xwidth*(1+sensitivityRule.nodes[p])/2;
+								double t = sign*inequality.value(x,y,z)/(h*norm);
+								if(t>=2 or !function.isInDomain(x,y,z)){
+									continue;
+								}
+								xs.push_back(x);
+								ys.push_back(y);
+								zs.push_back(z);
+								ts.push_back(t);
+								weights.push_back(sensitivityRule.weights[p]*sensitivityRule.weights[q]
+													*sensitivityRule.weights[r]*cell.xwidth*cell.ywidth*cell.zwidth/8);
+							}
+						}
+					}
+				}
+			}
+		}
+		values.resize(xs.size());
+		failed |= function.evaluateBatch(xs.data(),ys.data(),zs.data(),values.data(),values.size());
+		evaluations += values.size();
+		for(point=0;point<values.size();++point){
+			// derivative of sign*g with respect to each coefficient, times f and the weight
+			double base = sign*weights[point]*values[point]/(h*norm);
+			double kernels[2] = {kernel(ts[point]),kernel(ts[point]/2)/2};
+			double terms[SENSITIVITY_COEFFICIENTS] = {xs[point]*xs[point],xs[point],ys[point]*ys[point],ys[point],
+														zs[point]*zs[point],zs[point],1};
+			for(m=0;m<SENSITIVITY_COEFFICIENTS;++m){
+				fine[m] += base*terms[m]*kernels[0];
+				coarse[m] += base*terms[m]*kernels[1];
+			}
+		}
+	}
+	for(m=0;m<SENSITIVITY_COEFFICIENTS;++m){
+		gradient[m] = factor*fine[m];
+		// second order: the error of the width h is about a third of the difference with 2h
+		errors[m] = factor*std::fabs(fine[m]-coarse[m])/3;
+	}
+	// on a symmetric domain of an even function, moving the border along a halved axis
+	// gains on one side what is lost on the other
+	for(m=0;m<3;++m){
+		if(reduced[m]){
+			gradient[2*m+1] = 0;
+			errors[2*m+1] = 0;
+		}
+	}
+	return failed;
+}
@@ -0,0 +1,321 @@
+#include "../include/sparseGrid.h"
+
+//===================== ClenshawCurtisRule Class =====================//
+// empty constructor
+ClenshawCurtisRule::ClenshawCurtisRule(){
+}
+
+// constructor of the rule of the given level, with the indices of its points
+// on the grid of level maxLevel
+ClenshawCurtisRule::ClenshawCurtisRule(const int &level, const int &maxLevel){
+	int j, k, n;
+	double theta, sum;
+	if(level==1){
+		nodes.push_back(0);
+		weights.push_back(2);
+		indices.push_back(1u<<(maxLevel-2));
+		return;
+	}
+	n = 1<<(level-1); // number of intervals
+	nodes.resize(n+1);
+	weights.resize(n+1);
+	indices.resize(n+1);
+	for(j=0;j<=n;++j){
+		theta = j*M_PI/n;
+		nodes[j] = -std::cos(theta);
+		// weights of the Clenshaw-Curtis rule, from the cosine series of the function
+		sum = 0;
+		for(k=1;k<=n/2;++k){
+			sum += (k==n/2 ? 1.0 : 2.0)/(4.0*k*k-1)*std::cos(2*k*theta);
+		}
+		weights[j] = (j==0 or j==n ? 1.0 : 2.0)/n*(1-sum);
+		indices[j] = j<<(maxLevel-level);
+	}
+}
+
+// empty destructor
+ClenshawCurtisRule::~ClenshawCurtisRule(){
+}
+
+
+//===================== SparseGrid Class =====================//
+// structure of a difference computed but not refined yet
+struct ActiveDifference{
+	int levels[3];
+	double value;
+};
+
+// function that packs the levels of a difference into an int
+static int packLevels(const int levels[3]){
+	return levels[0] | levels[1]<<5 | levels[2]<<10;
+}
+
+// constructor of the grid up to the given level(at least 2, at most SPARSE_GRID_MAX_LEVEL)
+// on the box, in the coordinates of the transformation
+SparseGrid::SparseGrid(const Parallelepiped &_domain, const VariableTransform &_transform,
+						const int &_maxLevel, const int &_precisionMode)
+						: domain(_domain), transform(_transform), maxLevel(_maxLevel),
+						precisionMode(_precisionMode), outside(0){
+	maxLevel = std::min(std::max(maxLevel,2),SPARSE_GRID_MAX_LEVEL);
+	rules.resize(maxLevel+1);
+}
+
+// empty destructor
+SparseGrid::~SparseGrid(){
+}
+
+// This function integrates the function with the dimension-adaptive algorithm: the
+// differences with all levels up to 2 are computed, then the difference with the biggest
+// contribution is refined, adding the next level along each axis whose lower differences
+// are all refined already. The error is the sum of the contributions not refined yet, and
+// of the ones that couldn't be refined along some axis because of maxLevel.
+double SparseGrid::integrate(const Function3D &function, const double &epsilon, double &finalError,
+								IntegrationContext &context){
+	std::vector<ActiveDifference> active;
+	int levels[3];
+	int i, k, depthLimited = 0;
+	unsigned int j, biggest;
+	double total = 0, activeError, value, droppedError = 0;
+	// full grid of level 2
+	for(levels[0]=1;levels[0]<=2;++levels[0]){
+		for(levels[1]=1;levels[1]<=2;++levels[1]){
+			for(levels[2]=1;levels[2]<=2;++levels[2]){
+				value = difference(function,levels,context);
+				total += value;
+				computed.insert(packLevels(levels));
+				// with maxLevel 2 the differences of level 2 can't be refined
+				if(maxLevel<=2 and (levels[0]==2 or levels[1]==2 or levels[2]==2)){
+					droppedError += std::fabs(value);
+				}
+			}
+		}
+	}
+	if(maxLevel>2){
+		for(k=0;k<3;++k){
+			ActiveDifference next = {{1,1,1},0};
+			next.levels[k] = 3;
+			next.value = difference(function,next.levels,context);
+			total += next.value;
+			active.push_back(next);
+		}
+	}else{
+		depthLimited = 1;
+	}
+
+	while(1){
+		activeError = 0;
+		biggest = 0;
+		for(j=0;j<active.size();++j){
+			activeError += std::fabs(active[j].value);
+			if(std::fabs(active[j].value)>std::fabs(active[biggest].value)){
+				biggest = j;
+			}
+		}
+		if(activeError<epsilon or active.empty()){
+			break;
+		}
+		// the biggest contribution is refined along every axis
+		ActiveDifference refined = active[biggest];
+		active.erase(active.begin()+biggest);
+		computed.insert(packLevels(refined.levels));
+		// its size stays in the error if it can't be refined along some axis
+		for(k=0;k<3;++k){
+			if(refined.levels[k]+1>maxLevel){
+				droppedError += std::fabs(refined.value);
+				break;
+			}
+		}
+		for(k=0;k<3;++k){
+			for(i=0;i<3;++i){
+				levels[i] = refined.levels[i];
+			}
+			++levels[k];
+			if(levels[k]>maxLevel){
+				depthLimited = 1;
+				continue;
+			}
+			if(!isAdmissible(levels)){
+				continue;
+			}
+			ActiveDifference next = {{levels[0],levels[1],levels[2]},difference(function,levels,context)};
+			total += next.value;
+			active.push_back(next);
+		}
+	}
+
+	if(depthLimited){
+		context.status |= INTEGRATION_STATUS_DEPTH_LIMITED;
+	}
+	context.regions += computed.size()+active.size();
+	finalError += activeError+droppedError;
+	return total;
+}
+
+// function that returns the rule of the given level, building it the first time
+const ClenshawCurtisRule& SparseGrid::rule(const int &level){
+	ClenshawCurtisRule &current = rules[level];
+	unsigned int j;
+	if(!current.nodes.empty()){
+		return current;
+	}
+	current = ClenshawCurtisRule(level,maxLevel);
+	current.differences = current.weights;
+	if(level==1){
+		return current;
+	}
+	// the points of the previous level are among the ones of this level
+	const ClenshawCurtisRule &previous = rule(level-1);
+	std::unordered_map<uint32_t,double> previousWeights;
+	for(j=0;j<previous.indices.size();++j){
+		previousWeights[previous.indices[j]] = previous.weights[j];
+	}
+	for(j=0;j<current.indices.size();++j){
+		std::unordered_map<uint32_t,double>::const_iterator it = previousWeights.find(current.indices[j]);
+		if(it!=previousWeights.end()){
+			current.differences[j] -= it->second;
+		}
+	}
+	return current;
+}
+
+// This function computes the tensor product of the differences of the rules of the
+// given levels, that is the contribution of those levels to Smolyak's formula
+double SparseGrid::difference(const Function3D &function, const int levels[3], IntegrationContext &context){
+	const ClenshawCurtisRule &rx = rule(levels[0]);
+	const ClenshawCurtisRule &ry = rule(levels[1]);
+	const ClenshawCurtisRule &rz = rule(levels[2]);
+	int point[3];
+	double sumx = 0, sumy, sumz;
+	if(function.hasBatch() and (precisionMode!=PRECISION_MODE_FLOAT or function.getSource()!=nullptr)){
+		prefetch(function,levels,context);
+	}
+	for(point[0]=0;point[0]<(int)rx.nodes.size();++point[0]){
+		sumy = 0;
+		for(point[1]=0;point[1]<(int)ry.nodes.size();++point[1]){
+			sumz = 0;
+			for(point[2]=0;point[2]<(int)rz.nodes.size();++point[2]){
+				sumz += rz.differences[point[2]]*sample(function,levels,point,context);
+			}
+			sumy += ry.differences[point[1]]*sumz;
+		}
+		sumx += rx.differences[point[0]]*sumy;
+	}
+	// the rules are on [-1,1]
+	return sumx*domain.xwidth*domain.ywidth*domain.zwidth/8;
+}
+
+// This function evaluates with one call of the batch function the points of the difference
+// of the given levels not met yet, and caches their values as sample does. Sources evaluating
+// many points at once(i.e. worker processes) aren't given them one at a time.
+void SparseGrid::prefetch(const Function3D &function, const int levels[3], IntegrationContext &context){
+	const ClenshawCurtisRule &rx = rules[levels[0]];
+	const ClenshawCurtisRule &ry = rules[levels[1]];
+	const ClenshawCurtisRule &rz = rules[levels[2]];
+	int point[3], level = std::max(levels[0],std::max(levels[1],levels[2]));
+	size_t i;
+	uint64_t key;
+	double x, y, z, jacobian;
+	std::vector<double> xs, ys, zs, jacobians, batch;
+	std::vector<uint64_t> keys;
+	for(point[0]=0;point[0]<(int)rx.nodes.size();++point[0]){
+		for(point[1]=0;point[1]<(int)ry.nodes.size();++point[1]){
+			for(point[2]=0;point[2]<(int)rz.nodes.size();++point[2]){
+				key = (uint64_t)rx.indices[point[0]] | (uint64_t)ry.indices[point[1]]<<SPARSE_GRID_INDEX_BITS
+						| (uint64_t)rz.indices[point[2]]<<(2*SPARSE_GRID_INDEX_BITS);
+				if(values.count(key)){
+					continue;
+				}
+				x = domain.vertex.x+(rx.nodes[point[0]]+1)/2*domain.xwidth;
+				y = domain.vertex.y+(ry.nodes[point[1]]+1)/2*domain.ywidth;
+				z = domain.vertex.z+(rz.nodes[point[2]]+1)/2*domain.zwidth;
+				jacobian = transform.map(x,y,z);
+				++context.evaluations;
+				// points at infinity have jacobian 0, and the function is 0 outside the domain
+				if(jacobian==0 or !function.isInDomain(x,y,z)){
+					outside |= jacobian!=0;
+					if(context.trace!=nullptr){
+						context.record(x,y,z,0,function.isInDomain(x,y,z),level,0);
+					}
+					values[key] = 0;
+					continue;
+				}
+				xs.push_back(x);
+				ys.push_back(y);
+				zs.push_back(z);
+				jacobians.push_back(jacobian);
+				keys.push_back(key);
+			}
+		}
+	}
+	batch.resize(xs.size());
+	if(function.evaluateBatch(xs.data(),ys.data(),zs.data(),batch.data(),batch.size())){
+		context.status |= INTEGRATION_STATUS_EVALUATION_FAILED;
+	}
+	for(i=0;i<batch.size();++i){
+		if(context.trace!=nullptr){
+			context.record(xs[i],ys[i],zs[i],batch[i],1,level,0);
+		}
+		values[keys[i]] = batch[i]*jacobians[i];
+	}
+}
+
+// This function returns the value of the function in the point of the rules of the
+// given levels, evaluating it only the first time the point is met
+double SparseGrid::sample(const Function3D &function, const int levels[3], const int point[3],
+							IntegrationContext &context){
+	const ClenshawCurtisRule &rx = rules[levels[0]];
+	const ClenshawCurtisRule &ry = rules[levels[1]];
+	const ClenshawCurtisRule &rz = rules[levels[2]];
+	uint64_t key = (uint64_t)rx.indices[point[0]] | (uint64_t)ry.indices[point[1]]<<SPARSE_GRID_INDEX_BITS
+					| (uint64_t)rz.indices[point[2]]<<(2*SPARSE_GRID_INDEX_BITS);
+	std::unordered_map<uint64_t,double>::const_iterator it = values.find(key);
+	if(it!=values.end()){
+		return it->second;
+	}
+	double x = domain.vertex.x+(rx.nodes[point[0]]+1)/2*domain.xwidth;
+	double y = domain.vertex.y+(ry.nodes[point[1]]+1)/2*domain.ywidth;
+	double z = domain.vertex.z+(rz.nodes[point[2]]+1)/2*domain.zwidth;
+	double jacobian = transform.map(x,y,z);
+	double value = 0;
+	// points at infinity have jacobian 0
+	if(jacobian!=0){
+		outside |= !function.isInDomain(x,y,z);
+		if(precisionMode==PRECISION_MODE_FLOAT){
+			value = function.evaluateFloat(x,y,z);
+		}else{
+			value = function(x,y,z);
+		}
+	}
+	++context.evaluations;
+	if(context.trace!=nullptr){
+		// the level of the point is the finest of its rules
+		context.record(x,y,z,value,function.isInDomain(x,y,z),std::max(levels[0],std::max(levels[1],levels[2])),0);
+	}
+	value *= jacobian;
+	values[key] = value;
+	return value;
+}
+
+// function that checks if some node of the grid fell outside the domain
+int SparseGrid::cutsDomain() const{
+	return outside;
+}
+
+// function that checks if every difference with one level less is refined
+int SparseGrid::isAdmissible(const int levels[3]) const{
+	int k;
+	int previous[3];
+	for(k=0;k<3;++k){
+		if(levels[k]==1){
+			continue;
+		}
+		previous[0] = levels[0];
+		previous[1] = levels[1];
+		previous[2] = levels[2];
+		--previous[k];
+		if(!computed.count(packLevels(previous))){
+			return 0;
+		}
+	}
+	return 1;
+}
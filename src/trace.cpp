@@ -0,0 +1,226 @@
+#include "../include/trace.h"
+
+//===================== TraceChunk Class =====================//
+// constructor of an empty chunk(memory is taken when the first points are added,
+// and kept when the chunk is emptied)
+TraceChunk::TraceChunk(){
+}
+
+// function that adds a point to the chunk
+void TraceChunk::add(const double &_x, const double &_y, const double &_z, const double &_value,
+						const int &_inDomain, const int &_level, const int &_depth){
+	x.push_back(_x);
+	y.push_back(_y);
+	z.push_back(_z);
+	value.push_back(_value);
+	inDomain.push_back(_inDomain!=0);
+	level.push_back(_level);
+	depth.push_back(_depth);
+}
+
+// function that empties the chunk, keeping its memory
+void TraceChunk::clear(){
+	x.clear();
+	y.clear();
+	z.clear();
+	value.clear();
+	inDomain.clear();
+	level.clear();
+	depth.clear();
+}
+
+// function that exchanges the points of two chunks, without copying them
+void TraceChunk::swap(TraceChunk &chunk){
+	x.swap(chunk.x);
+	y.swap(chunk.y);
+	z.swap(chunk.z);
+	value.swap(chunk.value);
+	inDomain.swap(chunk.inDomain);
+	level.swap(chunk.level);
+	depth.swap(chunk.depth);
+}
+
+// function that returns the number of points in the chunk
+size_t TraceChunk::size() const{
+	return x.size();
+}
+
+
+//===================== TraceWriter Class =====================//
+// constructor of a writer without file
+TraceWriter::TraceWriter() : hasWaiting(0), stop(0), points(0), failed(0){
+}
+
+// destructor that writes what's left and closes the file
+TraceWriter::~TraceWriter(){
+	if(close()){
+		logStream() << WARNING_LOG << "failed writing the trace." << std::endl;
+	}
+}
+
+// function that creates the file, writes its header and starts the background thread
+int TraceWriter::open(const std::string &fileName){
+	uint32_t version = TRACE_VERSION;
+	if(close()){
+		return 1;
+	}
+	file.open(fileName,std::ios::binary | std::ios::trunc);
+	if(!file.is_open()){
+		logStream() << ERROR_LOG << "cannot create trace file " << fileName << std::endl;
+		return 1;
+	}
+	file.write(TRACE_MAGIC,TRACE_MAGIC_SIZE);
+	file.write((const char*)&version,sizeof(version));
+	stop = 0;
+	failed = 0;
+	points = 0;
+	hasWaiting = 0;
+	writer = std::thread(&TraceWriter::run,this);
+	return 0;
+}
+
+// function that waits for the chunks handed over to be written, and closes the file
+int TraceWriter::close(){
+	if(!writer.joinable()){
+		return 0;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = 1;
+	}
+	changed.notify_all();
+	writer.join();
+	file.close();
+	return failed or file.fail();
+}
+
+// function that checks if the file is open
+int TraceWriter::isOpen() const{
+	return writer.joinable();
+}
+
+// function that hands a full chunk to the writer. The chunk waits in "waiting", and the
+// caller gets back the empty buffer that was there; if the writer hasn't taken the
+// previous chunk yet, the caller waits for it. Without a file open(no writer to take
+// the chunk) the points are dropped.
+void TraceWriter::submit(TraceChunk &chunk){
+	if(chunk.size()==0){
+		return;
+	}
+	if(!writer.joinable()){
+		chunk.clear();
+		return;
+	}
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock,[this](){ return !hasWaiting; });
+		waiting.swap(chunk);
+		points += waiting.size();
+		hasWaiting = 1;
+	}
+	chunk.clear();
+	changed.notify_all();
+}
+
+// function that returns the number of points handed over
+size_t TraceWriter::getPoints() const{
+	std::lock_guard<std::mutex> lock(mutex);
+	return points;
+}
+
+// function run by the background thread: it takes the chunk waiting, and writes it
+// without holding the lock, so the next chunk can be handed over meanwhile
+void TraceWriter::run(){
+	while(1){
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			changed.wait(lock,[this](){ return hasWaiting or stop; });
+			if(!hasWaiting){
+				return;
+			}
+			writing.swap(waiting);
+			hasWaiting = 0;
+		}
+		changed.notify_all();
+		write(writing);
+		writing.clear();
+	}
+}
+
+// function that writes a chunk, column by column
+void TraceWriter::write(const TraceChunk &chunk){
+	uint32_t count = chunk.size();
+	file.write((const char*)&count,sizeof(count));
+	file.write((const char*)chunk.x.data(),count*sizeof(double));
+	file.write((const char*)chunk.y.data(),count*sizeof(double));
+	file.write((const char*)chunk.z.data(),count*sizeof(double));
+	file.write((const char*)chunk.value.data(),count*sizeof(double));
+	file.write((const char*)chunk.inDomain.data(),count*sizeof(uint8_t));
+	file.write((const char*)chunk.level.data(),count*sizeof(uint8_t));
+	file.write((const char*)chunk.depth.data(),count*sizeof(uint16_t));
+	if(file.fail() and !failed){
+		failed = 1;
+		logStream() << ERROR_LOG << "failed writing the trace, the rest is dropped." << std::endl;
+	}
+}
+
+
+//===================== TraceReader Class =====================//
+// constructor of a reader without file
+TraceReader::TraceReader(){
+}
+
+// empty destructor
+TraceReader::~TraceReader(){
+}
+
+// function that opens a trace file, checking its header
+int TraceReader::open(const std::string &fileName){
+	char magic[TRACE_MAGIC_SIZE];
+	uint32_t version;
+	file.open(fileName,std::ios::binary);
+	if(!file.is_open()){
+		logStream() << ERROR_LOG << "cannot open trace file " << fileName << std::endl;
+		return 1;
+	}
+	file.read(magic,TRACE_MAGIC_SIZE);
+	file.read((char*)&version,sizeof(version));
+	if(file.fail() or std::string(magic,TRACE_MAGIC_SIZE)!=TRACE_MAGIC){
+		logStream() << ERROR_LOG << fileName << " is not a trace file." << std::endl;
+		return 1;
+	}
+	if(version!=TRACE_VERSION){
+		logStream() << ERROR_LOG << "trace file " << fileName << " has version " << version
+					<< ", expected " << TRACE_VERSION << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+// function that reads the next chunk of the file
+int TraceReader::read(TraceChunk &chunk){
+	uint32_t count;
+	if(!file.read((char*)&count,sizeof(count))){
+		return 1;
+	}
+	chunk.x.resize(count);
+	chunk.y.resize(count);
+	chunk.z.resize(count);
+	chunk.value.resize(count);
+	chunk.inDomain.resize(count);
+	chunk.level.resize(count);
+	chunk.depth.resize(count);
+	file.read((char*)chunk.x.data(),count*sizeof(double));
+	file.read((char*)chunk.y.data(),count*sizeof(double));
+	file.read((char*)chunk.z.data(),count*sizeof(double));
+	file.read((char*)chunk.value.data(),count*sizeof(double));
+	file.read((char*)chunk.inDomain.data(),count*sizeof(uint8_t));
+	file.read((char*)chunk.level.data(),count*sizeof(uint8_t));
+	file.read((char*)chunk.depth.data(),count*sizeof(uint16_t));
+	if(file.fail()){
+		logStream() << WARNING_LOG << "trace file truncated, last chunk dropped." << std::endl;
+		chunk.clear();
+		return 1;
+	}
+	return 0;
+}
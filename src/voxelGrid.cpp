@@ -0,0 +1,465 @@
+#include "../include/voxelGrid.h"
+
+//===================== VoxelLayout Class =====================//
+// constructor of the layout of a float32 grid of 2x2x2 unit cells at the origin
+VoxelLayout::VoxelLayout() : type(VOXEL_TYPE_FLOAT32), offset(0){
+	int a;
+	for(a=0;a<3;++a){
+		dims[a] = 2;
+		spacing[a] = 1;
+		origin[a] = 0;
+	}
+}
+
+
+//===================== VoxelGrid Class =====================//
+// function that interpolates the values at the corners of a cell, given the
+// position inside it(between 0 and 1 along each axis)
+static double trilinear(const double v[8], const double t[3]){
+	double x00 = v[0]+(v[1]-v[0])*t[0];
+	double x10 = v[2]+(v[3]-v[2])*t[0];
+	double x01 = v[4]+(v[5]-v[4])*t[0];
+	double x11 = v[6]+(v[7]-v[6])*t[0];
+	double y0 = x00+(x10-x00)*t[1];
+	double y1 = x01+(x11-x01)*t[1];
+	return y0+(y1-y0)*t[2];
+}
+
+// function that cuts a cell of an axis(starting from "low", of width "h") to the range
+// [rangeLow,rangeHigh], and computes the integrals over the cut of the two linear
+// interpolation weights. The cut is returned in "cut".
+static void clipCell(const double &low, const double &h, const double &rangeLow, const double &rangeHigh,
+						double cut[2], double weights[2]){
+	double t0 = std::max(0.0,(rangeLow-low)/h);
+	double t1 = std::min(1.0,(rangeHigh-low)/h);
+	if(t1<t0){
+		t1 = t0;
+	}
+	cut[0] = low+t0*h;
+	cut[1] = low+t1*h;
+	// integrals of 1-t and t between t0 and t1
+	weights[1] = h*(t1*t1-t0*t0)/2;
+	weights[0] = h*(t1-t0)-weights[1];
+}
+
+// function that integrates exactly the interpolation of a cell, given the weights of each axis
+static double cellIntegral(const double v[8], const double wx[2], const double wy[2], const double wz[2]){
+	return wz[0]*(wy[0]*(wx[0]*v[0]+wx[1]*v[1])+wy[1]*(wx[0]*v[2]+wx[1]*v[3]))
+			+wz[1]*(wy[0]*(wx[0]*v[4]+wx[1]*v[5])+wy[1]*(wx[0]*v[6]+wx[1]*v[7]));
+}
+
+// constructor of a grid not mapped yet
+VoxelGrid::VoxelGrid() : map(nullptr), mapSize(0), data(nullptr){
+}
+
+// destructor that unmaps the file
+VoxelGrid::~VoxelGrid(){
+	if(close()){
+		logStream() << WARNING_LOG << "failed unmapping the voxel file." << std::endl;
+	}
+}
+
+// function that maps a file starting with a header(see VOXEL_HEADER_MAGIC)
+int VoxelGrid::open(const std::string &fileName){
+	VoxelLayout _layout;
+	if(readHeader(fileName,_layout)){
+		return 1;
+	}
+	return open(fileName,_layout);
+}
+
+// function that maps a file whose values are stored as described by the layout. The
+// values are read from the file only when needed, and never copied.
+int VoxelGrid::open(const std::string &fileName, const VoxelLayout &_layout){
+	int a, fd;
+	struct stat info;
+	size_t count = 1, size = _layout.type==VOXEL_TYPE_FLOAT64 ? sizeof(double) : sizeof(float);
+	if(close()){
+		return 1;
+	}
+	if(_layout.type!=VOXEL_TYPE_FLOAT32 and _layout.type!=VOXEL_TYPE_FLOAT64){
+		logStream() << ERROR_LOG << "unknown type of the voxels." << std::endl;
+		return 1;
+	}
+	for(a=0;a<3;++a){
+		if(_layout.dims[a]<2 or !(_layout.spacing[a]>0)){
+			logStream() << ERROR_LOG << "voxel grid should have at least 2 values per axis,"
+						<< " and positive spacing." << std::endl;
+			return 1;
+		}
+		// the bytes of the layout must fit in size_t, or the file would be checked against
+		// the overflowed size and read past its end
+		if(_layout.dims[a]>std::numeric_limits<size_t>::max()/size/count){
+			logStream() << ERROR_LOG << "voxel grid is too big to be addressed." << std::endl;
+			return 1;
+		}
+		count *= _layout.dims[a];
+	}
+	if(_layout.offset>std::numeric_limits<size_t>::max()-count*size){
+		logStream() << ERROR_LOG << "voxel grid is too big to be addressed." << std::endl;
+		return 1;
+	}
+	fd = ::open(fileName.c_str(),O_RDONLY);
+	if(fd<0){
+		logStream() << ERROR_LOG << "cannot open voxel file " << fileName << std::endl;
+		return 1;
+	}
+	if(fstat(fd,&info) or (size_t)info.st_size<_layout.offset+count*size){
+		logStream() << ERROR_LOG << "voxel file " << fileName << " is smaller than its layout." << std::endl;
+		::close(fd);
+		return 1;
+	}
+	mapSize = _layout.offset+count*size;
+	map = mmap(nullptr,mapSize,PROT_READ,MAP_SHARED,fd,0);
+	// the mapping keeps the file open
+	::close(fd);
+	if(map==MAP_FAILED){
+		logStream() << ERROR_LOG << "cannot map voxel file " << fileName << std::endl;
+		map = nullptr;
+		mapSize = 0;
+		return 1;
+	}
+	// integrals walk the file in order, so the system can read ahead
+	madvise(map,mapSize,MADV_SEQUENTIAL);
+	layout = _layout;
+	data = (const unsigned char*)map+layout.offset;
+	return 0;
+}
+
+// function that unmaps the file(if mapped)
+int VoxelGrid::close(){
+	if(map==nullptr){
+		return 0;
+	}
+	if(munmap(map,mapSize)){
+		return 1;
+	}
+	map = nullptr;
+	mapSize = 0;
+	data = nullptr;
+	return 0;
+}
+
+// function that checks if a file is mapped
+int VoxelGrid::isOpen() const{
+	return map!=nullptr;
+}
+
+// function that returns how the values are stored
+const VoxelLayout& VoxelGrid::getLayout() const{
+	return layout;
+}
+
+// function that returns the box covered by the grid, outside of which the integrand is 0
+Parallelepiped VoxelGrid::getBox() const{
+	return Parallelepiped(Point3D(layout.origin[0],layout.origin[1],layout.origin[2]),
+							(layout.dims[0]-1)*layout.spacing[0],(layout.dims[1]-1)*layout.spacing[1],
+							(layout.dims[2]-1)*layout.spacing[2]);
+}
+
+// function that returns the value (i,j,k) of the grid. The values may not be aligned
+// in the file, so they're copied out of it.
+double VoxelGrid::value(const size_t &i, const size_t &j, const size_t &k) const{
+	size_t index = i+layout.dims[0]*(j+layout.dims[1]*k);
+	if(layout.type==VOXEL_TYPE_FLOAT64){
+		double value;
+		std::memcpy(&value,data+index*sizeof(double),sizeof(double));
+		return value;
+	}
+	float value;
+	std::memcpy(&value,data+index*sizeof(float),sizeof(float));
+	return value;
+}
+
+// function that reads the values at the corners of the cell (i,j,k), x varying fastest
+void VoxelGrid::corners(const size_t &i, const size_t &j, const size_t &k, double v[8]) const{
+	v[0] = value(i,j,k);
+	v[1] = value(i+1,j,k);
+	v[2] = value(i,j+1,k);
+	v[3] = value(i+1,j+1,k);
+	v[4] = value(i,j,k+1);
+	v[5] = value(i+1,j,k+1);
+	v[6] = value(i,j+1,k+1);
+	v[7] = value(i+1,j+1,k+1);
+}
+
+// operator() that interpolates the values of the cell containing (x,y,z), 0 outside the grid
+double VoxelGrid::operator()(const double &x, const double &y, const double &z) const{
+	const double point[3] = {x,y,z};
+	size_t cell[3];
+	double t[3], v[8], u;
+	int a;
+	if(map==nullptr){
+		return 0;
+	}
+	for(a=0;a<3;++a){
+		u = (point[a]-layout.origin[a])/layout.spacing[a];
+		if(!(u>=0 and u<=layout.dims[a]-1)){
+			return 0;
+		}
+		cell[a] = std::min((size_t)u,layout.dims[a]-2);
+		t[a] = u-cell[a];
+	}
+	corners(cell[0],cell[1],cell[2],v);
+	return trilinear(v,t);
+}
+
+// This function integrates the interpolation over the domain inside the box, walking the
+// cells in the order of the file: z planes, y rows, x cells. Each row is classified first,
+// and only the cells of the rows crossing the border are classified one by one. Cells
+// inside the domain are integrated exactly(the interpolation is a product of linear
+// functions), cells outside are not read. Cells cut by the box(i.e. by the symmetry
+// reduction) are integrated exactly over the cut. The tolerance is shared by the cells
+// crossing the border, which are counted first without reading the file.
+int VoxelGrid::integrate(const Function3D &function, const Parallelepiped &box, const double &epsilon,
+							double &finalValue, double &finalError, IntegrationContext &context) const{
+	const double low[3] = {box.vertex.x,box.vertex.y,box.vertex.z};
+	const double high[3] = {box.vertex.x+box.xwidth,box.vertex.y+box.ywidth,box.vertex.z+box.zwidth};
+	const double *h = layout.spacing;
+	size_t first[3], last[3], i, j, k, boundary;
+	double u0, u1, v[8], cut[3][2], w[3][2], cellLow[3], lowCorner[3], highCorner[3];
+	double row, tolerance;
+	long double total = 0;
+	int a, position;
+	if(map==nullptr){
+		return 1;
+	}
+	// cells of the grid meeting the box, from first to last-1
+	for(a=0;a<3;++a){
+		u0 = std::max(0.0,(low[a]-layout.origin[a])/h[a]);
+		u1 = std::min((double)(layout.dims[a]-1),(high[a]-layout.origin[a])/h[a]);
+		if(!(u1>u0)){
+			// the box misses the grid
+			return 0;
+		}
+		first[a] = std::min((size_t)u0,layout.dims[a]-2);
+		last[a] = std::max(first[a]+1,std::min((size_t)std::ceil(u1),layout.dims[a]-1));
+	}
+	boundary = countBoundary(function,low,high,first,last);
+	tolerance = boundary>0 ? epsilon/boundary : epsilon;
+	for(k=first[2];k<last[2];++k){
+		cellLow[2] = layout.origin[2]+k*h[2];
+		clipCell(cellLow[2],h[2],low[2],high[2],cut[2],w[2]);
+		for(j=first[1];j<last[1];++j){
+			cellLow[1] = layout.origin[1]+j*h[1];
+			clipCell(cellLow[1],h[1],low[1],high[1],cut[1],w[1]);
+			// the whole row at once
+			lowCorner[0] = std::max(low[0],layout.origin[0]+first[0]*h[0]);
+			highCorner[0] = std::min(high[0],layout.origin[0]+last[0]*h[0]);
+			position = function.classify(Parallelepiped(Point3D(lowCorner[0],cut[1][0],cut[2][0]),
+											highCorner[0]-lowCorner[0],cut[1][1]-cut[1][0],cut[2][1]-cut[2][0]));
+			if(position==BOX_OUTSIDE){
+				continue;
+			}
+			row = 0;
+			for(i=first[0];i<last[0];++i){
+				cellLow[0] = layout.origin[0]+i*h[0];
+				clipCell(cellLow[0],h[0],low[0],high[0],cut[0],w[0]);
+				++context.regions;
+				if(position==BOX_BOUNDARY){
+					for(a=0;a<3;++a){
+						lowCorner[a] = cut[a][0];
+						highCorner[a] = cut[a][1];
+					}
+					switch(function.classify(Parallelepiped(Point3D(lowCorner[0],lowCorner[1],lowCorner[2]),
+														highCorner[0]-lowCorner[0],highCorner[1]-lowCorner[1],
+														highCorner[2]-lowCorner[2]))){
+						case BOX_OUTSIDE:
+							--context.regions;
+							continue;
+						case BOX_BOUNDARY:
+							corners(i,j,k,v);
+							row += boundaryCell(function,v,lowCorner,highCorner,cellLow,tolerance,0,
+												finalError,context);
+							continue;
+					}
+				}
+				corners(i,j,k,v);
+				row += cellIntegral(v,w[0],w[1],w[2]);
+			}
+			total += row;
+		}
+		// the plane k isn't needed by the next cells
+		release(layout.offset+(k+1)*layout.dims[0]*layout.dims[1]*(layout.type==VOXEL_TYPE_FLOAT64 ?
+																	sizeof(double) : sizeof(float)));
+	}
+	finalValue += total;
+	return 0;
+}
+
+// function that counts the cells(cut by the box) crossing the border of the domain, with
+// the same classification of integrate
+size_t VoxelGrid::countBoundary(const Function3D &function, const double low[3], const double high[3],
+								const size_t first[3], const size_t last[3]) const{
+	const double *h = layout.spacing;
+	double cut[3][2], w[2], rowCut[2];
+	size_t i, j, k, count = 0;
+	for(k=first[2];k<last[2];++k){
+		clipCell(layout.origin[2]+k*h[2],h[2],low[2],high[2],cut[2],w);
+		for(j=first[1];j<last[1];++j){
+			clipCell(layout.origin[1]+j*h[1],h[1],low[1],high[1],cut[1],w);
+			rowCut[0] = std::max(low[0],layout.origin[0]+first[0]*h[0]);
+			rowCut[1] = std::min(high[0],layout.origin[0]+last[0]*h[0]);
+			if(function.classify(Parallelepiped(Point3D(rowCut[0],cut[1][0],cut[2][0]),rowCut[1]-rowCut[0],
+												cut[1][1]-cut[1][0],cut[2][1]-cut[2][0]))!=BOX_BOUNDARY){
+				continue;
+			}
+			for(i=first[0];i<last[0];++i){
+				clipCell(layout.origin[0]+i*h[0],h[0],low[0],high[0],cut[0],w);
+				if(function.classify(Parallelepiped(Point3D(cut[0][0],cut[1][0],cut[2][0]),cut[0][1]-cut[0][0],
+													cut[1][1]-cut[1][0],cut[2][1]-cut[2][0]))==BOX_BOUNDARY){
+					++count;
+				}
+			}
+		}
+	}
+	return count;
+}
+
+// This function integrates the part between lowCorner and highCorner of a cell(starting from
+// cellLow) crossing the border of the domain. The midpoint rule on the part is compared with
+// the one on its 8 halves: if they differ more than the tolerance the part is split in 8,
+// each half is classified again, and the parts inside are integrated exactly.
+double VoxelGrid::boundaryCell(const Function3D &function, const double v[8], const double lowCorner[3],
+								const double highCorner[3], const double cellLow[3], const double &tolerance,
+								const int &depth, double &finalError, IntegrationContext &context) const{
+	const double *h = layout.spacing;
+	double width[3], point[3], t[3], coarse = 0, fine = 0, result = 0;
+	double childLow[3], childHigh[3], cut[2], w[3][2];
+	int a, child;
+	for(a=0;a<3;++a){
+		width[a] = highCorner[a]-lowCorner[a];
+	}
+	// midpoint of the part, then midpoints of its halves
+	for(child=-1;child<8;++child){
+		for(a=0;a<3;++a){
+			point[a] = lowCorner[a]+(child<0 ? 0.5 : 0.25+0.5*((child>>a)&1))*width[a];
+			t[a] = (point[a]-cellLow[a])/h[a];
+		}
+		double sample = function.isInDomain(point[0],point[1],point[2]) ? trilinear(v,t) : 0;
+		if(child<0){
+			coarse = sample;
+		}else{
+			fine += sample/8;
+		}
+	}
+	context.evaluations += 9;
+	if(std::fabs(fine-coarse)*width[0]*width[1]*width[2]<=tolerance or depth>=VOXEL_BOUNDARY_DEPTH){
+		if(std::fabs(fine-coarse)*width[0]*width[1]*width[2]>tolerance){
+			context.status |= INTEGRATION_STATUS_DEPTH_LIMITED;
+		}
+		finalError += std::fabs(fine-coarse)*width[0]*width[1]*width[2];
+		return fine*width[0]*width[1]*width[2];
+	}
+	for(child=0;child<8;++child){
+		for(a=0;a<3;++a){
+			childLow[a] = lowCorner[a]+0.5*((child>>a)&1)*width[a];
+			childHigh[a] = childLow[a]+0.5*width[a];
+		}
+		switch(function.classify(Parallelepiped(Point3D(childLow[0],childLow[1],childLow[2]),
+											0.5*width[0],0.5*width[1],0.5*width[2]))){
+			case BOX_INSIDE:
+				for(a=0;a<3;++a){
+					clipCell(cellLow[a],h[a],childLow[a],childHigh[a],cut,w[a]);
+				}
+				result += cellIntegral(v,w[0],w[1],w[2]);
+				break;
+			case BOX_BOUNDARY:
+				result += boundaryCell(function,v,childLow,childHigh,cellLow,tolerance/8,depth+1,
+										finalError,context);
+				break;
+		}
+	}
+	return result;
+}
+
+// function that gives back to the system the pages of the file before the given byte, which
+// are read again from the file if needed
+void VoxelGrid::release(const size_t &end) const{
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t bytes = end/page*page;
+	if(bytes>0){
+		madvise(map,std::min(bytes,mapSize),MADV_DONTNEED);
+	}
+}
+
+// function that reads the header of the file: the line VOXEL_HEADER_MAGIC, then lines
+// "dims nx ny nz", "spacing dx dy dz", "origin ox oy oz", "type float32|float64", in any
+// order, then VOXEL_HEADER_END. Spacing, origin and type are optional.
+int VoxelGrid::readHeader(const std::string &fileName, VoxelLayout &_layout) const{
+	std::ifstream file(fileName,std::ios::binary);
+	std::string line, name, type;
+	int lines, hasDims = 0;
+	if(!file.is_open()){
+		logStream() << ERROR_LOG << "cannot open voxel file " << fileName << std::endl;
+		return 1;
+	}
+	if(!std::getline(file,line) or line!=VOXEL_HEADER_MAGIC){
+		logStream() << ERROR_LOG << fileName << " has no voxel header, its layout should be given." << std::endl;
+		return 1;
+	}
+	for(lines=0;lines<VOXEL_HEADER_MAX_LINES and std::getline(file,line);++lines){
+		std::istringstream stream(line);
+		stream >> name;
+		if(name==VOXEL_HEADER_END){
+			if(!hasDims){
+				logStream() << ERROR_LOG << "voxel header of " << fileName << " has no dims." << std::endl;
+				return 1;
+			}
+			_layout.offset = file.tellg();
+			return 0;
+		}
+		if(name=="dims"){
+			stream >> _layout.dims[0] >> _layout.dims[1] >> _layout.dims[2];
+			hasDims = 1;
+		}else if(name=="spacing"){
+			stream >> _layout.spacing[0] >> _layout.spacing[1] >> _layout.spacing[2];
+		}else if(name=="origin"){
+			stream >> _layout.origin[0] >> _layout.origin[1] >> _layout.origin[2];
+		}else if(name=="type"){
+			stream >> type;
+			if(type=="float32"){
+				_layout.type = VOXEL_TYPE_FLOAT32;
+			}else if(type=="float64"){
+				_layout.type = VOXEL_TYPE_FLOAT64;
+			}else{
+				logStream() << ERROR_LOG << "unknown voxel type " << type << ", should be float32 or float64."
+							<< std::endl;
+				return 1;
+			}
+		}else{
+			logStream() << WARNING_LOG << "unknown voxel header line \"" << name << "\", ignored." << std::endl;
+			continue;
+		}
+		if(stream.fail()){
+			logStream() << ERROR_LOG << "malformed voxel header line \"" << line << "\"." << std::endl;
+			return 1;
+		}
+	}
+	logStream() << ERROR_LOG << "voxel header of " << fileName << " doesn't end with \""
+				<< VOXEL_HEADER_END << "\"." << std::endl;
+	return 1;
+}
+
+
+// function that replaces the function of the Function3D with the grid. What was declared
+// about the function doesn't hold for the grid: the hints only keep the box of the grid,
+// and the parity is forgotten.
+int loadVoxelGrid(const std::shared_ptr<const VoxelGrid> &grid, Function3D &function){
+	if(!grid or !grid->isOpen()){
+		logStream() << ERROR_LOG << "voxel grid not mapped." << std::endl;
+		return 1;
+	}
+	FunctionHints hints;
+	hints.smoothness = SMOOTHNESS_CONTINUOUS;
+	hints.hasBoundingBox = 1;
+	hints.boundingBox = grid->getBox();
+	function.setHints(hints);
+	function.setParity("x",PARITY_NONE);
+	function.setParity("y",PARITY_NONE);
+	function.setParity("z",PARITY_NONE);
+	// the control variate of the plugin approximates its function, not the grid
+	function.setControlVariate(nullptr,0);
+	function.setSource(grid);
+	return 0;
+}
@@ -0,0 +1,423 @@
+#include "../include/workerPool.h"
+
+//===================== WorkerPool Class =====================//
+// function run by a worker process: it evaluates the batches of its ring in order, until
+// it's asked to stop(or the parent dies)
+static void workerLoop(WorkerRing *ring, const doubleFunction3D &pointFunction,
+						const batchFunction3D &batchFunction){
+	size_t i;
+	while(1){
+		while(sem_wait(&ring->requests)==-1 and errno==EINTR);
+		if(ring->stop){
+			_exit(0);
+		}
+		WorkerSlot &slot = ring->slots[ring->next%WORKER_RING_SLOTS];
+		if(batchFunction!=nullptr){
+			batchFunction(slot.x,slot.y,slot.z,slot.values,slot.count);
+		}else{
+			for(i=0;i<slot.count;++i){
+				slot.values[i] = pointFunction(slot.x[i],slot.y[i],slot.z[i]);
+			}
+		}
+		++ring->next;
+		sem_post(&ring->results);
+	}
+}
+
+// function run by the spawner process: it forks a worker on the ring of each index asked
+// on the channel, and clears the flag of the ring once the worker ends(the spawner is the
+// only one that can wait for it). When the channel is closed it waits for the workers and ends.
+static void spawnerLoop(const int &channel, const std::vector<WorkerRing*> &rings,
+						const doubleFunction3D &pointFunction, const batchFunction3D &batchFunction){
+	std::vector<pid_t> pids(rings.size(),0);
+	struct pollfd fds[2];
+	struct signalfd_siginfo info;
+	WorkerSpawn answer;
+	sigset_t children;
+	pid_t spawner = getpid(), pid;
+	size_t i;
+	int index;
+	// the end of a worker is read from a descriptor, polled with the channel
+	sigemptyset(&children);
+	sigaddset(&children,SIGCHLD);
+	sigprocmask(SIG_BLOCK,&children,nullptr);
+	fds[0].fd = channel;
+	fds[0].events = POLLIN;
+	fds[1].fd = signalfd(-1,&children,SFD_NONBLOCK | SFD_CLOEXEC);
+	fds[1].events = POLLIN;
+	while(1){
+		// without the descriptor the workers are checked from time to time
+		if(poll(fds,2,fds[1].fd==-1 ? WORKER_POLL_MAX_MS : -1)==-1 and errno!=EINTR){
+			break;
+		}
+		if(fds[1].fd!=-1){
+			while(read(fds[1].fd,&info,sizeof(info))==sizeof(info));
+		}
+		while((pid = waitpid(-1,nullptr,WNOHANG))>0){
+			for(i=0;i<pids.size();++i){
+				if(pids[i]==pid){
+					pids[i] = 0;
+					rings[i]->running = 0;
+				}
+			}
+		}
+		if(!(fds[0].revents & (POLLIN | POLLHUP | POLLERR))){
+			continue;
+		}
+		// the channel is closed when the pool is stopped
+		if(read(channel,&index,sizeof(index))!=sizeof(index) or index<0 or index>=(int)rings.size()){
+			break;
+		}
+		pid = fork();
+		answer.pid = pid;
+		answer.error = pid<0 ? errno : 0;
+		if(pid==0){
+			// the worker ends with the spawner, even if it's killed
+			close(channel);
+			if(fds[1].fd!=-1){
+				close(fds[1].fd);
+			}
+			sigprocmask(SIG_UNBLOCK,&children,nullptr);
+			prctl(PR_SET_PDEATHSIG,SIGKILL);
+			if(getppid()!=spawner){
+				_exit(1);
+			}
+			workerLoop(rings[index],pointFunction,batchFunction);
+		}
+		if(pid>0){
+			pids[index] = pid;
+			rings[index]->running = 1;
+		}
+		send(channel,&answer,sizeof(answer),MSG_NOSIGNAL);
+	}
+	close(channel);
+	while(waitpid(-1,nullptr,0)>0 or errno==EINTR);
+	_exit(0);
+}
+
+// constructor of a pool without workers
+WorkerPool::WorkerPool() : pointFunction(nullptr), batchFunction(nullptr), restarts(0), givenUp(0), single(0),
+							callers(0), turn(0), spawner(0), channel(-1){
+}
+
+// destructor that stops the workers
+WorkerPool::~WorkerPool(){
+	stop();
+}
+
+// function that maps the rings, forks the spawner and asks it for the workers
+int WorkerPool::start(const Function3D &_function, const int &count){
+	size_t i, n = count;
+	int sockets[2];
+	pid_t parent = getpid();
+	std::vector<WorkerRing*> rings;
+	if(stop()){
+		return 1;
+	}
+	if(!_function.isCallable() or _function.getFunction()==nullptr or _function.getSource()!=nullptr){
+		logStream() << ERROR_LOG << "worker processes need the function of a plugin." << std::endl;
+		return 1;
+	}
+	if(count<0){
+		logStream() << ERROR_LOG << "number of workers should be >=0." << std::endl;
+		return 1;
+	}
+	if(n==0){
+		n = std::max(1u,std::thread::hardware_concurrency());
+	}
+	function = _function;
+	pointFunction = function.getFunction();
+	batchFunction = function.getHints().batch;
+	restarts = 0;
+	givenUp = 0;
+	single = 0;
+	turn = 0;
+	workers.resize(n);
+	for(i=0;i<n;++i){
+		Worker &worker = workers[i];
+		worker.pid = 0;
+		worker.submitted = worker.completed = 0;
+		worker.restarts = 0;
+		worker.lock.reset(new std::mutex());
+		worker.ring = (WorkerRing*)mmap(nullptr,sizeof(WorkerRing),PROT_READ | PROT_WRITE,
+										MAP_SHARED | MAP_ANONYMOUS,-1,0);
+		if(worker.ring==MAP_FAILED){
+			logStream() << ERROR_LOG << "cannot map the memory of a worker: " << std::strerror(errno) << std::endl;
+			worker.ring = nullptr;
+			workers.resize(i);
+			stop();
+			return 1;
+		}
+		worker.ring->next = 0;
+		worker.ring->stop = 0;
+		worker.ring->running = 0;
+		sem_init(&worker.ring->requests,1,0);
+		sem_init(&worker.ring->results,1,0);
+		rings.push_back(worker.ring);
+	}
+	// the spawner is forked now, while the program has one thread, with every ring mapped
+	if(socketpair(AF_UNIX,SOCK_STREAM | SOCK_CLOEXEC,0,sockets)==-1){
+		logStream() << ERROR_LOG << "cannot open the channel of the spawner: " << std::strerror(errno) << std::endl;
+		stop();
+		return 1;
+	}
+	spawner = fork();
+	if(spawner<0){
+		logStream() << ERROR_LOG << "cannot start the spawner of the workers: " << std::strerror(errno) << std::endl;
+		spawner = 0;
+		close(sockets[0]);
+		close(sockets[1]);
+		stop();
+		return 1;
+	}
+	if(spawner==0){
+		// the spawner ends with the parent, even if it's killed
+		close(sockets[0]);
+		prctl(PR_SET_PDEATHSIG,SIGKILL);
+		if(getppid()!=parent){
+			_exit(1);
+		}
+		spawnerLoop(sockets[1],rings,pointFunction,batchFunction);
+	}
+	close(sockets[1]);
+	channel = sockets[0];
+	for(Worker &worker : workers){
+		if(spawn(worker)){
+			stop();
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// function that asks the workers to end, closes the channel of the spawner(which waits
+// for them), waits for the spawner and unmaps the rings. No call of evaluate must be running
+int WorkerPool::stop(){
+	std::lock_guard<std::mutex> lock(channelMutex);
+	for(Worker &worker : workers){
+		if(worker.pid>0){
+			worker.ring->stop = 1;
+			sem_post(&worker.ring->requests);
+		}
+	}
+	if(channel!=-1){
+		close(channel);
+		channel = -1;
+	}
+	if(spawner>0){
+		while(waitpid(spawner,nullptr,0)==-1 and errno==EINTR);
+		spawner = 0;
+	}
+	for(Worker &worker : workers){
+		if(worker.ring!=nullptr){
+			sem_destroy(&worker.ring->requests);
+			sem_destroy(&worker.ring->results);
+			munmap(worker.ring,sizeof(WorkerRing));
+		}
+	}
+	workers.clear();
+	return 0;
+}
+
+// function that returns the number of workers
+int WorkerPool::getWorkers() const{
+	return workers.size();
+}
+
+// function that returns the number of workers restarted
+size_t WorkerPool::getRestarts() const{
+	return restarts;
+}
+
+// function that evaluates a single point, as a batch of one. Every point costs a round trip
+// to a worker, so the engines give batches instead: the first point evaluated alone is reported.
+double WorkerPool::operator()(const double &x, const double &y, const double &z) const{
+	double value;
+	if(!single.exchange(1)){
+		logStream() << WARNING_LOG << "points evaluated one at a time by the worker processes,"
+					<< " each one costs a round trip." << std::endl;
+	}
+	evaluate(&x,&y,&z,&value,1);
+	return value;
+}
+
+// function that tells evaluate is faster than one point at a time
+int WorkerPool::hasBatch() const{
+	return 1;
+}
+
+// function that splits the points in batches given in turn to the workers taken by the
+// call, and collects the values. A worker with its ring full has its oldest batch collected
+// first. Calls from other threads use other workers, so they don't wait for each other.
+int WorkerPool::evaluate(const double *x, const double *y, const double *z, double *values,
+							const size_t &n) const{
+	std::vector<Worker*> share;
+	size_t first, count, size, w = 0;
+	int failed = 0;
+	if(workers.empty()){
+		for(first=0;first<n;++first){
+			values[first] = std::numeric_limits<double>::quiet_NaN();
+		}
+		return 1;
+	}
+	++callers;
+	acquire(share,n);
+	size = (n+share.size()-1)/share.size();
+	size = std::min<size_t>(WORKER_BATCH_SIZE,std::max<size_t>(WORKER_MIN_BATCH,size));
+	for(first=0;first<n;first+=count){
+		count = std::min(size,n-first);
+		Worker &worker = *share[w];
+		w = (w+1)%share.size();
+		if(worker.submitted-worker.completed==WORKER_RING_SLOTS){
+			failed |= collect(worker);
+		}
+		WorkerSlot &slot = worker.ring->slots[worker.submitted%WORKER_RING_SLOTS];
+		slot.count = count;
+		std::memcpy(slot.x,x+first,count*sizeof(double));
+		std::memcpy(slot.y,y+first,count*sizeof(double));
+		std::memcpy(slot.z,z+first,count*sizeof(double));
+		worker.targets[worker.submitted%WORKER_RING_SLOTS] = values+first;
+		++worker.submitted;
+		sem_post(&worker.ring->requests);
+	}
+	for(Worker *worker : share){
+		while(worker->completed<worker->submitted){
+			failed |= collect(*worker);
+		}
+		worker->lock->unlock();
+	}
+	--callers;
+	return failed;
+}
+
+// function that takes the free workers from the one after the last call's first, until the
+// call has its share. If all of them are used by other calls, it waits for its first one.
+void WorkerPool::acquire(std::vector<Worker*> &share, const size_t &n) const{
+	size_t i, start = turn++, running = callers, wanted;
+	wanted = (workers.size()+running-1)/running;
+	wanted = std::max<size_t>(1,std::min(wanted,(n+WORKER_MIN_BATCH-1)/WORKER_MIN_BATCH));
+	for(i=0;i<workers.size() and share.size()<wanted;++i){
+		Worker &worker = workers[(start+i)%workers.size()];
+		if(worker.lock->try_lock()){
+			share.push_back(&worker);
+		}
+	}
+	if(share.empty()){
+		Worker &worker = workers[start%workers.size()];
+		worker.lock->lock();
+		share.push_back(&worker);
+	}
+}
+
+// function that asks the spawner to fork a worker on its ring. The requests go through
+// the channel one at a time, under the lock of the channel.
+int WorkerPool::spawn(Worker &worker) const{
+	std::lock_guard<std::mutex> lock(channelMutex);
+	int index = &worker-workers.data();
+	ssize_t received;
+	WorkerSpawn answer;
+	worker.pid = 0;
+	if(channel==-1 or send(channel,&index,sizeof(index),MSG_NOSIGNAL)!=sizeof(index)){
+		logStream() << ERROR_LOG << "cannot start a worker: the spawner stopped." << std::endl;
+		return 1;
+	}
+	while((received = recv(channel,&answer,sizeof(answer),MSG_WAITALL))==-1 and errno==EINTR);
+	if(received!=sizeof(answer)){
+		logStream() << ERROR_LOG << "cannot start a worker: the spawner stopped." << std::endl;
+		return 1;
+	}
+	if(answer.pid<0){
+		logStream() << ERROR_LOG << "cannot start a worker: " << std::strerror(answer.error) << std::endl;
+		return 1;
+	}
+	worker.pid = answer.pid;
+	return 0;
+}
+
+// function that waits for the oldest batch of a worker, checking from time to time that
+// the worker is still running(the spawner clears the flag of its ring once it ends)
+int WorkerPool::collect(Worker &worker) const{
+	struct timespec deadline;
+	long poll = WORKER_POLL_MS;
+	while(worker.pid>0){
+		clock_gettime(CLOCK_REALTIME,&deadline);
+		deadline.tv_nsec += poll*1000000L;
+		deadline.tv_sec += deadline.tv_nsec/1000000000L;
+		deadline.tv_nsec %= 1000000000L;
+		if(sem_timedwait(&worker.ring->results,&deadline)==0){
+			receive(worker);
+			return 0;
+		}
+		if(errno!=ETIMEDOUT and errno!=EINTR){
+			logStream() << ERROR_LOG << "failed waiting a worker: " << std::strerror(errno) << std::endl;
+			break;
+		}
+		if(worker.ring->running){
+			poll = std::min(2*poll,(long)WORKER_POLL_MAX_MS);
+			continue;
+		}
+		poll = WORKER_POLL_MS;
+		// the worker stopped, but it may have evaluated the batch before
+		worker.pid = 0;
+		if(sem_trywait(&worker.ring->results)==0){
+			receive(worker);
+			return restart(worker);
+		}
+		// restarts are counted, and reported by who started the pool
+		if(++worker.restarts>WORKER_MAX_RESTARTS){
+			if(!givenUp.exchange(1)){
+				logStream() << ERROR_LOG << "a worker stopped " << WORKER_MAX_RESTARTS+1
+							<< " times on the same batch, its values are given up(as NaN)." << std::endl;
+			}
+			giveUp(worker);
+			restart(worker);
+			return 1;
+		}
+		restart(worker);
+	}
+	// the worker couldn't be restarted
+	giveUp(worker);
+	return 1;
+}
+
+// function that copies the values of the oldest batch of a worker where they're expected
+void WorkerPool::receive(Worker &worker) const{
+	const WorkerSlot &slot = worker.ring->slots[worker.completed%WORKER_RING_SLOTS];
+	std::memcpy(worker.targets[worker.completed%WORKER_RING_SLOTS],slot.values,slot.count*sizeof(double));
+	++worker.completed;
+	worker.restarts = 0;
+}
+
+// function that gives NaN as values of the oldest batch of a worker
+void WorkerPool::giveUp(Worker &worker) const{
+	const WorkerSlot &slot = worker.ring->slots[worker.completed%WORKER_RING_SLOTS];
+	double *target = worker.targets[worker.completed%WORKER_RING_SLOTS];
+	size_t i;
+	for(i=0;i<slot.count;++i){
+		target[i] = std::numeric_limits<double>::quiet_NaN();
+	}
+	++worker.completed;
+	worker.restarts = 0;
+}
+
+// function that restarts a worker from the oldest batch not collected: its semaphores
+// are reset to the batches still queued, which are evaluated again
+int WorkerPool::restart(Worker &worker) const{
+	sem_destroy(&worker.ring->requests);
+	sem_destroy(&worker.ring->results);
+	sem_init(&worker.ring->requests,1,worker.submitted-worker.completed);
+	sem_init(&worker.ring->results,1,0);
+	worker.ring->next = worker.completed;
+	++restarts;
+	return spawn(worker);
+}
+
+// function that makes the Function3D evaluate its function through the pool
+int loadWorkerPool(const std::shared_ptr<const WorkerPool> &pool, Function3D &function){
+	if(!pool or pool->getWorkers()==0){
+		logStream() << ERROR_LOG << "worker pool not started." << std::endl;
+		return 1;
+	}
+	function.setSource(pool);
+	return 0;
+}
@@ -0,0 +1,153 @@
+// Function of test/function.cpp behind a stand-in server: every point costs
+// ASYNC_LATENCY_US microseconds of waiting(as a lookup in another process would), spent
+// by ASYNC_WORKERS server threads. f is a blocking round trip of one point, while the
+// submit function of integral3d_plugin_info queues a whole batch and returns at once.
+#ifdef __cplusplus
+#define EXPORT_SYMBOL extern "C" __attribute__((visibility("default")))
+#else
+#define EXPORT_SYMBOL __attribute__((visibility("default")))
+#endif
+#include <map>
+#include <string>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "../include/integral3D.h"
+
+// threads of the server
+#define ASYNC_WORKERS 16
+// microseconds waited per point
+#define ASYNC_LATENCY_US 100
+
+EXPORT_SYMBOL double f(double x, double y, double z);
+EXPORT_SYMBOL std::map<std::string,double> first,second;
+EXPORT_SYMBOL int submit(const double *x, const double *y, const double *z, double *values, size_t n,
+							integral3d_done_function done, void *tag);
+EXPORT_SYMBOL struct integral3d_plugin_info integral3d_plugin_info;
+
+double value(double x, double y, double z){
+	return 5*x*x+y;
+}
+
+// Server takes the requests(a batch of points each) and answers them from its threads
+class Server{
+	public:
+		struct Request{
+			const double *x, *y, *z;
+			double *values;
+			size_t n;
+			integral3d_done_function done;
+			void *tag;
+		};
+
+		Server() : stop(0){
+			int i;
+			for(i=0;i<ASYNC_WORKERS;++i){
+				workers.emplace_back(&Server::serve,this);
+			}
+		}
+
+		~Server(){
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stop = 1;
+			}
+			arrival.notify_all();
+			for(std::thread &worker : workers){
+				worker.join();
+			}
+		}
+
+		void post(const Request &request){
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				requests.push_back(request);
+			}
+			arrival.notify_one();
+		}
+
+	private:
+		void serve(){
+			Request request;
+			size_t i;
+			while(true){
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					arrival.wait(lock,[this](){
+						return stop or !requests.empty();
+					});
+					if(requests.empty()){
+						return;
+					}
+					request = requests.front();
+					requests.pop_front();
+				}
+				std::this_thread::sleep_for(std::chrono::microseconds(ASYNC_LATENCY_US*request.n));
+				for(i=0;i<request.n;++i){
+					request.values[i] = value(request.x[i],request.y[i],request.z[i]);
+				}
+				request.done(request.tag,0);
+			}
+		}
+
+		std::vector<std::thread> workers;
+		std::deque<Request> requests;
+		std::mutex mutex;
+		std::condition_variable arrival;
+		int stop;
+};
+
+Server server;
+
+// completion of a blocking call
+struct Call{
+	std::mutex mutex;
+	std::condition_variable finished;
+	int done = 0;
+};
+
+void called(void *tag, int state){
+	Call *call = (Call*) tag;
+	std::lock_guard<std::mutex> lock(call->mutex);
+	call->done = 1;
+	call->finished.notify_all();
+}
+
+double f(double x, double y, double z){
+	Call call;
+	double result;
+	server.post({&x,&y,&z,&result,1,called,&call});
+	std::unique_lock<std::mutex> lock(call.mutex);
+	call.finished.wait(lock,[&call](){
+		return call.done;
+	});
+	return result;
+}
+
+int submit(const double *x, const double *y, const double *z, double *values, size_t n,
+			integral3d_done_function done, void *tag){
+	server.post({x,y,z,values,n,done,tag});
+	return 0;
+}
+
+std::map<std::string,double> first = {
+	{"x^2",1},
+	{"y^2",2},
+	{"z^2",1},
+	{"r",-5},
+	{"<",1}
+};
+
+std::map<std::string,double> second = {
+	{"y",1},
+	{">",1}
+};
+
+struct integral3d_plugin_info integral3d_plugin_info = {
+	sizeof(struct integral3d_plugin_info),INTEGRAL3D_PLUGIN_INFO_VERSION,INTEGRAL3D_HINT_THREAD_SAFE,
+	nullptr,0,INTEGRAL3D_SMOOTHNESS_UNKNOWN,{0,0,0},{0,0,0,0,0,0},0,submit
+};
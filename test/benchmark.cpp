@@ -0,0 +1,145 @@
+// Benchmark of the integration engines. It integrates functions with known
+// integral, and for each precision mode of the trapezoidal sums reports the
+// time, the throughput(evaluations per second), the true error and the status
+// flags(INTEGRATION_STATUS_*), then whether compensated sums or float evaluation
+// gained anything: on the ball the discretization error dominates, on the slope
+// cube the rounding of the sums does. Then it
+// compares the points needed by each engine on the smooth cases, for decreasing
+// tolerances(the ball shows a domain cutting the box, where the sparse grid
+// gives way to the hybrid engine, which refines only the border).
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../include/math3D.h"
+
+// height of the slope added to the integrand of the case dominated by rounding
+#define BENCHMARK_SLOPE 1e8
+
+// (1-r^2)^2 vanishes with its derivative on the unit sphere, so the integrand
+// is smooth over the ball. The integral is 4pi*int_0^1 (1-r^2)^2 r sinh(r) dr
+double smoothBall(double x, double y, double z){
+	double r2 = x*x+y*y+z*z;
+	return (1-r2)*(1-r2)*std::exp(x);
+}
+
+float smoothBallFloat(float x, float y, float z){
+	float r2 = x*x+y*y+z*z;
+	return (1-r2)*(1-r2)*std::exp(x);
+}
+
+// smooth functions on the unit cube, whose integrals are (e-1)^3 and
+// Re(prod_a (e^(ia)-1)/(ia)) for a=1,2,3
+double exponentialCube(double x, double y, double z){
+	return std::exp(x+y+z);
+}
+
+double cosineCube(double x, double y, double z){
+	return std::cos(x+2*y+3*z);
+}
+
+// e^(x+y+z) plus a slope of height BENCHMARK_SLOPE, odd around the center of the
+// cube: its integral is 0 and the trapezoidal sums of its exact values cancel, so
+// only their rounding is left, and it dominates the error
+double slopeCube(double x, double y, double z){
+	return BENCHMARK_SLOPE*(2*x-1)+std::exp(x+y+z);
+}
+
+// benchmark case: name, Function3D and exact value of the integral
+struct BenchmarkCase{
+	std::string name;
+	Function3D function;
+	double exact;
+	int maxn;
+	int maxr;
+};
+
+int main(){
+	std::map<std::string,double> ball = {{"x^2",1},{"y^2",1},{"z^2",1},{"r",-1},{"<=",1}};
+	std::vector<BenchmarkCase> cases;
+	// unit cube, as the intersection of x(1-x)>=0, y(1-y)>=0, z(1-z)>=0
+	std::vector<Inequality> cube;
+	for(const std::string &axis : {"x","y","z"}){
+		cube.push_back(Inequality({{axis+"^2",-1},{axis,1},{">=",1}}));
+	}
+	Function3D smooth(ball,ball,smoothBall);
+	smooth.setFloatFunction(smoothBallFloat);
+	cases.push_back({"smooth ball MAXN=7",smooth,1.0118532623403511,7,0});
+	cases.push_back({"smooth ball MAXN=8",smooth,1.0118532623403511,8,0});
+	cases.push_back({"slope cube MAXN=9",Function3D(cube,slopeCube),5.0732141117728515,9,0});
+
+	std::vector<std::pair<std::string,int>> modes = {{"double",PRECISION_MODE_DOUBLE},
+						{"compensated",PRECISION_MODE_COMPENSATED},{"float",PRECISION_MODE_FLOAT},
+						{"long-double",PRECISION_MODE_LONG_DOUBLE}};
+
+	std::cout << std::left << std::setw(22) << "case" << std::setw(13) << "mode" << std::setw(11) << "time[s]"
+				<< std::setw(13) << "Meval/s" << std::setw(22) << "value" << std::setw(12) << "true error"
+				<< "status" << std::endl;
+	for(const BenchmarkCase &c : cases){
+		std::vector<double> times, errors;
+		for(const std::pair<std::string,int> &mode : modes){
+			Integral3D integral;
+			integral.setPrecisionMode(mode.second);
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			// epsilon 0 forces every Romberg's level to be computed(and sets the depth flag)
+			IntegrationResult result = integral.integrate(c.function,0,c.maxn,c.maxr);
+			double time = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+			times.push_back(time);
+			errors.push_back(std::fabs(result.value-c.exact));
+			std::cout << std::left << std::setw(22) << c.name << std::setw(13) << mode.first
+						<< std::setw(11) << std::setprecision(4) << time
+						<< std::setw(13) << result.evaluations/time/1e6
+						<< std::setw(22) << std::setprecision(17) << result.value
+						<< std::setw(12) << std::setprecision(3) << errors.back()
+						<< result.status << std::endl;
+		}
+		// the modes are in the order of modes: double, compensated, float, long-double
+		if(errors[1]<errors[0]/2){
+			std::cout << "  compensated sums gain: true error " << errors[0]/errors[1]
+						<< " times smaller than with double sums(rounding dominates)" << std::endl;
+		}else{
+			std::cout << "  no gain from compensated sums: the discretization error dominates" << std::endl;
+		}
+		if(times[2]<times[0]*0.9){
+			std::cout << "  float evaluation " << times[0]/times[2] << " times faster than double" << std::endl;
+		}else{
+			std::cout << "  float evaluation not faster than double(the sums are in double anyway)" << std::endl;
+		}
+	}
+
+	std::vector<BenchmarkCase> smoothCases;
+	smoothCases.push_back({"exp cube",Function3D(cube,exponentialCube),5.0732141117728515,8,0});
+	smoothCases.push_back({"cos cube",Function3D(cube,cosineCube),-0.5311799472342865,8,0});
+	smoothCases.push_back({"smooth ball",smooth,1.0118532623403511,8,0});
+	smoothCases.push_back({"smooth ball MAXR=3",smooth,1.0118532623403511,5,3});
+	std::vector<std::pair<std::string,int>> engines = {{"romberg",ENGINE_ROMBERG},
+														{"sparse-grid",ENGINE_SPARSE_GRID},
+														{"hybrid",ENGINE_HYBRID},
+														{"breadth-first",ENGINE_BREADTH_FIRST}};
+
+	std::cout << std::endl << std::left << std::setw(22) << "case" << std::setw(13) << "engine"
+				<< std::setw(11) << "epsilon" << std::setw(11) << "time[s]" << std::setw(11) << "points"
+				<< std::setw(22) << "value" << std::setw(12) << "true error" << "status" << std::endl;
+	for(const BenchmarkCase &c : smoothCases){
+		for(double epsilon : {1e-3,1e-6,1e-9}){
+			for(const std::pair<std::string,int> &engine : engines){
+				Integral3D integral;
+				integral.setEngine(engine.second);
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				IntegrationResult result = integral.integrate(c.function,epsilon,c.maxn,c.maxr);
+				double time = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+				std::cout << std::left << std::setw(22) << c.name << std::setw(13) << engine.first
+							<< std::setw(11) << std::setprecision(3) << epsilon
+							<< std::setw(11) << std::setprecision(4) << time
+							<< std::setw(11) << result.evaluations
+							<< std::setw(22) << std::setprecision(17) << result.value
+							<< std::setw(12) << std::setprecision(3) << std::fabs(result.value-c.exact)
+							<< result.status << std::endl;
+			}
+		}
+	}
+	return 0;
+}
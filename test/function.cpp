@@ -5,9 +5,11 @@
 #endif
 #include <map>
 #include <string>
+#include <vector>
 
 EXPORT_SYMBOL double f(double x, double y, double z);
 EXPORT_SYMBOL std::map<std::string,double> first,second;
+EXPORT_SYMBOL std::vector<std::map<std::string,double>> domains;
 
 double f(double x, double y, double z){
 	return 5*x*x+y;
@@ -24,4 +26,12 @@ std::map<std::string,double> first = {
 std::map<std::string,double> second = {
 	{"y",1},
 	{">",1}
+};
+
+// cells of the domain for --domains: the ellipsoid cut into the slabs 0<y<0.5, 0.5<y<1
+// and 1<y<2, each written as (y-a)(y-b)<0
+std::vector<std::map<std::string,double>> domains = {
+	first, {{"y^2",1},{"y",-0.5},{"<",1}},
+	first, {{"y^2",1},{"y",-1.5},{"r",0.5},{"<",1}},
+	first, {{"y^2",1},{"y",-3},{"r",2},{"<",1}}
 };
\ No newline at end of file
@@ -0,0 +1,177 @@
+// Regression suite of accuracy and cost. It integrates cases with known integral
+// (volumes of ellipsoids, the domain of test/function.cpp, moments over half-spaces
+// and the edge cases of the truncation of infinite sides) and compares each one with
+// its golden values: the points sampled can't exceed the stored budget, and the ratio of
+// the true error to the reported one can't exceed the stored one(both up to
+// REGRESSION_TOLERANCE). The ratio is 1 for the cases whose error is honest; the cases
+// whose error is known to be underestimated store the ratio they have, with the reason,
+// and are reported as known failures. The program returns 1 if some case regressed, so
+// that a change of performance is seen and, if wanted, the golden values are updated.
+// Cases using less points than REGRESSION_TOLERANCE below their budget, and known
+// failures whose error became honest, are reported too.
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cmath>
+
+#include "../include/math3D.h"
+
+// relative margin over the golden budgets before a case fails
+#define REGRESSION_TOLERANCE 0.1
+
+const double pi = 3.14159265358979323846;
+
+double one(double x, double y, double z){
+	return 1;
+}
+
+double coordinateX(double x, double y, double z){
+	return x;
+}
+
+// integrand of test/function.cpp
+double testFunction(double x, double y, double z){
+	return 5*x*x+y;
+}
+
+double gaussian(double x, double y, double z){
+	return std::exp(-(x*x+y*y+z*z));
+}
+
+double planeGaussian(double x, double y, double z){
+	return std::exp(-(x*x+y*y));
+}
+
+double gaussianMoment(double x, double y, double z){
+	return z*std::exp(-(x*x+y*y+z*z));
+}
+
+// regression case: the integral with its options, the exact value and the golden values
+struct RegressionCase{
+	std::string name;
+	Function3D function;
+	double exact;
+	double epsilon;
+	int maxn;
+	int maxr;
+	int engine; // ENGINE_*
+	int splitPolicy; // SPLIT_POLICY_*
+	int unboundedMode; // UNBOUNDED_MODE_*
+	int coordinates; // COORDINATES_*
+	long budget; // points sampled
+	double ratio; // true error over the reported one(1 if the estimate is honest, so it can't be exceeded)
+	std::string knownFailure; // why the error is underestimated(empty if the estimate is honest)
+};
+
+int main(){
+	// x^2/4+y^2+z^2/9<=1, of volume 4/3*pi*abc
+	Inequality ellipsoid({{"x^2",0.25},{"y^2",1},{"z^2",1.0/9},{"r",-1},{"<=",1}});
+	// domain of test/function.cpp: half of the ellipsoid x^2+2y^2+z^2<5 with semiaxes
+	// a=c=sqrt(5), b=sqrt(5/2), where int 5x^2 = 5*2pi/15*a^3bc and int y = pi/4*acb^2
+	Inequality half({{"x^2",1},{"y^2",2},{"z^2",1},{"r",-5},{"<",1}});
+	Inequality positiveY({{"y",1},{">",1}});
+	double a = std::sqrt(5.0), b = std::sqrt(2.5);
+	double halfEllipsoid = 5*2*pi/15*a*a*a*b*a+pi/4*a*a*b*b;
+	Inequality positiveZ({{"z",1},{">",1}});
+	Inequality belowOne({{"z",-1},{"r",1},{">",1}}); // 1-z>0
+	Inequality negativeX({{"x",-1},{"<=",1}}); // x>=0 written as -x<=0
+	std::vector<Inequality> aboveOne = {Inequality({{"x",1},{"r",-1},{">",1}}), // x>1
+										Inequality({{"y^2",-1},{"y",1},{">=",1}}), // 0<=y<=1
+										Inequality({{"z^2",-1},{"z",1},{">=",1}})}; // 0<=z<=1
+	std::vector<Inequality> belowMinusOne = aboveOne;
+	belowMinusOne[0] = Inequality({{"x",1},{"r",1},{"<",1}}); // x<-1
+	Inequality everywhere({{"r",1},{">",1}});
+
+	// the domain is discontinuous on the curved border of the ellipsoids: the regions crossing
+	// it whose lattice has every point inside get equal rows, and are taken as converged with
+	// no error
+	std::string border = "regions crossing the curved border with their lattice inside are taken as converged"
+							" with no error";
+	std::vector<RegressionCase> cases = {
+		{"ellipsoid volume",Function3D(ellipsoid,ellipsoid,one),8*pi,
+			1e-2,5,3,ENGINE_ROMBERG,SPLIT_POLICY_FULL,DEFAULT_UNBOUNDED_MODE,COORDINATES_CARTESIAN,1108233,3.45,border},
+		{"ellipsoid spherical",Function3D(ellipsoid,ellipsoid,one),8*pi,
+			1e-6,6,2,ENGINE_ROMBERG,SPLIT_POLICY_FULL,DEFAULT_UNBOUNDED_MODE,COORDINATES_ELLIPSOIDAL,852937,1,""},
+		{"test function",Function3D(half,positiveY,testFunction),halfEllipsoid,
+			1,5,3,ENGINE_ROMBERG,SPLIT_POLICY_FULL,DEFAULT_UNBOUNDED_MODE,COORDINATES_CARTESIAN,27481,14.6,
+			"with tolerance 1 the regions stop after rows that miss the curved border, so the true error"
+			" is above the tolerance too"},
+		{"test function fine",Function3D(half,positiveY,testFunction),halfEllipsoid,
+			0.1,5,4,ENGINE_ROMBERG,SPLIT_POLICY_FULL,DEFAULT_UNBOUNDED_MODE,COORDINATES_CARTESIAN,13079881,1,""},
+		{"test function hybrid",Function3D(half,positiveY,testFunction),halfEllipsoid,
+			0.1,5,4,ENGINE_HYBRID,SPLIT_POLICY_FULL,DEFAULT_UNBOUNDED_MODE,COORDINATES_CARTESIAN,6655981,1,""},
+		// the regions crossing the border are split after their first row: with a row less than
+		// "ellipsoid volume" it samples a fourth of the points, and its error is honest
+		{"ellipsoid adaptive",Function3D(ellipsoid,ellipsoid,one),8*pi,
+			1e-2,4,3,ENGINE_ROMBERG,SPLIT_POLICY_ADAPTIVE,DEFAULT_UNBOUNDED_MODE,COORDINATES_CARTESIAN,262288,1,""},
+		{"test function adaptive",Function3D(half,positiveY,testFunction),halfEllipsoid,
+			0.1,5,4,ENGINE_ROMBERG,SPLIT_POLICY_ADAPTIVE,DEFAULT_UNBOUNDED_MODE,COORDINATES_CARTESIAN,13336088,1,""},
+		// int_{z>0} z e^-r^2 = pi/2
+		{"half-space moment",Function3D(positiveZ,positiveZ,gaussianMoment),pi/2,
+			1e-4,5,4,ENGINE_ROMBERG,SPLIT_POLICY_FULL,UNBOUNDED_MODE_TRANSFORM,COORDINATES_CARTESIAN,4514089,1,""},
+		// truncation: x and y infinite on both sides
+		{"truncated slab",Function3D(positiveZ,belowOne,planeGaussian),pi,
+			1e-3,5,4,ENGINE_ROMBERG,SPLIT_POLICY_FULL,UNBOUNDED_MODE_TRUNCATE,COORDINATES_CARTESIAN,6480185,1,""},
+		// truncation: x infinite above, y and z on both sides
+		{"truncated half-space",Function3D(negativeX,negativeX,gaussian),std::pow(pi,1.5)/2,
+			1e-3,5,4,ENGINE_ROMBERG,SPLIT_POLICY_FULL,UNBOUNDED_MODE_TRUNCATE,COORDINATES_CARTESIAN,17320161,1,""},
+		// truncation: the finite end of x isn't at the origin, so the box is [1,1+MAX_BOUNDED_SIZE]
+		// (or [-1-MAX_BOUNDED_SIZE,-1]) and the integral of x over the unit square is exactly known
+		{"truncated above",Function3D(aboveOne,coordinateX),(std::pow(1+MAX_BOUNDED_SIZE,2)-1)/2,
+			1e-3,5,4,ENGINE_ROMBERG,SPLIT_POLICY_FULL,UNBOUNDED_MODE_TRUNCATE,COORDINATES_CARTESIAN,1684513,1,""},
+		{"truncated below",Function3D(belowMinusOne,coordinateX),-(std::pow(1+MAX_BOUNDED_SIZE,2)-1)/2,
+			1e-3,5,4,ENGINE_ROMBERG,SPLIT_POLICY_FULL,UNBOUNDED_MODE_TRUNCATE,COORDINATES_CARTESIAN,1684513,1,""},
+		// truncation: every side infinite
+		{"truncated space",Function3D(everywhere,everywhere,gaussian),std::pow(pi,1.5),
+			1e-3,5,4,ENGINE_ROMBERG,SPLIT_POLICY_FULL,UNBOUNDED_MODE_TRUNCATE,COORDINATES_CARTESIAN,11642569,1,""}
+	};
+	int failed = 0, known = 0;
+
+	std::cout << std::left << std::setw(24) << "case" << std::setw(12) << "points" << std::setw(12) << "budget"
+				<< std::setw(12) << "true error" << std::setw(12) << "reported" << std::setw(10) << "ratio"
+				<< std::setw(10) << "golden" << "result" << std::endl;
+	for(const RegressionCase &c : cases){
+		Integral3D integral;
+		integral.setEngine(c.engine);
+		integral.setSplitPolicy(c.splitPolicy);
+		integral.setUnboundedMode(c.unboundedMode);
+		integral.setCoordinates(c.coordinates);
+		IntegrationResult result = integral.integrate(c.function,c.epsilon,c.maxn,c.maxr);
+		double trueError = std::fabs(result.value-c.exact);
+		double ratio = result.error>0 ? trueError/result.error : (trueError>0 ? INFINITY : 0);
+		std::string outcome = "ok";
+		if(result.evaluations>c.budget*(1+REGRESSION_TOLERANCE)){
+			outcome = "FAILED(points)";
+		}else if(ratio>1 and (c.knownFailure.empty() or ratio>c.ratio*(1+REGRESSION_TOLERANCE))){
+			outcome = "FAILED(error)";
+		}else if(ratio>1){
+			outcome = "known failure";
+			++known;
+		}else if(!c.knownFailure.empty()){
+			outcome = "ok(known failure fixed)";
+		}else if(result.evaluations<c.budget*(1-REGRESSION_TOLERANCE)){
+			outcome = "ok(under budget)";
+		}
+		if(outcome.compare(0,6,"FAILED")==0){
+			++failed;
+		}
+		std::cout << std::left << std::setw(24) << c.name << std::setw(12) << result.evaluations
+					<< std::setw(12) << c.budget << std::setprecision(3) << std::setw(12) << trueError
+					<< std::setw(12) << result.error << std::setw(10) << ratio << std::setw(10) << c.ratio << outcome
+					<< std::endl;
+	}
+	for(const RegressionCase &c : cases){
+		if(!c.knownFailure.empty()){
+			std::cout << "known failure of " << c.name << ": " << c.knownFailure << std::endl;
+		}
+	}
+	if(failed>0){
+		std::cout << failed << " of " << cases.size() << " cases regressed" << std::endl;
+		return 1;
+	}
+	std::cout << "all " << cases.size() << " cases within their golden values(" << known
+				<< " known failures)" << std::endl;
+	return 0;
+}
@@ -0,0 +1,99 @@
+// Reader of the traces written with --trace. It summarizes where the engine sampled:
+// number of points, fraction in the domain, box of the points, range of the values,
+// and points per recursion depth and per Romberg's level. With --csv the points are
+// printed instead, one per line.
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <map>
+#include <limits>
+#include <algorithm>
+
+#include "../include/error.h"
+#include "../include/trace.h"
+
+// function that prints the points of the trace as CSV
+int printCsv(TraceReader &reader){
+	TraceChunk chunk;
+	size_t i;
+	std::cout << "x,y,z,value,inDomain,level,depth" << std::endl;
+	std::cout << std::setprecision(17);
+	while(!reader.read(chunk)){
+		for(i=0;i<chunk.size();++i){
+			std::cout << chunk.x[i] << "," << chunk.y[i] << "," << chunk.z[i] << "," << chunk.value[i] << ","
+						<< (int)chunk.inDomain[i] << "," << (int)chunk.level[i] << "," << chunk.depth[i] << std::endl;
+		}
+	}
+	return 0;
+}
+
+// function that prints the summary of the trace
+int printSummary(TraceReader &reader){
+	TraceChunk chunk;
+	size_t i, points = 0, inside = 0;
+	double low[3], high[3], minValue, maxValue, sum = 0;
+	std::map<int,size_t> depths, levels;
+	low[0] = low[1] = low[2] = minValue = std::numeric_limits<double>::infinity();
+	high[0] = high[1] = high[2] = maxValue = -std::numeric_limits<double>::infinity();
+	while(!reader.read(chunk)){
+		for(i=0;i<chunk.size();++i){
+			low[0] = std::min(low[0],chunk.x[i]);
+			low[1] = std::min(low[1],chunk.y[i]);
+			low[2] = std::min(low[2],chunk.z[i]);
+			high[0] = std::max(high[0],chunk.x[i]);
+			high[1] = std::max(high[1],chunk.y[i]);
+			high[2] = std::max(high[2],chunk.z[i]);
+			if(chunk.inDomain[i]){
+				++inside;
+				minValue = std::min(minValue,chunk.value[i]);
+				maxValue = std::max(maxValue,chunk.value[i]);
+				sum += chunk.value[i];
+			}
+			++depths[chunk.depth[i]];
+			++levels[chunk.level[i]];
+		}
+		points += chunk.size();
+	}
+	std::cout << "points: " << points << std::endl;
+	if(points==0){
+		return 0;
+	}
+	std::cout << "in domain: " << inside << " (" << 100.0*inside/points << "%)" << std::endl;
+	std::cout << "box: [" << low[0] << "," << high[0] << "]x[" << low[1] << "," << high[1] << "]x["
+				<< low[2] << "," << high[2] << "]" << std::endl;
+	if(inside>0){
+		std::cout << "values in domain: min " << minValue << ", max " << maxValue << ", mean " << sum/inside
+					<< std::endl;
+	}
+	std::cout << "points per depth:" << std::endl;
+	for(const std::pair<const int,size_t> &depth : depths){
+		std::cout << "  " << std::setw(4) << depth.first << " " << depth.second << std::endl;
+	}
+	std::cout << "points per level:" << std::endl;
+	for(const std::pair<const int,size_t> &level : levels){
+		if(level.first==TRACE_LEVEL_GAUSS){
+			std::cout << "  gauss " << level.second << std::endl;
+		}else{
+			std::cout << "  " << std::setw(4) << level.first << " " << level.second << std::endl;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[]){
+	TraceReader reader;
+	if(argc<2 or (argc==3 and std::string(argv[2])!="--csv") or argc>3){
+		std::cerr << USAGE_LOG << argv[0] << " <trace file> [--csv]" << std::endl;
+		std::cerr << FATAL_ERROR_LOG << "exiting program." << std::endl;
+		return 1;
+	}
+	if(reader.open(argv[1])){
+		std::cerr << FATAL_ERROR_LOG << "exiting program." << std::endl;
+		return 1;
+	}
+	if(argc==3){
+		return printCsv(reader);
+	}
+	return printSummary(reader);
+}